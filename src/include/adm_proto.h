@@ -64,6 +64,7 @@ int krb5_klog_syslog(int, const char *, ...)
 #endif
     ;
 void krb5_klog_reopen (krb5_context);
+void krb5_klog_flush(krb5_context);
 
 /* alt_prof.c */
 krb5_error_code krb5_aprof_init(char *, char *, krb5_pointer *);
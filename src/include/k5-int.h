@@ -229,6 +229,7 @@ typedef INT64_TYPE krb5_int64;
 #define KRB5_CONF_KADMIND_PORT                "kadmind_port"
 #define KRB5_CONF_KRB524_SERVER               "krb524_server"
 #define KRB5_CONF_KDC                         "kdc"
+#define KRB5_CONF_KDC_AUTHDATA_CACHE_LIFETIME "kdc_authdata_cache_lifetime"
 #define KRB5_CONF_KDCDEFAULTS                 "kdcdefaults"
 #define KRB5_CONF_KDC_PORTS                   "kdc_ports"
 #define KRB5_CONF_KDC_TCP_PORTS               "kdc_tcp_ports"
@@ -236,18 +237,22 @@ typedef INT64_TYPE krb5_int64;
 #define KRB5_CONF_KDC_DEFAULT_OPTIONS         "kdc_default_options"
 #define KRB5_CONF_KDC_TIMESYNC                "kdc_timesync"
 #define KRB5_CONF_KDC_REQ_CHECKSUM_TYPE       "kdc_req_checksum_type"
+#define KRB5_CONF_KDC_STATS_INTERVAL          "kdc_stats_interval"
 #define KRB5_CONF_KEY_STASH_FILE              "key_stash_file"
 #define KRB5_CONF_KPASSWD_PORT                "kpasswd_port"
 #define KRB5_CONF_KPASSWD_SERVER              "kpasswd_server"
+#define KRB5_CONF_KPROPD_DOWNSTREAM           "kpropd_downstream"
 #define KRB5_CONF_LDAP_CONNS_PER_SERVER       "ldap_conns_per_server"
 #define KRB5_CONF_LDAP_KADMIN_DN              "ldap_kadmind_dn"
 #define KRB5_CONF_LDAP_KDC_DN                 "ldap_kdc_dn"
 #define KRB5_CONF_LDAP_KERBEROS_CONTAINER_DN  "ldap_kerberos_container_dn"
 #define KRB5_CONF_LDAP_KPASSWDD_DN            "ldap_kpasswdd_dn"
+#define KRB5_CONF_LDAP_PRINCIPAL_CACHE_TTL    "ldap_principal_cache_ttl"
 #define KRB5_CONF_LDAP_SERVERS                "ldap_servers"
 #define KRB5_CONF_LDAP_SERVICE_PASSWORD_FILE  "ldap_service_password_file"
 #define KRB5_CONF_LIBDEFAULTS                 "libdefaults"
 #define KRB5_CONF_LOGGING                     "logging"
+#define KRB5_CONF_LOG_FLUSH_INTERVAL          "log_flush_interval"
 #define KRB5_CONF_MASTER_KEY_NAME             "master_key_name"
 #define KRB5_CONF_MASTER_KEY_TYPE             "master_key_type"
 #define KRB5_CONF_MASTER_KDC                  "master_kdc"
@@ -1244,7 +1249,8 @@ krb5_authdata_free_internal(krb5_context kcontext,
  * - Possibly, built-in implementations of the interface, also located within
  *   the code unit which makes use of the interface.  Built-in implementations
  *   must be registered with k5_plugin_register before the first call to
- *   k5_plugin_load or k5_plugin_load_all.
+ *   k5_plugin_load or k5_plugin_load_all; registrations made after that are
+ *   ignored.
  *
  * A pluggable interface should have one or more currently supported major
  * versions, starting at 1.  Each major version should have a current minor
@@ -1269,13 +1275,15 @@ krb5_authdata_free_internal(krb5_context kcontext,
 
 /*
  * A linked list entry mapping a module name to a module initvt function.  The
- * entry may also include a dynamic object handle so that it can be released
- * when the context is destroyed.
+ * entry may also include a dynamic object handle (and the path it was opened
+ * from, so that copies of the context can hold their own reference) so that
+ * it can be released when the context is destroyed.
  */
 struct plugin_mapping {
     char *modname;
     krb5_plugin_initvt_fn module;
     struct plugin_file_handle *dyn_handle;
+    char *dyn_path;
     struct plugin_mapping *next;
 };
 
@@ -1329,6 +1337,11 @@ k5_plugin_register_dyn(krb5_context context, int interface_id,
 void
 k5_plugin_free_context(krb5_context context);
 
+/* Copy the module mappings of ctx into nctx, whose plugin state must be
+ * empty; used by krb5_copy_context. */
+krb5_error_code
+k5_plugin_copy_context(krb5_context ctx, krb5_context nctx);
+
 struct _kdb5_dal_handle;        /* private, in kdb5.h */
 typedef struct _kdb5_dal_handle kdb5_dal_handle;
 struct _kdb_log_context;
@@ -1391,6 +1404,9 @@ struct _krb5_context {
 
     struct plugin_interface plugins[PLUGIN_NUM_INTERFACES];
     char *plugin_base_dir;
+
+    /* Prepared keytab keys for decrypting AP-REQ tickets (rd_req_dec.c). */
+    struct rd_req_key_cache *rd_req_keys;
 };
 
 /* could be used in a table to find an etype and initialize a block */
@@ -644,6 +644,42 @@ krb5_error_code krb5_db_sign_authdata(krb5_context kcontext,
                                       krb5_authdata **tgt_auth_data,
                                       krb5_authdata ***signed_auth_data);
 
+/*
+ * Callback for krb5_db_sign_authdata_async() and the sign_authdata_async
+ * module method.  On success, ownership of signed_auth_data (which may be
+ * NULL) passes to the callback.
+ */
+typedef void
+(*krb5_db_sign_authdata_respond_fn)(void *arg, krb5_error_code code,
+                                    krb5_authdata **signed_auth_data);
+
+/* The verto context structure type (typedef is in verto.h; we want to avoid a
+ * header dependency for the moment). */
+struct verto_ctx;
+
+/*
+ * Generate signed authorization data as krb5_db_sign_authdata() does, but
+ * report the result through respond, which may be invoked after this function
+ * returns.  Modules which must wait on external lookups can use vctx to do so
+ * without blocking the caller's event loop; other modules complete
+ * synchronously.
+ */
+void krb5_db_sign_authdata_async(krb5_context kcontext,
+                                 struct verto_ctx *vctx,
+                                 unsigned int flags,
+                                 krb5_const_principal client_princ,
+                                 krb5_db_entry *client,
+                                 krb5_db_entry *server,
+                                 krb5_db_entry *krbtgt,
+                                 krb5_keyblock *client_key,
+                                 krb5_keyblock *server_key,
+                                 krb5_keyblock *krbtgt_key,
+                                 krb5_keyblock *session_key,
+                                 krb5_timestamp authtime,
+                                 krb5_authdata **tgt_auth_data,
+                                 krb5_db_sign_authdata_respond_fn respond,
+                                 void *arg);
+
 krb5_error_code krb5_db_check_transited_realms(krb5_context kcontext,
                                                const krb5_data *tr_contents,
                                                const krb5_data *client_realm,
@@ -812,6 +848,15 @@ krb5_dbe_free_string(krb5_context, char *);
  */
 #define KRB5_KDB_DAL_MAJOR_VERSION 3
 
+/*
+ * The current minor version of the DAL.  A module's min_ver field indicates
+ * which methods following the minor version 0 methods are present in its
+ * vtable; methods from later minor versions are treated as NULL.
+ *
+ *   1: Adds sign_authdata_async.
+ */
+#define KRB5_KDB_DAL_MINOR_VERSION 1
+
 /*
  * A krb5_context can hold one database object.  Modules should use
  * krb5_db_set_context and krb5_db_get_context to store state associated with
@@ -1009,7 +1054,9 @@ typedef struct _kdb_vftabl {
      * Optional: For each principal entry in the database, invoke func with the
      * argments func_arg and the entry data.  If match_entry is specified, the
      * module may narrow the iteration to principal names matching that regular
-     * expression; a module may alternatively ignore match_entry.
+     * expression (for instance, by seeking to its literal prefix before
+     * reading entries); a module may alternatively ignore match_entry.
+     * Callers must still match the names of the entries passed to func.
      */
     krb5_error_code (*iterate)(krb5_context kcontext,
                                char *match_entry,
@@ -1332,6 +1379,38 @@ typedef struct _kdb_vftabl {
                                                  krb5_const_principal client,
                                                  const krb5_db_entry *server,
                                                  krb5_const_principal proxy);
+
+    /* End of minor version 0. */
+
+    /*
+     * Optional: Generate signed authorization data as sign_authdata does, but
+     * without blocking the KDC.  A module which must consult an external
+     * service (for example, a directory lookup of the client's group
+     * memberships for a PAC) can start the lookup, register for its
+     * completion with vctx, and return; it must then invoke respond exactly
+     * once, possibly before this method returns.  The input parameters must
+     * not be used after respond is invoked.  Pass KRB5_PLUGIN_OP_NOTSUPP to
+     * respond if the module has no authorization data to add.  If this method
+     * is not implemented, sign_authdata is used.  Modules implementing this
+     * method must set min_ver to at least 1.
+     */
+    void (*sign_authdata_async)(krb5_context kcontext,
+                                struct verto_ctx *vctx,
+                                unsigned int flags,
+                                krb5_const_principal client_princ,
+                                krb5_db_entry *client,
+                                krb5_db_entry *server,
+                                krb5_db_entry *krbtgt,
+                                krb5_keyblock *client_key,
+                                krb5_keyblock *server_key,
+                                krb5_keyblock *krbtgt_key,
+                                krb5_keyblock *session_key,
+                                krb5_timestamp authtime,
+                                krb5_authdata **tgt_auth_data,
+                                krb5_db_sign_authdata_respond_fn respond,
+                                void *arg);
+
+    /* End of minor version 1. */
 } kdb_vftabl;
 
 #endif /* !defined(_WIN32) */
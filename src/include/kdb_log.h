@@ -95,6 +95,8 @@ extern void ulog_free_entries(kdb_incr_update_t *updates, int no_of_updates);
 extern krb5_error_code ulog_set_role(krb5_context ctx, iprop_role role);
 
 extern krb5_error_code ulog_lock(krb5_context ctx, int mode);
+extern krb5_error_code ulog_begin_batch(krb5_context ctx);
+extern krb5_error_code ulog_end_batch(krb5_context ctx);
 
 typedef struct kdb_hlog {
     uint32_t        kdb_hmagic;     /* Log header magic # */
@@ -122,6 +124,7 @@ typedef struct _kdb_log_context {
     kdb_hlog_t      *ulog;
     uint32_t        ulogentries;
     int             ulogfd;
+    int             ulogbatch;      /* Lock held, syncs deferred */
 } kdb_log_context;
 
 #ifdef  __cplusplus
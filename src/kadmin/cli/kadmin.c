@@ -115,7 +115,7 @@ static void
 usage()
 {
     fprintf(stderr,
-            _("Usage: %s [-r realm] [-p principal] [-q query] "
+            _("Usage: %s [-r realm] [-p principal] [-q query|-b] "
               "[clnt|local args]\n"
               "\tclnt args: [-s admin_server[:port]] "
               "[[-c ccache]|[-k [-t keytab]]]|[-n]\n"
@@ -232,6 +232,165 @@ randkey_princ(krb5_principal princ, krb5_boolean keepold, int n_ks,
         return kadm5_randkey_principal(handle, princ, NULL, NULL);
 }
 
+/*
+ * Bulk mode (-b) state.  Consecutive add_principal, modify_principal and
+ * change_password -randkey requests read from standard input are queued here
+ * and sent to the server together with kadm5_batch_principals(), which holds
+ * the database and update log locks once for the whole group.
+ */
+#define BATCH_MAX 256
+
+int bulk_mode = 0;
+
+static kadm5_batch_op_rec batch_ops[BATCH_MAX];
+static char *batch_canon[BATCH_MAX];
+static int batch_count = 0;
+
+/* Cached result of looking up the "default" policy: -1 unknown, 0 absent, 1
+ * present.  Reset by kadmin_batch_barrier(). */
+static int batch_default_policy = -1;
+
+static void kadmin_free_tl_data(krb5_int16 *n_tl_datap,
+                                krb5_tl_data **tl_datap);
+
+/* Return true if line is a request which can be queued in bulk mode. */
+int
+kadmin_batchable(const char *line)
+{
+    static const char *const names[] = {
+        "add_principal", "addprinc", "ank", "modify_principal", "modprinc",
+        "change_password", "cpw", NULL
+    };
+    const char *const *n;
+    size_t len;
+
+    while (isspace((unsigned char)*line))
+        line++;
+    len = strcspn(line, " \t\r\n");
+    for (n = names; *n != NULL; n++) {
+        if (strlen(*n) == len && strncmp(line, *n, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Return true if an operation on princ is waiting in the queue. */
+static krb5_boolean
+batch_pending(krb5_principal princ)
+{
+    int i;
+
+    for (i = 0; i < batch_count; i++) {
+        if (krb5_principal_compare(context, batch_ops[i].rec.principal, princ))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Report the result of one queued operation the way the unbatched request
+ * would have. */
+static void
+batch_report(kadm5_batch_op_t op, const char *canon, kadm5_ret_t code)
+{
+    switch (op->op) {
+    case KADM5_BATCH_CREATE:
+        if (code)
+            com_err("add_principal", code, "while creating \"%s\".", canon);
+        else
+            printf("Principal \"%s\" created.\n", canon);
+        break;
+    case KADM5_BATCH_MODIFY:
+        if (code) {
+            com_err("modify_principal", code, _("while modifying \"%s\"."),
+                    canon);
+        } else
+            printf(_("Principal \"%s\" modified.\n"), canon);
+        break;
+    case KADM5_BATCH_RANDKEY:
+        if (code) {
+            com_err("change_password", code,
+                    _("while randomizing key for \"%s\"."), canon);
+        } else
+            printf(_("Key for \"%s\" randomized.\n"), canon);
+        break;
+    }
+}
+
+/* Send any queued operations to the server and report their results. */
+void
+kadmin_batch_flush()
+{
+    kadm5_ret_t retval, codes[BATCH_MAX];
+    kadm5_batch_op_t op;
+    int i;
+
+    if (batch_count == 0)
+        return;
+
+    retval = kadm5_batch_principals(handle, batch_ops, batch_count, codes);
+    for (i = 0; i < batch_count; i++) {
+        op = &batch_ops[i];
+        batch_report(op, batch_canon[i], retval ? retval : codes[i]);
+        krb5_free_principal(context, op->rec.principal);
+        free(op->rec.policy);
+        kadmin_free_tl_data(&op->rec.n_tl_data, &op->rec.tl_data);
+        free(op->ks_tuple);
+        if (op->pass != NULL) {
+            memset(op->pass, 0, strlen(op->pass));
+            free(op->pass);
+        }
+        free(batch_canon[i]);
+    }
+    memset(batch_ops, 0, sizeof(batch_ops));
+    batch_count = 0;
+}
+
+/* Prepare to run a request which cannot be queued: flush the queue so that
+ * the request sees its results, and forget the cached policy lookup, which
+ * the request might invalidate. */
+void
+kadmin_batch_barrier()
+{
+    kadmin_batch_flush();
+    batch_default_policy = -1;
+}
+
+/*
+ * Queue an operation for the next flush.  The queue takes ownership of
+ * rec->principal, rec->tl_data, and ks_tuple; the caller must not free them.
+ * rec->policy and pass are copied.
+ */
+static void
+batch_queue(int optype, kadm5_principal_ent_t rec, long mask,
+            krb5_boolean keepold, int n_ks_tuple,
+            krb5_key_salt_tuple *ks_tuple, const char *pass,
+            const char *canon)
+{
+    kadm5_batch_op_t op;
+
+    if (batch_count == BATCH_MAX)
+        kadmin_batch_flush();
+
+    op = &batch_ops[batch_count];
+    op->op = optype;
+    op->rec = *rec;
+    op->rec.policy = NULL;
+    op->mask = mask;
+    op->keepold = keepold;
+    op->n_ks_tuple = n_ks_tuple;
+    op->ks_tuple = ks_tuple;
+    op->pass = NULL;
+    batch_canon[batch_count] = strdup(canon);
+    if (batch_canon[batch_count] == NULL ||
+        (rec->policy != NULL &&
+         (op->rec.policy = strdup(rec->policy)) == NULL) ||
+        (pass != NULL && (op->pass = strdup(pass)) == NULL)) {
+        fprintf(stderr, _("Not enough memory\n"));
+        exit(1);
+    }
+    batch_count++;
+}
+
 char *
 kadmin_startup(int argc, char *argv[])
 {
@@ -262,7 +421,7 @@ kadmin_startup(int argc, char *argv[])
     }
 
     while ((optchar = getopt(argc, argv,
-                             "x:r:p:knq:w:d:s:mc:t:e:ON")) != EOF) {
+                             "x:r:p:knq:bw:d:s:mc:t:e:ON")) != EOF) {
         switch (optchar) {
         case 'x':
             db_args_size++;
@@ -301,6 +460,9 @@ kadmin_startup(int argc, char *argv[])
         case 'q':
             query = optarg;
             break;
+        case 'b':
+            bulk_mode = 1;
+            break;
         case 'd':
             /* db_name has to be passed as part of the db_args. */
             free(db_name);
@@ -349,7 +511,8 @@ kadmin_startup(int argc, char *argv[])
     if ((ccache_name && use_keytab) ||
         (keytab_name && !use_keytab) ||
         (ccache_name && use_anonymous) ||
-        (use_anonymous && use_keytab))
+        (use_anonymous && use_keytab) ||
+        (bulk_mode && query != NULL))
         usage();
 
     if (def_realm == NULL && krb5_get_default_realm(context, &def_realm)) {
@@ -730,6 +893,7 @@ kadmin_cpw(int argc, char *argv[])
     krb5_boolean keepold = FALSE;
     krb5_key_salt_tuple *ks_tuple = NULL;
     krb5_principal princ = NULL;
+    kadm5_principal_ent_rec rec;
     char **db_args = NULL;
     int db_args_size = 0;
 
@@ -797,6 +961,22 @@ kadmin_cpw(int argc, char *argv[])
                 _("while canonicalizing principal"));
         goto cleanup;
     }
+    if (bulk_mode && !randkey && pwarg == NULL) {
+        /* Standard input holds the requests, not passwords. */
+        com_err("change_password", 0,
+                _("-pw or -randkey is required in bulk mode"));
+        goto cleanup;
+    }
+    if (bulk_mode && randkey && pwarg == NULL) {
+        memset(&rec, 0, sizeof(rec));
+        rec.principal = princ;
+        batch_queue(KADM5_BATCH_RANDKEY, &rec, 0, keepold, n_ks_tuple,
+                    ks_tuple, NULL, canon);
+        princ = NULL;
+        ks_tuple = NULL;
+        goto cleanup;
+    }
+    kadmin_batch_flush();
     if (pwarg != NULL) {
         if (keepold || ks_tuple != NULL) {
             retval = kadm5_chpass_principal_3(handle, princ, keepold,
@@ -1191,12 +1371,18 @@ kadmin_addprinc(int argc, char *argv[])
      * unset, since it is never valid for kadm5_create_principal.
      */
     if (!(mask & KADM5_POLICY) && !(mask & KADM5_POLICY_CLR)) {
-        if (!kadm5_get_policy(handle, "default", &defpol)) {
+        if (batch_default_policy == -1 || !bulk_mode) {
+            batch_default_policy = 0;
+            if (!kadm5_get_policy(handle, "default", &defpol)) {
+                batch_default_policy = 1;
+                kadm5_free_policy_ent(handle, &defpol);
+            }
+        }
+        if (batch_default_policy == 1) {
             fprintf(stderr, _("NOTICE: no policy specified for %s; "
                               "assigning \"default\"\n"), canon);
             princ.policy = "default";
             mask |= KADM5_POLICY;
-            kadm5_free_policy_ent(handle, &defpol);
         } else
             fprintf(stderr, _("WARNING: no policy specified for %s; "
                               "defaulting to no policy\n"), canon);
@@ -1208,6 +1394,13 @@ kadmin_addprinc(int argc, char *argv[])
     } else if (pass == NULL) {
         unsigned int sz = sizeof(newpw) - 1;
 
+        if (bulk_mode) {
+            /* Standard input holds the requests, not passwords. */
+            com_err("add_principal", 0,
+                    _("-pw or -randkey is required in bulk mode"));
+            goto cleanup;
+        }
+
         snprintf(prompt1, sizeof(prompt1),
                  _("Enter password for principal \"%s\""), canon);
         snprintf(prompt2, sizeof(prompt2),
@@ -1221,6 +1414,15 @@ kadmin_addprinc(int argc, char *argv[])
         pass = newpw;
     }
     mask |= KADM5_PRINCIPAL;
+    if (bulk_mode) {
+        batch_queue(KADM5_BATCH_CREATE, &princ, mask, FALSE, n_ks_tuple,
+                    ks_tuple, pass, canon);
+        princ.principal = NULL;
+        princ.tl_data = NULL;
+        princ.n_tl_data = 0;
+        ks_tuple = NULL;
+        goto cleanup;
+    }
     retval = create_princ(&princ, mask, n_ks_tuple, ks_tuple, pass);
     if (retval == EINVAL && randkey) {
         /*
@@ -1295,6 +1497,9 @@ kadmin_modprinc(int argc, char *argv[])
                 _("while canonicalizing principal"));
         goto cleanup;
     }
+    /* Queued changes to this principal must be visible to the lookup. */
+    if (batch_pending(kprinc))
+        kadmin_batch_flush();
     retval = kadm5_get_principal(handle, kprinc, &oldprinc,
                                  KADM5_PRINCIPAL_NORMAL_MASK);
     if (retval) {
@@ -1312,6 +1517,14 @@ kadmin_modprinc(int argc, char *argv[])
         kadmin_modprinc_usage();
         goto cleanup;
     }
+    if (mask && bulk_mode) {
+        batch_queue(KADM5_BATCH_MODIFY, &princ, mask, FALSE, 0, NULL, NULL,
+                    canon);
+        princ.principal = NULL;
+        princ.tl_data = NULL;
+        princ.n_tl_data = 0;
+        goto cleanup;
+    }
     if (mask) {
         /* Skip this if all we're doing is setting certhash. */
         retval = kadm5_modify_principal(handle, &princ, mask);
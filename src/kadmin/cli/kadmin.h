@@ -56,6 +56,9 @@ extern void kadmin_purgekeys(int argc, char *argv[]);
 extern void kadmin_getstrings(int argc, char *argv[]);
 extern void kadmin_setstring(int argc, char *argv[]);
 extern void kadmin_delstring(int argc, char *argv[]);
+extern int kadmin_batchable(const char *line);
+extern void kadmin_batch_flush(void);
+extern void kadmin_batch_barrier(void);
 
 #include "autoconf.h"
 
@@ -76,5 +79,6 @@ extern time_t get_date(char *);
 extern krb5_context context;
 extern char *whoami;
 extern void *handle;
+extern int bulk_mode;
 
 #endif /* __KADMIN_H__ */
@@ -26,6 +26,7 @@
 #include <krb5.h>
 #include <k5-platform.h>
 #include <locale.h>
+#include <ctype.h>
 #include <ss/ss.h>
 #include "kadmin.h"
 
@@ -33,6 +34,42 @@ extern ss_request_table kadmin_cmds;
 extern int exit_status;
 extern char *whoami;
 
+/*
+ * Execute requests read from standard input, one per line.  Runs of
+ * principal-creation and modification requests are queued by the request
+ * handlers and flushed as a single batch; any other request flushes the
+ * queue before it runs so that it sees the results.
+ */
+static void
+run_bulk(int sci_idx)
+{
+    char line[BUFSIZ], *cp;
+    int code, c;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        cp = strchr(line, '\n');
+        if (cp != NULL) {
+            *cp = '\0';
+        } else if (!feof(stdin)) {
+            fprintf(stderr, _("%s: request line too long\n"), whoami);
+            exit_status++;
+            while ((c = getchar()) != EOF && c != '\n');
+            continue;
+        }
+        for (cp = line; isspace((unsigned char)*cp); cp++);
+        if (*cp == '\0' || *cp == '#')
+            continue;
+        if (!kadmin_batchable(cp))
+            kadmin_batch_barrier();
+        code = ss_execute_line(sci_idx, cp);
+        if (code != 0) {
+            ss_perror(sci_idx, code, cp);
+            exit_status++;
+        }
+    }
+    kadmin_batch_flush();
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -55,6 +92,8 @@ main(int argc, char *argv[])
             ss_perror(sci_idx, code, request);
             exit_status++;
         }
+    } else if (bulk_mode) {
+        run_bulk(sci_idx);
     } else
         retval = ss_listen(sci_idx);
     return quit() ? 1 : exit_status;
@@ -71,6 +71,9 @@ static int      recursive;
 #define FLAG_UPDATE     0x2     /* processing an update */
 #define FLAG_OMIT_NRA   0x4     /* avoid dumping non-replicated attrs */
 
+/* Use large stdio buffers for dump files to avoid small reads and writes. */
+#define DUMP_STDIO_BUFSIZ       (1024 * 1024)
+
 struct dump_args {
     char                *programname;
     FILE                *ofile;
@@ -99,6 +102,8 @@ static krb5_error_code dump_ov_princ (krb5_pointer,
 static void dump_k5beta7_policy (void *, osa_policy_ent_t);
 static void dump_r1_8_policy (void *, osa_policy_ent_t);
 static void dump_r1_11_policy (void *, osa_policy_ent_t);
+static krb5_error_code dump_binary_princ (krb5_pointer, krb5_db_entry *);
+static void dump_binary_policy (void *, osa_policy_ent_t);
 
 typedef krb5_error_code (*dump_func)(krb5_pointer,
                                      krb5_db_entry *);
@@ -115,6 +120,8 @@ static int process_r1_11_record (char *, krb5_context,
                                 FILE *, int, int *);
 static int process_ov_record (char *, krb5_context,
                               FILE *, int, int *);
+static int process_binary_record (char *, krb5_context,
+                                  FILE *, int, int *);
 typedef krb5_error_code (*load_func)(char *, krb5_context,
                                      FILE *, int, int *);
 
@@ -201,6 +208,15 @@ dump_version r1_11_version = {
     dump_r1_11_policy,
     process_r1_11_record,
 };
+dump_version binary_version = {
+    "Kerberos version 5 binary format",
+    "kdb5_util load_dump binary version 1\n",
+    0,
+    0,
+    dump_binary_princ,
+    dump_binary_policy,
+    process_binary_record,
+};
 dump_version ipropx_1_version = {
     "Kerberos iprop extensible version",
     "ipropx",
@@ -287,6 +303,7 @@ static const char hashoption[] = "-hash";
 static const char ovoption[] = "-ov";
 static const char r13option[] = "-r13";
 static const char r18option[] = "-r18";
+static const char binaryoption[] = "-binary";
 static const char dump_tmptrail[] = "~";
 
 /*
@@ -1006,6 +1023,199 @@ dump_r1_11_policy(void *data, osa_policy_ent_t entry)
     fprintf(arg->ofile, "\n");
 }
 
+/*
+ * The binary dump format consists of the text header line followed by a
+ * sequence of records.  Each record is a one-byte record type, a four-byte
+ * big-endian payload length, and the payload.  Within a payload, integers
+ * are stored big-endian and byte strings are preceded by a four-byte length,
+ * so a loader can read a whole record with one fread() and decode it without
+ * any text parsing.
+ */
+#define BINARY_PRINC_RECORD     'P'
+#define BINARY_POLICY_RECORD    'Y'
+
+
+static void
+put_16(struct k5buf *buf, unsigned int val)
+{
+    unsigned char b[2];
+
+    store_16_be(val, b);
+    krb5int_buf_add_len(buf, (char *)b, 2);
+}
+
+static void
+put_32(struct k5buf *buf, krb5_ui_4 val)
+{
+    unsigned char b[4];
+
+    store_32_be(val, b);
+    krb5int_buf_add_len(buf, (char *)b, 4);
+}
+
+static void
+put_bytes(struct k5buf *buf, const void *data, unsigned int len)
+{
+    put_32(buf, len);
+    if (len > 0)
+        krb5int_buf_add_len(buf, data, len);
+}
+
+static void
+put_tl_data(struct k5buf *buf, krb5_int16 n_tl_data, krb5_tl_data *tl)
+{
+    put_16(buf, n_tl_data);
+    for (; tl != NULL; tl = tl->tl_data_next) {
+        put_16(buf, tl->tl_data_type);
+        put_bytes(buf, tl->tl_data_contents, tl->tl_data_length);
+    }
+}
+
+/*
+ * Write a binary record of type rectype whose payload is contained in
+ * payload, and free payload.  The header is built in payload's reserved
+ * first five bytes so that each record is a single fwrite().
+ */
+static krb5_error_code
+write_binary_record(FILE *f, char rectype, struct k5buf *payload)
+{
+    char *data = krb5int_buf_data(payload);
+    ssize_t len = krb5int_buf_len(payload);
+    krb5_error_code ret = 0;
+
+    if (data == NULL) {
+        krb5int_free_buf(payload);
+        return ENOMEM;
+    }
+    data[0] = rectype;
+    store_32_be(len - 5, data + 1);
+    if (fwrite(data, 1, len, f) != (size_t)len)
+        ret = errno;
+    krb5int_free_buf(payload);
+    return ret;
+}
+
+/* Initialize a record payload buffer with room for the record header. */
+static void
+init_binary_payload(struct k5buf *payload)
+{
+    krb5int_buf_init_dynamic(payload);
+    krb5int_buf_add_len(payload, "\0\0\0\0\0", 5);
+}
+
+/*
+ * dump_binary_princ()  - Output a principal record in binary format.
+ */
+static krb5_error_code
+dump_binary_princ(krb5_pointer ptr, krb5_db_entry *entry)
+{
+    krb5_error_code retval;
+    struct dump_args *arg = ptr;
+    struct k5buf buf;
+    krb5_key_data *kdata;
+    krb5_tl_data *tlp;
+    char *name = NULL;
+    int omit_nra = (arg->flags & FLAG_OMIT_NRA), i, j, count;
+
+    retval = krb5_unparse_name(arg->kcontext, entry->princ, &name);
+    if (retval) {
+        fprintf(stderr, pname_unp_err,
+                arg->programname, error_message(retval));
+        return retval;
+    }
+    if (arg->nnames && !name_matches(name, arg))
+        goto cleanup;
+
+    if (mkey_convert) {
+        retval = master_key_convert(arg->kcontext, entry);
+        if (retval) {
+            com_err(arg->programname, retval, remaster_err_fmt, name);
+            goto cleanup;
+        }
+    }
+
+    count = 0;
+    for (tlp = entry->tl_data; tlp != NULL; tlp = tlp->tl_data_next)
+        count++;
+    if (count != entry->n_tl_data) {
+        fprintf(stderr, sdump_tl_inc_err, arg->programname, name, count,
+                (int)entry->n_tl_data);
+        retval = EINVAL;
+        goto cleanup;
+    }
+
+    init_binary_payload(&buf);
+    put_16(&buf, entry->len);
+    put_32(&buf, entry->attributes);
+    put_32(&buf, entry->max_life);
+    put_32(&buf, entry->max_renewable_life);
+    put_32(&buf, entry->expiration);
+    put_32(&buf, entry->pw_expiration);
+    put_32(&buf, omit_nra ? 0 : entry->last_success);
+    put_32(&buf, omit_nra ? 0 : entry->last_failed);
+    put_32(&buf, omit_nra ? 0 : entry->fail_auth_count);
+    put_bytes(&buf, name, strlen(name));
+    put_tl_data(&buf, entry->n_tl_data, entry->tl_data);
+    put_16(&buf, entry->n_key_data);
+    for (i = 0; i < entry->n_key_data; i++) {
+        kdata = &entry->key_data[i];
+        put_16(&buf, kdata->key_data_ver);
+        put_16(&buf, kdata->key_data_kvno);
+        for (j = 0; j < kdata->key_data_ver; j++) {
+            put_16(&buf, kdata->key_data_type[j]);
+            put_bytes(&buf, kdata->key_data_contents[j],
+                      kdata->key_data_length[j]);
+        }
+    }
+    put_bytes(&buf, entry->e_data, entry->e_length);
+
+    retval = write_binary_record(arg->ofile, BINARY_PRINC_RECORD, &buf);
+    if (retval)
+        goto cleanup;
+    if (arg->flags & FLAG_VERBOSE)
+        fprintf(stderr, "%s\n", name);
+
+cleanup:
+    free(name);
+    return retval;
+}
+
+/*
+ * dump_binary_policy() - Output a policy record in binary format.
+ */
+static void
+dump_binary_policy(void *data, osa_policy_ent_t entry)
+{
+    struct dump_args *arg = data;
+    struct k5buf buf;
+    const char *ks = entry->allowed_keysalts;
+
+    init_binary_payload(&buf);
+    put_bytes(&buf, entry->name, strlen(entry->name));
+    put_32(&buf, entry->pw_min_life);
+    put_32(&buf, entry->pw_max_life);
+    put_32(&buf, entry->pw_min_length);
+    put_32(&buf, entry->pw_min_classes);
+    put_32(&buf, entry->pw_history_num);
+    put_32(&buf, entry->policy_refcnt);
+    put_32(&buf, entry->pw_max_fail);
+    put_32(&buf, entry->pw_failcnt_interval);
+    put_32(&buf, entry->pw_lockout_duration);
+    put_32(&buf, entry->attributes);
+    put_32(&buf, entry->max_life);
+    put_32(&buf, entry->max_renewable_life);
+    put_bytes(&buf, ks, (ks == NULL) ? 0 : strlen(ks));
+    put_tl_data(&buf, entry->n_tl_data, entry->tl_data);
+
+    if (write_binary_record(arg->ofile, BINARY_POLICY_RECORD, &buf) != 0) {
+        fprintf(stderr, _("%s: cannot write policy %s\n"), arg->programname,
+                entry->name);
+        exit_status++;
+    } else if (arg->flags & FLAG_VERBOSE) {
+        fprintf(stderr, "%s\n", entry->name);
+    }
+}
+
 static void print_key_data(FILE *f, krb5_key_data *key_data)
 {
     int c;
@@ -1116,7 +1326,7 @@ static krb5_error_code dump_ov_princ(krb5_pointer ptr, krb5_db_entry *kdb)
 
 /*
  * usage is:
- *      dump_db [-old] [-b6] [-b7] [-ov] [-r13] [-r18] [-verbose]
+ *      dump_db [-old] [-b6] [-b7] [-ov] [-r13] [-r18] [-binary] [-verbose]
  *              [-mkey_convert] [-new_mkey_file mkey_file] [-rev]
  *              [-recurse] [filename [principals...]]
  */
@@ -1165,6 +1375,8 @@ dump_db(argc, argv)
             dump = &r1_3_version;
         else if (!strcmp(argv[aindex], r18option))
             dump = &r1_8_version;
+        else if (!strcmp(argv[aindex], binaryoption))
+            dump = &binary_version;
         else if (!strncmp(argv[aindex], ipropoption, sizeof(ipropoption) - 1)) {
             if (log_ctx && log_ctx->iproprole) {
                 /* Note: ipropx_version is the maximum version acceptable */
@@ -1331,6 +1543,8 @@ dump_db(argc, argv)
         arglist.programname = progname;
         arglist.ofile = f;
         arglist.kcontext = util_context;
+        if (f != stdout)
+            setvbuf(f, NULL, _IOFBF, DUMP_STDIO_BUFSIZ);
         fprintf(arglist.ofile, "%s", dump->header);
 
         if (dump_sno) {
@@ -1372,6 +1586,11 @@ dump_db(argc, argv)
                     error_message(kret));
             exit_status++;
         }
+        if (fflush(f) != 0 || ferror(f)) {
+            fprintf(stderr, dumprec_err, progname, dump->name,
+                    error_message(errno));
+            exit_status++;
+        }
         if (ofile && f != stdout && !exit_status) {
             if (locked) {
                 (void) krb5_lock_file(util_context, fileno(f), KRB5_LOCKMODE_UNLOCK);
@@ -1873,6 +2092,41 @@ alloc_tl_data(krb5_int16 n_tl_data, krb5_tl_data **tldp)
     return 0;
 }
 
+/* Set the load mask bits implied by dbentry's tagged data. */
+static void
+set_tl_data_mask(krb5_db_entry *dbentry)
+{
+    krb5_tl_data *tl;
+
+    for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
+        /* test to set mask fields */
+        if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
+            XDR xdrs;
+            osa_princ_ent_rec osa_princ_ent;
+
+            /*
+             * Assuming aux_attributes will always be
+             * there
+             */
+            dbentry->mask |= KADM5_AUX_ATTRIBUTES;
+
+            /* test for an actual policy reference */
+            memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
+            xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
+                          tl->tl_data_length, XDR_DECODE);
+            if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent) &&
+                (osa_princ_ent.aux_attributes & KADM5_POLICY) &&
+                osa_princ_ent.policy != NULL) {
+
+                dbentry->mask |= KADM5_POLICY;
+                kdb_free_entry(NULL, NULL, &osa_princ_ent);
+            }
+            xdr_destroy(&xdrs);
+        }
+    }
+    dbentry->mask |= KADM5_TL_DATA;
+}
+
 /* Read TL data; common to principals and policies */
 static int
 process_tl_data(const char *fname, FILE *filep, krb5_tl_data *tl_data,
@@ -1931,7 +2185,6 @@ process_k5beta6_record(char *fname, krb5_context kcontext, FILE *filep,
     int                 i, j;
     char                *name;
     krb5_key_data       *kp, *kdatap;
-    krb5_tl_data        *tl;
     krb5_octet          *op;
     krb5_error_code     kret;
     const char          *try2read = read_header;
@@ -2033,33 +2286,7 @@ process_k5beta6_record(char *fname, krb5_context kcontext, FILE *filep,
     if (dbentry->n_tl_data) {
         if (process_tl_data(fname, filep, dbentry->tl_data, &try2read))
             goto cleanup;
-        for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
-            /* test to set mask fields */
-            if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
-                XDR xdrs;
-                osa_princ_ent_rec osa_princ_ent;
-
-                /*
-                 * Assuming aux_attributes will always be
-                 * there
-                 */
-                dbentry->mask |= KADM5_AUX_ATTRIBUTES;
-
-                /* test for an actual policy reference */
-                memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
-                xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
-                              tl->tl_data_length, XDR_DECODE);
-                if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent) &&
-                    (osa_princ_ent.aux_attributes & KADM5_POLICY) &&
-                    osa_princ_ent.policy != NULL) {
-
-                    dbentry->mask |= KADM5_POLICY;
-                    kdb_free_entry(NULL, NULL, &osa_princ_ent);
-                }
-                xdr_destroy(&xdrs);
-            }
-        }
-        dbentry->mask |= KADM5_TL_DATA;
+        set_tl_data_mask(dbentry);
     }
 
     /* Get the key data */
@@ -2455,6 +2682,312 @@ process_r1_11_record(char *fname, krb5_context kcontext, FILE *filep,
     return 0;
 }
 
+/* Cursor over the payload of a binary dump record. */
+struct binary_reader {
+    const unsigned char *ptr;
+    size_t len;
+    krb5_boolean bad;
+};
+
+static unsigned int
+get_16(struct binary_reader *r)
+{
+    unsigned int val;
+
+    if (r->len < 2) {
+        r->bad = TRUE;
+        return 0;
+    }
+    val = load_16_be(r->ptr);
+    r->ptr += 2;
+    r->len -= 2;
+    return val;
+}
+
+static krb5_ui_4
+get_32(struct binary_reader *r)
+{
+    krb5_ui_4 val;
+
+    if (r->len < 4) {
+        r->bad = TRUE;
+        return 0;
+    }
+    val = load_32_be(r->ptr);
+    r->ptr += 4;
+    r->len -= 4;
+    return val;
+}
+
+/*
+ * Read a counted byte string of at most maxlen bytes into an allocated,
+ * zero-terminated buffer.  A zero-length string yields a NULL *data_out
+ * unless want_empty is set.  Returns nonzero on a decoding or allocation
+ * failure.
+ */
+static int
+get_bytes(struct binary_reader *r, size_t maxlen, krb5_boolean want_empty,
+          void **data_out, unsigned int *len_out)
+{
+    krb5_ui_4 len = get_32(r);
+    char *data;
+
+    *data_out = NULL;
+    *len_out = 0;
+    if (r->bad || len > r->len || len > maxlen) {
+        r->bad = TRUE;
+        return 1;
+    }
+    if (len == 0 && !want_empty)
+        return 0;
+    data = malloc(len + 1);
+    if (data == NULL)
+        return 1;
+    memcpy(data, r->ptr, len);
+    data[len] = '\0';
+    r->ptr += len;
+    r->len -= len;
+    *data_out = data;
+    *len_out = len;
+    return 0;
+}
+
+/* Read a binary tagged data list into a newly allocated linked list. */
+static int
+get_tl_data(struct binary_reader *r, krb5_int16 *n_out, krb5_tl_data **tl_out)
+{
+    krb5_tl_data *tl;
+    unsigned int n, len;
+    void *contents;
+
+    n = get_16(r);
+    if (r->bad || n > 0x7fff)
+        return 1;
+    *n_out = n;
+    if (alloc_tl_data(n, tl_out))
+        return 1;
+    for (tl = *tl_out; tl != NULL; tl = tl->tl_data_next) {
+        tl->tl_data_type = get_16(r);
+        if (get_bytes(r, 0xffff, FALSE, &contents, &len))
+            return 1;
+        tl->tl_data_contents = contents;
+        tl->tl_data_length = len;
+    }
+    return 0;
+}
+
+/* Decode and store a binary principal record. */
+static int
+process_binary_princ(char *fname, krb5_context kcontext,
+                     struct binary_reader *r, int flags, int *linenop)
+{
+    int retval = 1;
+    krb5_db_entry *dbentry;
+    krb5_key_data *kdatap;
+    krb5_error_code kret;
+    unsigned int n, len;
+    void *contents;
+    char *name = NULL;
+    int i, j;
+
+    dbentry = krb5_db_alloc(kcontext, NULL, sizeof(*dbentry));
+    if (dbentry == NULL)
+        return 1;
+    memset(dbentry, 0, sizeof(*dbentry));
+
+    dbentry->len = get_16(r);
+    dbentry->attributes = get_32(r);
+    dbentry->max_life = get_32(r);
+    dbentry->max_renewable_life = get_32(r);
+    dbentry->expiration = get_32(r);
+    dbentry->pw_expiration = get_32(r);
+    dbentry->last_success = get_32(r);
+    dbentry->last_failed = get_32(r);
+    dbentry->fail_auth_count = get_32(r);
+    dbentry->mask = KADM5_LOAD | KADM5_PRINCIPAL | KADM5_ATTRIBUTES |
+        KADM5_MAX_LIFE | KADM5_MAX_RLIFE |
+        KADM5_PRINC_EXPIRE_TIME | KADM5_LAST_SUCCESS |
+        KADM5_LAST_FAILED | KADM5_FAIL_AUTH_COUNT;
+
+    if (get_bytes(r, SIZE_MAX, TRUE, &contents, &len))
+        goto cleanup;
+    name = contents;
+    kret = krb5_parse_name(kcontext, name, &dbentry->princ);
+    if (kret) {
+        fprintf(stderr, parse_err_fmt, fname, *linenop, name,
+                error_message(kret));
+        goto cleanup;
+    }
+
+    if (get_tl_data(r, &dbentry->n_tl_data, &dbentry->tl_data))
+        goto cleanup;
+    if (dbentry->n_tl_data)
+        set_tl_data_mask(dbentry);
+
+    n = get_16(r);
+    if (r->bad || n > 0x7fff)
+        goto cleanup;
+    if (n > 0) {
+        dbentry->key_data = calloc(n, sizeof(krb5_key_data));
+        if (dbentry->key_data == NULL)
+            goto cleanup;
+        dbentry->n_key_data = n;
+        dbentry->mask |= KADM5_KEY_DATA;
+    }
+    for (i = 0; i < dbentry->n_key_data; i++) {
+        kdatap = &dbentry->key_data[i];
+        kdatap->key_data_ver = get_16(r);
+        kdatap->key_data_kvno = get_16(r);
+        if (kdatap->key_data_ver < 0 ||
+            kdatap->key_data_ver > KRB5_KDB_V1_KEY_DATA_ARRAY)
+            r->bad = TRUE;
+        for (j = 0; !r->bad && j < kdatap->key_data_ver; j++) {
+            kdatap->key_data_type[j] = get_16(r);
+            if (get_bytes(r, 0xffff, FALSE, &contents, &len))
+                goto cleanup;
+            kdatap->key_data_contents[j] = contents;
+            kdatap->key_data_length[j] = len;
+        }
+    }
+
+    if (get_bytes(r, 0xffff, FALSE, &contents, &len))
+        goto cleanup;
+    dbentry->e_data = contents;
+    dbentry->e_length = len;
+
+    if (r->bad || r->len != 0)
+        goto cleanup;
+
+    kret = krb5_db_put_principal(kcontext, dbentry);
+    if (kret) {
+        fprintf(stderr, store_err_fmt, fname, *linenop, name,
+                error_message(kret));
+        goto cleanup;
+    }
+
+    if (flags & FLAG_VERBOSE)
+        fprintf(stderr, add_princ_fmt, name);
+    retval = 0;
+
+cleanup:
+    if (retval && r->bad)
+        fprintf(stderr, read_err_fmt, fname, *linenop, read_header);
+    free(name);
+    krb5_db_free_principal(kcontext, dbentry);
+    return retval;
+}
+
+/* Decode and store a binary policy record. */
+static int
+process_binary_policy(char *fname, krb5_context kcontext,
+                      struct binary_reader *r, int flags, int *linenop)
+{
+    osa_policy_ent_rec rec;
+    krb5_tl_data *tl, *tl_next;
+    unsigned int len;
+    void *contents;
+    int ret = 1;
+
+    memset(&rec, 0, sizeof(rec));
+
+    if (get_bytes(r, 1023, TRUE, &contents, &len))
+        goto cleanup;
+    rec.name = contents;
+    rec.pw_min_life = get_32(r);
+    rec.pw_max_life = get_32(r);
+    rec.pw_min_length = get_32(r);
+    rec.pw_min_classes = get_32(r);
+    rec.pw_history_num = get_32(r);
+    rec.policy_refcnt = get_32(r);
+    rec.pw_max_fail = get_32(r);
+    rec.pw_failcnt_interval = get_32(r);
+    rec.pw_lockout_duration = get_32(r);
+    rec.attributes = get_32(r);
+    rec.max_life = get_32(r);
+    rec.max_renewable_life = get_32(r);
+    if (get_bytes(r, KRB5_KDB_MAX_ALLOWED_KS_LEN, FALSE, &contents, &len))
+        goto cleanup;
+    rec.allowed_keysalts = contents;
+    if (get_tl_data(r, &rec.n_tl_data, &rec.tl_data))
+        goto cleanup;
+    if (r->bad || r->len != 0) {
+        fprintf(stderr, _("cannot parse policy in record %d\n"), *linenop);
+        goto cleanup;
+    }
+
+    if ((ret = krb5_db_create_policy(kcontext, &rec)) &&
+        (ret = krb5_db_put_policy(kcontext, &rec))) {
+        fprintf(stderr, _("cannot create policy in record %d: %s\n"),
+                *linenop, error_message(ret));
+        ret = 1;
+        goto cleanup;
+    }
+    if (flags & FLAG_VERBOSE)
+        fprintf(stderr, _("created policy %s\n"), rec.name);
+
+cleanup:
+    for (tl = rec.tl_data; tl; tl = tl_next) {
+        tl_next = tl->tl_data_next;
+        free(tl->tl_data_contents);
+        free(tl);
+    }
+    free(rec.allowed_keysalts);
+    free(rec.name);
+    return ret;
+}
+
+/*
+ * process_binary_record()      - Handle a dump record in binary format.
+ *
+ * Records are counted in place of lines.  Returns -1 for end of file, 0 for
+ * success and 1 for failure.
+ */
+static int
+process_binary_record(char *fname, krb5_context kcontext, FILE *filep,
+                      int flags, int *linenop)
+{
+    unsigned char hdr[5], *payload;
+    struct binary_reader r;
+    size_t nread;
+    krb5_ui_4 len;
+    int ret;
+
+    nread = fread(hdr, 1, sizeof(hdr), filep);
+    if (nread == 0 && feof(filep))
+        return -1;
+    (*linenop)++;
+    if (nread != sizeof(hdr)) {
+        fprintf(stderr, read_err_fmt, fname, *linenop, read_header);
+        return 1;
+    }
+    len = load_32_be(hdr + 1);
+    payload = malloc(len ? len : 1);
+    if (payload == NULL) {
+        fprintf(stderr, no_mem_fmt, fname, *linenop);
+        return 1;
+    }
+    if (fread(payload, 1, len, filep) != len) {
+        fprintf(stderr, read_err_fmt, fname, *linenop, read_header);
+        free(payload);
+        return 1;
+    }
+
+    r.ptr = payload;
+    r.len = len;
+    r.bad = FALSE;
+    if (hdr[0] == BINARY_PRINC_RECORD) {
+        ret = process_binary_princ(fname, kcontext, &r, flags, linenop);
+    } else if (hdr[0] == BINARY_POLICY_RECORD) {
+        ret = process_binary_policy(fname, kcontext, &r, flags, linenop);
+    } else {
+        fprintf(stderr, _("unknown record type %d in record %d\n"),
+                (int)hdr[0], *linenop);
+        ret = 1;
+    }
+    free(payload);
+    return ret;
+}
+
 /*
  * restore_dump()       - Restore the database from any version dump file.
  */
@@ -2491,7 +3024,7 @@ restore_dump(programname, kcontext, dumpfile, f, flags, dump)
 }
 
 /*
- * Usage: load_db [-old] [-ov] [-b6] [-b7] [-r13] [-verbose]
+ * Usage: load_db [-old] [-ov] [-b6] [-b7] [-r13] [-binary] [-verbose]
  *                [-update] [-hash] filename
  */
 void
@@ -2541,6 +3074,8 @@ load_db(argc, argv)
             load = &r1_3_version;
         else if (!strcmp(argv[aindex], r18option))
             load = &r1_8_version;
+        else if (!strcmp(argv[aindex], binaryoption))
+            load = &binary_version;
         else if (!strcmp(argv[aindex], ipropoption)) {
             if (log_ctx && log_ctx->iproprole) {
                 load = &iprop_version;
@@ -2568,6 +3103,9 @@ load_db(argc, argv)
         return;
     }
     dumpfile = argv[aindex];
+    /* Read the dump from standard input if the filename is "-". */
+    if (!strcmp(dumpfile, "-"))
+        dumpfile = NULL;
 
     /*
      * Initialize the Kerberos context and error tables.
@@ -2608,6 +3146,8 @@ load_db(argc, argv)
     } else
         f = stdin;
 
+    setvbuf(f, NULL, _IOFBF, DUMP_STDIO_BUFSIZ);
+
     /*
      * Auto-detect dump version if we weren't told, verify if we
      * were told.
@@ -2617,7 +3157,8 @@ load_db(argc, argv)
         /* only check what we know; some headers only contain a prefix */
         /* NB: this should work for ipropx even though load is iprop */
         if (strncmp(buf, load->header, strlen(load->header)) != 0) {
-            fprintf(stderr, head_bad_fmt, progname, dumpfile);
+            fprintf(stderr, head_bad_fmt, progname,
+                    (dumpfile) ? dumpfile : stdin_name);
             exit_status++;
             if (dumpfile) fclose(f);
             return;
@@ -2636,11 +3177,14 @@ load_db(argc, argv)
             load = &r1_8_version;
         else if (strcmp(buf, r1_11_version.header) == 0)
             load = &r1_11_version;
+        else if (strcmp(buf, binary_version.header) == 0)
+            load = &binary_version;
         else if (strncmp(buf, ov_version.header,
                          strlen(ov_version.header)) == 0)
             load = &ov_version;
         else {
-            fprintf(stderr, head_bad_fmt, progname, dumpfile);
+            fprintf(stderr, head_bad_fmt, progname,
+                    (dumpfile) ? dumpfile : stdin_name);
             exit_status++;
             if (dumpfile) fclose(f);
             return;
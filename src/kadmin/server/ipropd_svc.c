@@ -346,8 +346,10 @@ ipropx_resync(uint32_t vers, struct svc_req *rqstp)
     /*
      * Fork to dump the db and xfer it to the slave.
      * (the fork allows parent to return quickly and the child
-     * acts like a callback to the slave).
+     * acts like a callback to the slave).  Flush buffered log records
+     * first so the child doesn't write them again.
      */
+    krb5_klog_flush(handle->context);
     fret = fork();
     DPRINT(("%s: fork=%d (%d)\n", whoami, fret, getpid()));
 
@@ -61,6 +61,7 @@ void kadm_1(rqstp, transp)
 	  chpass3_arg chpass_principal3_2_arg;
 	  chrand3_arg chrand_principal3_2_arg;
 	  setkey3_arg setkey_principal3_2_arg;
+	  batch_arg batch_principals_2_arg;
      } argument;
      char *result;
      bool_t (*xdr_argument)(), (*xdr_result)();
@@ -225,6 +226,12 @@ void kadm_1(rqstp, transp)
 	  local = (char *(*)()) set_string_2_svc;
 	  break;
 
+     case BATCH_PRINCIPALS:
+	  xdr_argument = xdr_batch_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (char *(*)()) batch_principals_2_svc;
+	  break;
+
      default:
 	  krb5_klog_syslog(LOG_ERR, "Invalid KADM5 procedure number: %s, %d",
 		 inet_ntoa(rqstp->rq_xprt->xp_raddr.sin_addr),
@@ -41,6 +41,7 @@
 #endif
 #include    <sys/time.h>
 #include    <sys/socket.h>
+#include    <sys/wait.h>
 #include    <unistd.h>
 #include    <netinet/in.h>
 #include    <arpa/inet.h>  /* inet_ntoa */
@@ -108,7 +109,7 @@ static void usage()
 {
     fprintf(stderr, _("Usage: kadmind [-x db_args]* [-r realm] [-m] [-nofork] "
                       "[-port port-number]\n"
-                      "\t\t[-P pid_file]\n"
+                      "\t\t[-P pid_file] [-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -197,6 +198,174 @@ write_pid_file(const char *pid_file)
     return 0;
 }
 
+static volatile int signal_received = 0;
+static volatile int sighup_received = 0;
+
+static krb5_sigtype
+on_monitor_signal(int signo)
+{
+    signal_received = signo;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+static krb5_sigtype
+on_monitor_sighup(int signo)
+{
+    sighup_received = 1;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+/*
+ * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
+ * are set to -1, and wait for them to exit (so that we know the ports are no
+ * longer in use).
+ */
+static void
+terminate_workers(pid_t *pids, int bound)
+{
+    int i, status, num_active = 0;
+    pid_t pid;
+
+    for (i = 0; i < bound; i++) {
+        if (pids[i] == -1)
+            continue;
+        kill(pids[i], SIGTERM);
+        num_active++;
+    }
+    while (num_active > 0) {
+        pid = wait(&status);
+        if (pid >= 0)
+            num_active--;
+    }
+}
+
+/*
+ * Create num worker processes and return successfully in each child.  The
+ * parent process will act as a supervisor and will only return from this
+ * function in error cases.  Each worker accepts its own connections and
+ * processes their requests to completion, so a slow request only holds up the
+ * worker handling it.  Workers serialize their update log writes with the
+ * same lock used between kadmind and kadmin.local.
+ */
+static krb5_error_code
+create_workers(verto_ctx *ctx, int num)
+{
+    krb5_error_code retval;
+    int i, status;
+    pid_t pid, *pids;
+#ifdef POSIX_SIGNALS
+    struct sigaction s_action;
+#endif /* POSIX_SIGNALS */
+
+    /*
+     * Setup our signal handlers which will forward to the children.
+     * These handlers will be overriden in the child processes.
+     */
+#ifdef POSIX_SIGNALS
+    (void) sigemptyset(&s_action.sa_mask);
+    s_action.sa_flags = 0;
+    s_action.sa_handler = on_monitor_signal;
+    (void) sigaction(SIGINT, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGTERM, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGQUIT, &s_action, (struct sigaction *) NULL);
+    s_action.sa_handler = on_monitor_sighup;
+    (void) sigaction(SIGHUP, &s_action, (struct sigaction *) NULL);
+#else  /* POSIX_SIGNALS */
+    signal(SIGINT, on_monitor_signal);
+    signal(SIGTERM, on_monitor_signal);
+    signal(SIGQUIT, on_monitor_signal);
+    signal(SIGHUP, on_monitor_sighup);
+#endif /* POSIX_SIGNALS */
+
+    /* Create child worker processes; return in each child. */
+    krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), num);
+    krb5_klog_flush(NULL);
+    pids = calloc(num, sizeof(pid_t));
+    if (pids == NULL)
+        return ENOMEM;
+    for (i = 0; i < num; i++) {
+        pid = fork();
+        if (pid == 0) {
+            if (!verto_reinitialize(ctx)) {
+                krb5_klog_syslog(LOG_ERR,
+                                 _("Unable to reinitialize main loop"));
+                return ENOMEM;
+            }
+            retval = loop_setup_signals(ctx, global_server_handle, NULL);
+            if (retval) {
+                krb5_klog_syslog(LOG_ERR, _("Unable to initialize signal "
+                                            "handlers in pid %d"), pid);
+                return retval;
+            }
+
+            /* Avoid race condition */
+            if (signal_received)
+                exit(0);
+
+            /* Return control to main() in the new worker process. */
+            free(pids);
+            return 0;
+        }
+        if (pid == -1) {
+            /* Couldn't fork enough times. */
+            status = errno;
+            terminate_workers(pids, i);
+            free(pids);
+            return status;
+        }
+        pids[i] = pid;
+    }
+
+    /* We're going to use our own main loop here. */
+    loop_free(ctx);
+
+    /* Supervise the worker processes. */
+    while (!signal_received) {
+        /* Wait until a worker process exits or we get a signal. */
+        pid = wait(&status);
+        if (pid >= 0) {
+            krb5_klog_syslog(LOG_ERR, _("worker %ld exited with status %d"),
+                             (long) pid, status);
+
+            /* Remove the pid from the table. */
+            for (i = 0; i < num; i++) {
+                if (pids[i] == pid)
+                    pids[i] = -1;
+            }
+
+            /* When one worker process exits, terminate them all, so that
+             * crashes behave similarly with or without worker processes. */
+            break;
+        }
+
+        /* Propagate HUP signal to worker processes if we received one. */
+        if (sighup_received) {
+            sighup_received = 0;
+            for (i = 0; i < num; i++) {
+                if (pids[i] != -1)
+                    kill(pids[i], SIGHUP);
+            }
+        }
+    }
+    if (signal_received)
+        krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
+                         signal_received);
+
+    terminate_workers(pids, num);
+    free(pids);
+    exit(0);
+}
+
 /* XXX yuck.  the signal handlers need this */
 static krb5_context context;
 
@@ -221,6 +390,7 @@ int main(int argc, char *argv[])
     char *errmsg;
     int i;
     int strong_random = 1;
+    int workers = 0;
     const char *pid_file = NULL;
 
     kdb_log_context *log_ctx;
@@ -299,6 +469,13 @@ int main(int argc, char *argv[])
             pid_file = *argv;
         } else if (strcmp(*argv, "-W") == 0) {
             strong_random = 0;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--; argv++;
+            if (!argc)
+                usage();
+            workers = atoi(*argv);
+            if (workers <= 0)
+                usage();
         } else
             break;
         argc--; argv++;
@@ -368,7 +545,10 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    if ((ret = loop_setup_signals(ctx, global_server_handle, NULL))) {
+    /* With worker processes, signals are handled by create_workers(), and
+     * each worker sets up its own handlers. */
+    if (workers == 0 &&
+        (ret = loop_setup_signals(ctx, global_server_handle, NULL))) {
         const char *e_txt = krb5_get_error_message (context, ret);
         krb5_klog_syslog(LOG_ERR, _("%s: %s while initializing signal "
                                     "handlers, aborting"), whoami, e_txt);
@@ -393,7 +573,9 @@ int main(int argc, char *argv[])
             : 0)
 #endif
 #undef server_handle
-        || (ret = loop_setup_routing_socket(ctx, global_server_handle, whoami))
+        || (workers == 0 &&
+            (ret = loop_setup_routing_socket(ctx, global_server_handle,
+                                             whoami)))
         || (ret = loop_setup_network(ctx, global_server_handle, whoami))) {
         const char *e_txt = krb5_get_error_message (context, ret);
         krb5_klog_syslog(LOG_ERR, _("%s: %s while initializing network, "
@@ -637,6 +819,28 @@ kterr:
 #endif
     }
 
+    if (workers > 0) {
+        const char *werrmsg;
+
+        ret = create_workers(ctx, workers);
+        if (ret) {
+            werrmsg = krb5_get_error_message(context, ret);
+            krb5_klog_syslog(LOG_ERR, _("Cannot create worker processes: %s"),
+                             werrmsg);
+            krb5_free_error_message(context, werrmsg);
+            exit(1);
+        }
+        /* We get here only in a worker; give it its own database handle. */
+        ret = kadm5_flush(global_server_handle);
+        if (ret) {
+            werrmsg = krb5_get_error_message(context, ret);
+            krb5_klog_syslog(LOG_ERR, _("Cannot reopen database in worker: "
+                                        "%s"), werrmsg);
+            krb5_free_error_message(context, werrmsg);
+            exit(1);
+        }
+    }
+
     krb5_klog_syslog(LOG_INFO, _("starting"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), whoami);
@@ -747,7 +951,8 @@ void log_badverf(gss_name_t client_name, gss_name_t server_name,
         {21, "SETKEY_PRINCIPAL3"},
         {22, "PURGEKEYS"},
         {23, "GET_STRINGS"},
-        {24, "SET_STRING"}
+        {24, "SET_STRING"},
+        {25, "BATCH_PRINCIPALS"}
     };
 #define NPROCNAMES (sizeof (proc_names) / sizeof (struct procnames))
     OM_uint32 minor;
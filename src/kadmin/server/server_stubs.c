@@ -1217,6 +1217,162 @@ exit_func:
     return &ret;
 }
 
+/* Return the log name of a batch operation type. */
+static char *
+batch_op_name(int op)
+{
+    switch (op) {
+    case KADM5_BATCH_CREATE:
+        return "kadm5_create_principal";
+    case KADM5_BATCH_MODIFY:
+        return "kadm5_modify_principal";
+    case KADM5_BATCH_RANDKEY:
+        return "kadm5_randkey_principal";
+    default:
+        return "kadm5_batch_principals";
+    }
+}
+
+/*
+ * Check the caller's authorization for one batch operation, applying any ACL
+ * restrictions to op.  Return 0 if the operation may proceed or the error to
+ * report for it.
+ */
+static kadm5_ret_t
+check_batch_op(kadm5_server_handle_t handle, struct svc_req *rqstp,
+               kadm5_batch_op_t op)
+{
+    restriction_t *rp;
+
+    switch (op->op) {
+    case KADM5_BATCH_CREATE:
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                   ACL_ADD, op->rec.principal, &rp)
+            || kadm5int_acl_impose_restrictions(handle->context, &op->rec,
+                                                &op->mask, rp))
+            return KADM5_AUTH_ADD;
+        return 0;
+    case KADM5_BATCH_MODIFY:
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                   ACL_MODIFY, op->rec.principal, &rp)
+            || kadm5int_acl_impose_restrictions(handle->context, &op->rec,
+                                                &op->mask, rp))
+            return KADM5_AUTH_MODIFY;
+        return 0;
+    case KADM5_BATCH_RANDKEY:
+        /* As in chrand_principal3_2_svc, principals may change their own
+         * keys subject to the minimum password life. */
+        if (cmp_gss_krb5_name(handle, rqst2name(rqstp), op->rec.principal))
+            return check_min_life(handle, op->rec.principal, NULL, 0);
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                   ACL_CHANGEPW, op->rec.principal, NULL))
+            return KADM5_AUTH_CHANGEPW;
+        return 0;
+    default:
+        return EINVAL;
+    }
+}
+
+batch_ret *
+batch_principals_2_svc(batch_arg *arg, struct svc_req *rqstp)
+{
+    static batch_ret            ret;
+    kadm5_batch_op_rec          *ops = NULL;
+    kadm5_ret_t                 *codes = NULL;
+    int                         *index = NULL, i, n = 0;
+    char                        *prime_arg;
+    gss_buffer_desc             client_name, service_name;
+    OM_uint32                   minor_stat;
+    kadm5_server_handle_t       handle;
+    const char                  *errmsg = NULL;
+
+    xdr_free(xdr_batch_ret, &ret);
+
+    if ((ret.code = new_server_handle(arg->api_version, rqstp, &handle)))
+        goto exit_func;
+
+    if ((ret.code = check_handle((void *)handle)))
+        goto exit_func;
+
+    ret.api_version = handle->api_version;
+
+    if (setup_gss_names(rqstp, &client_name, &service_name) < 0) {
+        ret.code = KADM5_FAILURE;
+        goto exit_func;
+    }
+
+    /* Check each operation, collecting the permitted ones to be applied
+     * together and remembering their positions in the request. */
+    ret.codes = calloc(arg->n_ops + 1, sizeof(*ret.codes));
+    ops = calloc(arg->n_ops + 1, sizeof(*ops));
+    codes = calloc(arg->n_ops + 1, sizeof(*codes));
+    index = calloc(arg->n_ops + 1, sizeof(*index));
+    if (ret.codes == NULL || ops == NULL || codes == NULL || index == NULL) {
+        ret.code = ENOMEM;
+        goto cleanup;
+    }
+    ret.n_codes = arg->n_ops;
+    for (i = 0; i < arg->n_ops; i++) {
+        /* As in the single-principal stubs, reject a missing principal
+         * before it reaches the ACL check or the database. */
+        if (arg->ops[i].rec.principal == NULL) {
+            ret.codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+        ret.codes[i] = check_batch_op(handle, rqstp, &arg->ops[i]);
+        if (ret.codes[i] == 0) {
+            ops[n] = arg->ops[i];
+            index[n++] = i;
+        } else if (krb5_unparse_name(handle->context,
+                                     arg->ops[i].rec.principal,
+                                     &prime_arg) == 0) {
+            log_unauth(batch_op_name(arg->ops[i].op), prime_arg,
+                       &client_name, &service_name, rqstp);
+            free(prime_arg);
+        }
+    }
+
+    ret.code = kadm5_batch_principals((void *)handle, ops, n, codes);
+    if (ret.code)
+        goto cleanup;
+
+    for (i = 0; i < n; i++) {
+        ret.codes[index[i]] = codes[i];
+        if (krb5_unparse_name(handle->context, ops[i].rec.principal,
+                              &prime_arg))
+            continue;
+        if (codes[i] != 0)
+            errmsg = krb5_get_error_message(handle->context, codes[i]);
+
+        log_done(batch_op_name(ops[i].op), prime_arg, errmsg,
+                 &client_name, &service_name, rqstp);
+
+        if (errmsg != NULL)
+            krb5_free_error_message(handle->context, errmsg);
+        errmsg = NULL;
+        free(prime_arg);
+    }
+
+cleanup:
+    if (ret.code) {
+        /* The codes are only sent (and freed by xdr_free) on success. */
+        free(ret.codes);
+        ret.codes = NULL;
+        ret.n_codes = 0;
+    }
+    free(ops);
+    free(codes);
+    free(index);
+    gss_release_buffer(&minor_stat, &client_name);
+    gss_release_buffer(&minor_stat, &service_name);
+exit_func:
+    free_server_handle(handle);
+    return &ret;
+}
+
 generic_ret *
 create_policy_2_svc(cpol_arg *arg, struct svc_req *rqstp)
 {
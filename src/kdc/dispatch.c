@@ -44,9 +44,9 @@ struct dispatch_state {
 };
 
 static void
-finish_dispatch(struct dispatch_state *state, krb5_error_code code,
-                krb5_data *response)
+finish_dispatch(void *arg, krb5_error_code code, krb5_data *response)
 {
+    struct dispatch_state *state = arg;
     loop_respond_fn oldrespond = state->respond;
     void *oldarg = state->arg;
 
@@ -90,7 +90,6 @@ dispatch(void *cb, struct sockaddr *local_saddr,
          verto_ctx *vctx, loop_respond_fn respond, void *arg)
 {
     krb5_error_code retval;
-    krb5_kdc_req *as_req;
     krb5_int32 now, now_usec;
     krb5_data *response = NULL;
     struct dispatch_state *state;
@@ -159,22 +158,11 @@ dispatch(void *cb, struct sockaddr *local_saddr,
     /* try TGS_REQ first; they are more common! */
 
     if (krb5_is_tgs_req(pkt)) {
-        retval = process_tgs_req(pkt, from, &response);
+        process_tgs_req(pkt, from, vctx, finish_dispatch, state);
+        return;
     } else if (krb5_is_as_req(pkt)) {
-        if (!(retval = decode_krb5_as_req(pkt, &as_req))) {
-            /*
-             * setup_server_realm() sets up the global realm-specific data
-             * pointer.
-             * process_as_req frees the request if it is called
-             */
-            if (!(retval = setup_server_realm(as_req->server))) {
-                process_as_req(as_req, pkt, from, vctx, finish_dispatch_cache,
-                               state);
-                return;
-            }
-            else
-                krb5_free_kdc_req(kdc_context, as_req);
-        }
+        process_as_req(pkt, from, vctx, finish_dispatch_cache, state);
+        return;
     } else
         retval = KRB5KRB_AP_ERR_MSG_TYPE;
 
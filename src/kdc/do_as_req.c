@@ -117,27 +117,27 @@ struct as_req_state {
     char *sname, *cname;
     void *pa_context;
     const krb5_fulladdr *from;
+    struct kdc_timer timer;
+    krb5_key_data *server_key;
+    kdc_realm_t *realm;         /* Realm to restore when resuming */
 
     krb5_error_code preauth_err;
 };
 
+static void
+finish_as_req_authdata(void *arg, krb5_error_code errcode);
+static void
+as_req_egress(struct as_req_state *state, krb5_error_code errcode,
+              krb5_data *response, int did_log);
+
 static void
 finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
 {
-    krb5_key_data *server_key;
     krb5_key_data *client_key;
-    krb5_keyblock *as_encrypting_key = NULL;
-    krb5_data *response = NULL;
-    const char *emsg = 0;
-    int did_log = 0;
     register int i;
     krb5_enctype useenctype;
-    loop_respond_fn oldrespond;
-    void *oldarg;
 
     assert(state);
-    oldrespond = state->respond;
-    oldarg = state->arg;
 
     if (errcode)
         goto egress;
@@ -158,7 +158,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
                                          -1, /* ignore keytype   */
                                          -1, /* Ignore salttype  */
                                          0,  /* Get highest kvno */
-                                         &server_key))) {
+                                         &state->server_key))) {
         state->status = "FINDING_SERVER_KEY";
         goto egress;
     }
@@ -170,7 +170,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
      *  server_keyblock is later used to generate auth data signatures
      */
     if ((errcode = krb5_dbe_decrypt_key_data(kdc_context, NULL,
-                                             server_key,
+                                             state->server_key,
                                              &state->server_keyblock,
                                              NULL))) {
         state->status = "DECRYPT_SERVER_KEY";
@@ -245,19 +245,40 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         goto egress;
     }
 
-    errcode = handle_authdata(kdc_context,
-                              state->c_flags,
-                              state->client,
-                              state->server,
-                              state->server,
-                              &state->client_keyblock,
-                              &state->server_keyblock,
-                              &state->server_keyblock,
-                              state->req_pkt,
-                              state->request,
-                              NULL, /* for_user_princ */
-                              NULL, /* enc_tkt_request */
-                              &state->enc_tkt_reply);
+    /* Authorization data may come from a backend which has to wait on an
+     * external lookup, so continue in finish_as_req_authdata. */
+    handle_authdata(kdc_context,
+                    state->rock.vctx,
+                    state->c_flags,
+                    state->client,
+                    state->server,
+                    state->server,
+                    &state->client_keyblock,
+                    &state->server_keyblock,
+                    &state->server_keyblock,
+                    state->req_pkt,
+                    state->request,
+                    NULL, /* for_user_princ */
+                    NULL, /* enc_tkt_request */
+                    &state->enc_tkt_reply,
+                    finish_as_req_authdata,
+                    state);
+    return;
+
+egress:
+    as_req_egress(state, errcode, NULL, 0);
+}
+
+static void
+finish_as_req_authdata(void *arg, krb5_error_code errcode)
+{
+    struct as_req_state *state = arg;
+    krb5_keyblock *as_encrypting_key = NULL;
+    krb5_data *response = NULL;
+    int did_log = 0;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    kdc_timer_mark(&state->timer, KDC_PHASE_AUTHDATA);
     if (errcode) {
         krb5_klog_syslog(LOG_INFO, _("AS_REQ : handle_authdata (%d)"),
                          errcode);
@@ -271,7 +292,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         state->status = "ENCRYPTING_TICKET";
         goto egress;
     }
-    state->ticket_reply.enc_part.kvno = server_key->key_data_kvno;
+    state->ticket_reply.enc_part.kvno = state->server_key->key_data_kvno;
     errcode = kdc_fast_response_handle_padata(state->rstate,
                                               state->request,
                                               &state->reply,
@@ -303,7 +324,8 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
                                   &state->reply_encpart, 0,
                                   as_encrypting_key,
                                   &state->reply, &response);
-    state->reply.enc_part.kvno = client_key->key_data_kvno;
+    kdc_timer_mark(&state->timer, KDC_PHASE_REPLY);
+    state->reply.enc_part.kvno = state->rock.client_key->key_data_kvno;
     if (errcode) {
         state->status = "ENCODE_KDC_REP";
         goto egress;
@@ -321,11 +343,25 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
     did_log = 1;
 
 egress:
+    if (as_encrypting_key)
+        krb5_free_keyblock(kdc_context, as_encrypting_key);
+    as_req_egress(state, errcode, response, did_log);
+}
+
+/* Log the outcome of the AS request, produce an error reply if needed, and
+ * free the request state before responding. */
+static void
+as_req_egress(struct as_req_state *state, krb5_error_code errcode,
+              krb5_data *response, int did_log)
+{
+    const char *emsg = 0;
+    loop_respond_fn oldrespond = state->respond;
+    void *oldarg = state->arg;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
     if (errcode != 0)
         assert (state->status != 0);
     free_padata_context(kdc_context, state->pa_context);
-    if (as_encrypting_key)
-        krb5_free_keyblock(kdc_context, as_encrypting_key);
     if (errcode)
         emsg = krb5_get_error_message(kdc_context, errcode);
 
@@ -335,6 +371,7 @@ egress:
                    state->status, errcode, emsg);
         did_log = 1;
     }
+    kdc_stats_record(KDC_STATS_AS_REQ, errcode, &state->timer);
     if (errcode) {
         if (state->status == 0) {
             state->status = emsg;
@@ -397,6 +434,7 @@ finish_missing_required_preauth(void *arg)
 {
     struct as_req_state *state = (struct as_req_state *)arg;
 
+    kdc_active_realm = state->realm; /* Restore the realm. */
     finish_process_as_req(state, state->preauth_err);
 }
 
@@ -406,6 +444,8 @@ finish_preauth(void *arg, krb5_error_code code)
     struct as_req_state *state = arg;
     krb5_error_code real_code = code;
 
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    kdc_timer_mark(&state->timer, KDC_PHASE_AUTH);
     if (code) {
         if (vague_errors)
             code = KRB5KRB_ERR_GENERIC;
@@ -437,9 +477,8 @@ finish_preauth(void *arg, krb5_error_code code)
 
 /*ARGSUSED*/
 void
-process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
-               const krb5_fulladdr *from, verto_ctx *vctx,
-               loop_respond_fn respond, void *arg)
+process_as_req(krb5_data *req_pkt, const krb5_fulladdr *from,
+               verto_ctx *vctx, loop_respond_fn respond, void *arg)
 {
     krb5_error_code errcode;
     krb5_timestamp rtime;
@@ -453,12 +492,24 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         (*respond)(arg, errcode, NULL);
         return;
     }
+    kdc_timer_start(&state->timer);
     state->respond = respond;
     state->arg = arg;
-    state->request = request;
     state->req_pkt = req_pkt;
     state->from = from;
 
+    errcode = decode_krb5_as_req(req_pkt, &state->request);
+    if (errcode)
+        goto early_error;
+    /*
+     * setup_server_realm() sets up the global realm-specific data pointer.
+     */
+    errcode = setup_server_realm(state->request->server);
+    if (errcode)
+        goto early_error;
+    state->realm = kdc_active_realm;
+    kdc_timer_mark(&state->timer, KDC_PHASE_DECODE);
+
     if (state->request->msg_type != KRB5_AS_REQ) {
         state->status = "msg_type mismatch";
         errcode = KRB5_BADMSGTYPE;
@@ -590,6 +641,7 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         state->status = "LOOKING_UP_SERVER";
         goto errout;
     }
+    kdc_timer_mark(&state->timer, KDC_PHASE_DB);
 
     if ((errcode = krb5_timeofday(kdc_context, &state->kdc_time))) {
         state->status = "TIMEOFDAY";
@@ -755,6 +807,13 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
 
 errout:
     finish_process_as_req(state, errcode);
+    return;
+
+early_error:
+    kdc_stats_record(KDC_STATS_AS_REQ, errcode, &state->timer);
+    krb5_free_kdc_req(kdc_context, state->request);
+    free(state);
+    (*respond)(arg, errcode, NULL);
 }
 
 static krb5_error_code
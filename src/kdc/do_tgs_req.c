@@ -78,107 +78,135 @@ prepare_error_tgs(struct kdc_request_state *, krb5_kdc_req *,krb5_ticket *,int,
 static krb5_int32
 prep_reprocess_req(krb5_kdc_req *,krb5_principal *);
 
-/*ARGSUSED*/
-krb5_error_code
-process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
-                krb5_data **response)
-{
-    krb5_keyblock * subkey = 0;
-    krb5_keyblock * tgskey = 0;
-    krb5_kdc_req *request = 0;
-    krb5_db_entry *server = NULL;
+/* State for a TGS request which is kept across asynchronous authdata
+ * processing. */
+struct tgs_req_state {
+    loop_respond_fn respond;
+    void *arg;
+    krb5_data *pkt;
+    const krb5_fulladdr *from;
+    krb5_data *response;
+
+    krb5_keyblock *subkey;
+    krb5_keyblock *tgskey;
+    krb5_kdc_req *request;
+    krb5_db_entry *server;
     krb5_kdc_rep reply;
     krb5_enc_kdc_rep_part reply_encpart;
-    krb5_ticket ticket_reply, *header_ticket = 0;
-    int st_idx = 0;
+    krb5_ticket ticket_reply, *header_ticket;
+    int st_idx;
     krb5_enc_tkt_part enc_tkt_reply;
-    krb5_transited enc_tkt_transited;
-    int newtransited = 0;
-    krb5_error_code retval = 0;
+    int newtransited;
     krb5_keyblock encrypting_key;
-    krb5_timestamp kdc_time, authtime = 0;
+    krb5_key server_kobj;
+    krb5_timestamp authtime;
     krb5_keyblock session_key;
+    krb5_keyblock *reply_key;
+    krb5_key_data *server_key;
+    char *cname, *sname, *altcname;
+    const char *status;
+    krb5_enc_tkt_part *header_enc_tkt; /* TGT */
+    krb5_enc_tkt_part *subject_tkt; /* TGT or evidence ticket */
+    krb5_db_entry *client, *krbtgt;
+    krb5_pa_s4u_x509_user *s4u_x509_user; /* protocol transition request */
+    krb5_authdata **kdc_issued_auth_data; /* auth data issued by KDC */
+    unsigned int c_flags, s_flags;        /* client/server KDB flags */
+    char *s4u_name;
+    krb5_boolean is_referral;
+    struct kdc_request_state *rstate;
+    krb5_pa_data **e_data;
+    struct kdc_timer timer;
+    kdc_realm_t *realm;         /* Realm to restore when resuming */
+};
+
+static void
+finish_tgs_req_authdata(void *arg, krb5_error_code errcode);
+
+static void
+finish_process_tgs_req(struct tgs_req_state *state, krb5_error_code errcode);
+
+/*ARGSUSED*/
+void
+process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from, verto_ctx *vctx,
+                loop_respond_fn respond, void *arg)
+{
+    struct tgs_req_state *state;
+    krb5_error_code retval = 0;
+    krb5_keyblock *kb;
+    krb5_timestamp kdc_time;
     krb5_timestamp rtime;
-    krb5_keyblock *reply_key = NULL;
-    krb5_key_data  *server_key;
-    char *cname = 0, *sname = 0, *altcname = 0;
-    krb5_last_req_entry *nolrarray[2], nolrentry;
     krb5_enctype useenctype;
     int errcode, errcode2;
     register int i;
     int firstpass = 1;
-    const char        *status = 0;
-    krb5_enc_tkt_part *header_enc_tkt = NULL; /* TGT */
-    krb5_enc_tkt_part *subject_tkt = NULL; /* TGT or evidence ticket */
-    krb5_db_entry *client = NULL, *krbtgt = NULL;
-    krb5_pa_s4u_x509_user *s4u_x509_user = NULL; /* protocol transition request */
-    krb5_authdata **kdc_issued_auth_data = NULL; /* auth data issued by KDC */
-    unsigned int c_flags = 0, s_flags = 0;       /* client/server KDB flags */
-    char *s4u_name = NULL;
-    krb5_boolean is_referral, db_ref_done = FALSE;
-    const char *emsg = NULL;
+    krb5_boolean db_ref_done = FALSE;
     krb5_data *tgs_1 =NULL, *server_1 = NULL;
     krb5_principal krbtgt_princ;
-    krb5_kvno ticket_kvno = 0;
-    struct kdc_request_state *state = NULL;
     krb5_pa_data *pa_tgs_req; /*points into request*/
     krb5_data scratch;
-    krb5_pa_data **e_data = NULL;
-
-    reply.padata = 0; /* For cleanup handler */
-    reply_encpart.enc_padata = 0;
-    enc_tkt_reply.authorization_data = NULL;
 
-    session_key.contents = NULL;
+    state = k5alloc(sizeof(*state), &retval);
+    if (state == NULL) {
+        (*respond)(arg, retval, NULL);
+        return;
+    }
+    state->respond = respond;
+    state->arg = arg;
+    state->pkt = pkt;
+    state->from = from;
+    kdc_timer_start(&state->timer);
 
-    retval = decode_krb5_tgs_req(pkt, &request);
+    retval = decode_krb5_tgs_req(pkt, &state->request);
     if (retval)
-        return retval;
-    if (request->msg_type != KRB5_TGS_REQ) {
-        krb5_free_kdc_req(kdc_context, request);
-        return KRB5_BADMSGTYPE;
+        goto early_error;
+    if (state->request->msg_type != KRB5_TGS_REQ) {
+        retval = KRB5_BADMSGTYPE;
+        goto early_error;
     }
+    kdc_timer_mark(&state->timer, KDC_PHASE_DECODE);
 
     /*
      * setup_server_realm() sets up the global realm-specific data pointer.
      */
-    if ((retval = setup_server_realm(request->server))) {
-        krb5_free_kdc_req(kdc_context, request);
-        return retval;
-    }
-    errcode = kdc_process_tgs_req(request, from, pkt, &header_ticket,
-                                  &krbtgt, &tgskey, &subkey, &pa_tgs_req);
-    if (header_ticket && header_ticket->enc_part2 &&
+    if ((retval = setup_server_realm(state->request->server)))
+        goto early_error;
+    state->realm = kdc_active_realm;
+    errcode = kdc_process_tgs_req(state->request, from, pkt,
+                                  &state->header_ticket, &state->krbtgt,
+                                  &state->tgskey, &state->subkey, &pa_tgs_req);
+    kdc_timer_mark(&state->timer, KDC_PHASE_AUTH);
+    if (state->header_ticket && state->header_ticket->enc_part2 &&
         (errcode2 = krb5_unparse_name(kdc_context,
-                                      header_ticket->enc_part2->client,
-                                      &cname))) {
-        status = "UNPARSING CLIENT";
+                                      state->header_ticket->enc_part2->client,
+                                      &state->cname))) {
+        state->status = "UNPARSING CLIENT";
         errcode = errcode2;
         goto cleanup;
     }
-    limit_string(cname);
+    limit_string(state->cname);
 
     if (errcode) {
-        status = "PROCESS_TGS";
+        state->status = "PROCESS_TGS";
         goto cleanup;
     }
 
-    if (!header_ticket) {
+    if (!state->header_ticket) {
         errcode = KRB5_NO_TKT_SUPPLIED;        /* XXX? */
-        status="UNEXPECTED NULL in header_ticket";
+        state->status="UNEXPECTED NULL in header_ticket";
         goto cleanup;
     }
-    errcode = kdc_make_rstate(&state);
+    errcode = kdc_make_rstate(&state->rstate);
     if (errcode !=0) {
-        status = "making state";
+        state->status = "making state";
         goto cleanup;
     }
     scratch.length = pa_tgs_req->length;
     scratch.data = (char *) pa_tgs_req->contents;
-    errcode = kdc_find_fast(&request, &scratch, subkey,
-                            header_ticket->enc_part2->session, state, NULL);
+    errcode = kdc_find_fast(&state->request, &scratch, state->subkey,
+                            state->header_ticket->enc_part2->session,
+                            state->rstate, NULL);
     if (errcode !=0) {
-        status = "kdc_find_fast";
+        state->status = "kdc_find_fast";
         goto cleanup;
     }
 
@@ -188,7 +216,7 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
      * if constrained delegation is used. This simplifies the number of
      * special cases for constrained delegation.
      */
-    header_enc_tkt = header_ticket->enc_part2;
+    state->header_enc_tkt = state->header_ticket->enc_part2;
 
     /*
      * We've already dealt with the AP_REQ authentication, so we can
@@ -199,24 +227,25 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
     /* XXX make sure server here has the proper realm...taken from AP_REQ
        header? */
 
-    setflag(s_flags, KRB5_KDB_FLAG_ALIAS_OK);
-    if (isflagset(request->kdc_options, KDC_OPT_CANONICALIZE)) {
-        setflag(c_flags, KRB5_KDB_FLAG_CANONICALIZE);
-        setflag(s_flags, KRB5_KDB_FLAG_CANONICALIZE);
+    setflag(state->s_flags, KRB5_KDB_FLAG_ALIAS_OK);
+    if (isflagset(state->request->kdc_options, KDC_OPT_CANONICALIZE)) {
+        setflag(state->c_flags, KRB5_KDB_FLAG_CANONICALIZE);
+        setflag(state->s_flags, KRB5_KDB_FLAG_CANONICALIZE);
     }
 
     db_ref_done = FALSE;
 ref_tgt_again:
-    if ((errcode = krb5_unparse_name(kdc_context, request->server, &sname))) {
-        status = "UNPARSING SERVER";
+    if ((errcode = krb5_unparse_name(kdc_context, state->request->server,
+                                     &state->sname))) {
+        state->status = "UNPARSING SERVER";
         goto cleanup;
     }
-    limit_string(sname);
+    limit_string(state->sname);
 
-    errcode = krb5_db_get_principal(kdc_context, request->server,
-                                    s_flags, &server);
+    errcode = krb5_db_get_principal(kdc_context, state->request->server,
+                                    state->s_flags, &state->server);
     if (errcode && errcode != KRB5_KDB_NOENTRY) {
-        status = "LOOKING_UP_SERVER";
+        state->status = "LOOKING_UP_SERVER";
         goto cleanup;
     }
 tgt_again:
@@ -227,80 +256,83 @@ tgt_again:
          */
         if (firstpass ) {
 
-            if ( krb5_is_tgs_principal(request->server) == TRUE) {
+            if ( krb5_is_tgs_principal(state->request->server) == TRUE) {
                 /* Principal is a name of krb ticket service */
-                if (krb5_princ_size(kdc_context, request->server) == 2) {
+                if (krb5_princ_size(kdc_context,
+                                    state->request->server) == 2) {
 
                     server_1 = krb5_princ_component(kdc_context,
-                                                    request->server, 1);
+                                                    state->request->server, 1);
                     tgs_1 = krb5_princ_component(kdc_context, tgs_server, 1);
 
                     if (!tgs_1 || !data_eq(*server_1, *tgs_1)) {
-                        errcode = find_alternate_tgs(request, &server);
+                        errcode = find_alternate_tgs(state->request,
+                                                     &state->server);
                         firstpass = 0;
                         if (errcode == 0)
                             goto tgt_again;
                     }
                 }
-                status = "UNKNOWN_SERVER";
+                state->status = "UNKNOWN_SERVER";
                 errcode = KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN;
                 goto cleanup;
 
             } else if ( db_ref_done == FALSE) {
-                retval = prep_reprocess_req(request, &krbtgt_princ);
+                retval = prep_reprocess_req(state->request, &krbtgt_princ);
                 if (!retval) {
-                    krb5_free_principal(kdc_context, request->server);
+                    krb5_free_principal(kdc_context, state->request->server);
                     retval = krb5_copy_principal(kdc_context, krbtgt_princ,
-                                                 &(request->server));
+                                                 &(state->request->server));
                     if (!retval) {
                         db_ref_done = TRUE;
-                        if (sname != NULL)
-                            free(sname);
+                        if (state->sname != NULL)
+                            free(state->sname);
                         goto ref_tgt_again;
                     }
                 }
             }
         }
 
-        status = "UNKNOWN_SERVER";
+        state->status = "UNKNOWN_SERVER";
         errcode = KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN;
         goto cleanup;
     }
 
     if ((errcode = krb5_timeofday(kdc_context, &kdc_time))) {
-        status = "TIME_OF_DAY";
+        state->status = "TIME_OF_DAY";
         goto cleanup;
     }
 
-    if ((retval = validate_tgs_request(request, *server, header_ticket,
-                                       kdc_time, &status, &e_data))) {
-        if (!status)
-            status = "UNKNOWN_REASON";
+    if ((retval = validate_tgs_request(state->request, *state->server,
+                                       state->header_ticket, kdc_time,
+                                       &state->status, &state->e_data))) {
+        if (!state->status)
+            state->status = "UNKNOWN_REASON";
         errcode = retval + ERROR_TABLE_BASE_krb5;
         goto cleanup;
     }
 
-    if (!is_local_principal(header_enc_tkt->client))
-        setflag(c_flags, KRB5_KDB_FLAG_CROSS_REALM);
+    if (!is_local_principal(state->header_enc_tkt->client))
+        setflag(state->c_flags, KRB5_KDB_FLAG_CROSS_REALM);
 
-    is_referral = krb5_is_tgs_principal(server->princ) &&
-        !krb5_principal_compare(kdc_context, tgs_server, server->princ);
+    state->is_referral = krb5_is_tgs_principal(state->server->princ) &&
+        !krb5_principal_compare(kdc_context, tgs_server, state->server->princ);
 
     /* Check for protocol transition */
     errcode = kdc_process_s4u2self_req(kdc_context,
-                                       request,
-                                       header_enc_tkt->client,
-                                       server,
-                                       subkey,
-                                       header_enc_tkt->session,
+                                       state->request,
+                                       state->header_enc_tkt->client,
+                                       state->server,
+                                       state->subkey,
+                                       state->header_enc_tkt->session,
                                        kdc_time,
-                                       &s4u_x509_user,
-                                       &client,
-                                       &status);
+                                       &state->s4u_x509_user,
+                                       &state->client,
+                                       &state->status);
     if (errcode)
         goto cleanup;
-    if (s4u_x509_user != NULL)
-        setflag(c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION);
+    if (state->s4u_x509_user != NULL)
+        setflag(state->c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION);
 
     /*
      * We pick the session keytype here....
@@ -314,67 +346,67 @@ tgt_again:
      * to anything else.
      */
     useenctype = 0;
-    if (isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY |
+    if (isflagset(state->request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY |
                   KDC_OPT_CNAME_IN_ADDL_TKT)) {
         krb5_keyblock  * st_sealing_key;
         krb5_kvno        st_srv_kvno;
         krb5_enctype     etype;
         krb5_db_entry    *st_client;
+        krb5_ticket      *st;
 
         /*
          * Get the key for the second ticket, and decrypt it.
          */
-        if ((errcode = kdc_get_server_key(request->second_ticket[st_idx],
-                                          c_flags,
+        st = state->request->second_ticket[state->st_idx];
+        if ((errcode = kdc_get_server_key(st,
+                                          state->c_flags,
                                           TRUE, /* match_enctype */
                                           &st_client,
                                           &st_sealing_key,
                                           &st_srv_kvno))) {
-            status = "2ND_TKT_SERVER";
+            state->status = "2ND_TKT_SERVER";
             goto cleanup;
         }
-        errcode = krb5_decrypt_tkt_part(kdc_context, st_sealing_key,
-                                        request->second_ticket[st_idx]);
+        errcode = krb5_decrypt_tkt_part(kdc_context, st_sealing_key, st);
         krb5_free_keyblock(kdc_context, st_sealing_key);
         if (errcode) {
-            status = "2ND_TKT_DECRYPT";
+            state->status = "2ND_TKT_DECRYPT";
             krb5_db_free_principal(kdc_context, st_client);
             goto cleanup;
         }
 
-        etype = request->second_ticket[st_idx]->enc_part2->session->enctype;
+        etype = st->enc_part2->session->enctype;
         if (!krb5_c_valid_enctype(etype)) {
-            status = "BAD_ETYPE_IN_2ND_TKT";
+            state->status = "BAD_ETYPE_IN_2ND_TKT";
             errcode = KRB5KDC_ERR_ETYPE_NOSUPP;
             krb5_db_free_principal(kdc_context, st_client);
             goto cleanup;
         }
 
-        for (i = 0; i < request->nktypes; i++) {
-            if (request->ktype[i] == etype) {
+        for (i = 0; i < state->request->nktypes; i++) {
+            if (state->request->ktype[i] == etype) {
                 useenctype = etype;
                 break;
             }
         }
 
-        if (isflagset(request->kdc_options, KDC_OPT_CNAME_IN_ADDL_TKT)) {
+        if (isflagset(state->request->kdc_options,
+                      KDC_OPT_CNAME_IN_ADDL_TKT)) {
             /* Do constrained delegation protocol and authorization checks */
-            errcode = kdc_process_s4u2proxy_req(kdc_context,
-                                                request,
-                                                request->second_ticket[st_idx]->enc_part2,
-                                                st_client,
-                                                header_ticket->enc_part2->client,
-                                                request->server,
-                                                &status);
+            errcode = kdc_process_s4u2proxy_req(
+                kdc_context, state->request, st->enc_part2, st_client,
+                state->header_ticket->enc_part2->client,
+                state->request->server, &state->status);
             if (errcode)
                 goto cleanup;
 
-            setflag(c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION);
+            setflag(state->c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION);
 
-            assert(krb5_is_tgs_principal(header_ticket->server));
+            assert(krb5_is_tgs_principal(state->header_ticket->server));
 
-            assert(client == NULL); /* assured by kdc_process_s4u2self_req() */
-            client = st_client;
+            /* assured by kdc_process_s4u2self_req() */
+            assert(state->client == NULL);
+            state->client = st_client;
         } else {
             /* "client" is not used for user2user */
             krb5_db_free_principal(kdc_context, st_client);
@@ -385,20 +417,21 @@ tgt_again:
      * Select the keytype for the ticket session key.
      */
     if ((useenctype == 0) &&
-        (useenctype = select_session_keytype(kdc_context, server,
-                                             request->nktypes,
-                                             request->ktype)) == 0) {
+        (useenctype = select_session_keytype(kdc_context, state->server,
+                                             state->request->nktypes,
+                                             state->request->ktype)) == 0) {
         /* unsupported ktype */
-        status = "BAD_ENCRYPTION_TYPE";
+        state->status = "BAD_ENCRYPTION_TYPE";
         errcode = KRB5KDC_ERR_ETYPE_NOSUPP;
         goto cleanup;
     }
 
-    errcode = krb5_c_make_random_key(kdc_context, useenctype, &session_key);
+    errcode = krb5_c_make_random_key(kdc_context, useenctype,
+                                     &state->session_key);
 
     if (errcode) {
         /* random key failed */
-        status = "RANDOM_KEY_FAILED";
+        state->status = "RANDOM_KEY_FAILED";
         goto cleanup;
     }
 
@@ -409,37 +442,39 @@ tgt_again:
      * the others could be forged by a malicious server.
      */
 
-    if (isflagset(c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION))
-        subject_tkt = request->second_ticket[st_idx]->enc_part2;
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION))
+        state->subject_tkt =
+            state->request->second_ticket[state->st_idx]->enc_part2;
     else
-        subject_tkt = header_enc_tkt;
-    authtime = subject_tkt->times.authtime;
+        state->subject_tkt = state->header_enc_tkt;
+    state->authtime = state->subject_tkt->times.authtime;
 
-    if (is_referral)
-        ticket_reply.server = server->princ;
+    if (state->is_referral)
+        state->ticket_reply.server = state->server->princ;
     else
-        ticket_reply.server = request->server; /* XXX careful for realm... */
+        /* XXX careful for realm... */
+        state->ticket_reply.server = state->request->server;
 
-    enc_tkt_reply.flags = 0;
-    enc_tkt_reply.times.starttime = 0;
+    state->enc_tkt_reply.flags = 0;
+    state->enc_tkt_reply.times.starttime = 0;
 
-    if (isflagset(server->attributes, KRB5_KDB_OK_AS_DELEGATE))
-        setflag(enc_tkt_reply.flags, TKT_FLG_OK_AS_DELEGATE);
+    if (isflagset(state->server->attributes, KRB5_KDB_OK_AS_DELEGATE))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_OK_AS_DELEGATE);
 
     /*
      * Fix header_ticket's starttime; if it's zero, fill in the
      * authtime's value.
      */
-    if (!(header_enc_tkt->times.starttime))
-        header_enc_tkt->times.starttime = authtime;
-    setflag(enc_tkt_reply.flags, TKT_FLG_ENC_PA_REP);
+    if (!(state->header_enc_tkt->times.starttime))
+        state->header_enc_tkt->times.starttime = state->authtime;
+    setflag(state->enc_tkt_reply.flags, TKT_FLG_ENC_PA_REP);
 
     /* don't use new addresses unless forwarded, see below */
 
-    enc_tkt_reply.caddrs = header_enc_tkt->caddrs;
+    state->enc_tkt_reply.caddrs = state->header_enc_tkt->caddrs;
     /* noaddrarray[0] = 0; */
-    reply_encpart.caddrs = 0;/* optional...don't put it in */
-    reply_encpart.enc_padata = NULL;
+    state->reply_encpart.caddrs = 0;/* optional...don't put it in */
+    state->reply_encpart.enc_padata = NULL;
 
     /*
      * It should be noted that local policy may affect the
@@ -447,10 +482,10 @@ tgt_again:
      * realms may refuse to issue renewable tickets
      */
 
-    if (isflagset(request->kdc_options, KDC_OPT_FORWARDABLE)) {
-        setflag(enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
+    if (isflagset(state->request->kdc_options, KDC_OPT_FORWARDABLE)) {
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
 
-        if (isflagset(c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION)) {
+        if (isflagset(state->c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION)) {
             /*
              * If S4U2Self principal is not forwardable, then mark ticket as
              * unforwardable. This behaviour matches Windows, but it is
@@ -460,163 +495,175 @@ tgt_again:
              * Consider this block the S4U2Self equivalent to
              * validate_forwardable().
              */
-            if (client != NULL &&
-                isflagset(client->attributes, KRB5_KDB_DISALLOW_FORWARDABLE))
-                clear(enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
+            if (state->client != NULL &&
+                isflagset(state->client->attributes,
+                          KRB5_KDB_DISALLOW_FORWARDABLE))
+                clear(state->enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
             /*
              * Forwardable flag is propagated along referral path.
              */
-            else if (!isflagset(header_enc_tkt->flags, TKT_FLG_FORWARDABLE))
-                clear(enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
+            else if (!isflagset(state->header_enc_tkt->flags,
+                                TKT_FLG_FORWARDABLE))
+                clear(state->enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
             /*
              * OK_TO_AUTH_AS_DELEGATE must be set on the service requesting
              * S4U2Self in order for forwardable tickets to be returned.
              */
-            else if (!is_referral &&
-                     !isflagset(server->attributes,
+            else if (!state->is_referral &&
+                     !isflagset(state->server->attributes,
                                 KRB5_KDB_OK_TO_AUTH_AS_DELEGATE))
-                clear(enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
+                clear(state->enc_tkt_reply.flags, TKT_FLG_FORWARDABLE);
         }
     }
 
-    if (isflagset(request->kdc_options, KDC_OPT_FORWARDED)) {
-        setflag(enc_tkt_reply.flags, TKT_FLG_FORWARDED);
+    if (isflagset(state->request->kdc_options, KDC_OPT_FORWARDED)) {
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_FORWARDED);
 
         /* include new addresses in ticket & reply */
 
-        enc_tkt_reply.caddrs = request->addresses;
-        reply_encpart.caddrs = request->addresses;
+        state->enc_tkt_reply.caddrs = state->request->addresses;
+        state->reply_encpart.caddrs = state->request->addresses;
     }
-    if (isflagset(header_enc_tkt->flags, TKT_FLG_FORWARDED))
-        setflag(enc_tkt_reply.flags, TKT_FLG_FORWARDED);
+    if (isflagset(state->header_enc_tkt->flags, TKT_FLG_FORWARDED))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_FORWARDED);
 
-    if (isflagset(request->kdc_options, KDC_OPT_PROXIABLE))
-        setflag(enc_tkt_reply.flags, TKT_FLG_PROXIABLE);
+    if (isflagset(state->request->kdc_options, KDC_OPT_PROXIABLE))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_PROXIABLE);
 
-    if (isflagset(request->kdc_options, KDC_OPT_PROXY)) {
-        setflag(enc_tkt_reply.flags, TKT_FLG_PROXY);
+    if (isflagset(state->request->kdc_options, KDC_OPT_PROXY)) {
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_PROXY);
 
         /* include new addresses in ticket & reply */
 
-        enc_tkt_reply.caddrs = request->addresses;
-        reply_encpart.caddrs = request->addresses;
+        state->enc_tkt_reply.caddrs = state->request->addresses;
+        state->reply_encpart.caddrs = state->request->addresses;
     }
 
-    if (isflagset(request->kdc_options, KDC_OPT_ALLOW_POSTDATE))
-        setflag(enc_tkt_reply.flags, TKT_FLG_MAY_POSTDATE);
+    if (isflagset(state->request->kdc_options, KDC_OPT_ALLOW_POSTDATE))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_MAY_POSTDATE);
 
-    if (isflagset(request->kdc_options, KDC_OPT_POSTDATED)) {
-        setflag(enc_tkt_reply.flags, TKT_FLG_POSTDATED);
-        setflag(enc_tkt_reply.flags, TKT_FLG_INVALID);
-        enc_tkt_reply.times.starttime = request->from;
+    if (isflagset(state->request->kdc_options, KDC_OPT_POSTDATED)) {
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_POSTDATED);
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_INVALID);
+        state->enc_tkt_reply.times.starttime = state->request->from;
     } else
-        enc_tkt_reply.times.starttime = kdc_time;
+        state->enc_tkt_reply.times.starttime = kdc_time;
 
-    if (isflagset(request->kdc_options, KDC_OPT_VALIDATE)) {
-        assert(isflagset(c_flags, KRB5_KDB_FLAGS_S4U) == 0);
+    if (isflagset(state->request->kdc_options, KDC_OPT_VALIDATE)) {
+        assert(isflagset(state->c_flags, KRB5_KDB_FLAGS_S4U) == 0);
         /* BEWARE of allocation hanging off of ticket & enc_part2, it belongs
            to the caller */
-        ticket_reply = *(header_ticket);
-        enc_tkt_reply = *(header_ticket->enc_part2);
-        enc_tkt_reply.authorization_data = NULL;
-        clear(enc_tkt_reply.flags, TKT_FLG_INVALID);
+        state->ticket_reply = *(state->header_ticket);
+        state->enc_tkt_reply = *(state->header_ticket->enc_part2);
+        state->enc_tkt_reply.authorization_data = NULL;
+        clear(state->enc_tkt_reply.flags, TKT_FLG_INVALID);
     }
 
-    if (isflagset(request->kdc_options, KDC_OPT_RENEW)) {
+    if (isflagset(state->request->kdc_options, KDC_OPT_RENEW)) {
         krb5_deltat old_life;
 
-        assert(isflagset(c_flags, KRB5_KDB_FLAGS_S4U) == 0);
+        assert(isflagset(state->c_flags, KRB5_KDB_FLAGS_S4U) == 0);
         /* BEWARE of allocation hanging off of ticket & enc_part2, it belongs
            to the caller */
-        ticket_reply = *(header_ticket);
-        enc_tkt_reply = *(header_ticket->enc_part2);
-        enc_tkt_reply.authorization_data = NULL;
+        state->ticket_reply = *(state->header_ticket);
+        state->enc_tkt_reply = *(state->header_ticket->enc_part2);
+        state->enc_tkt_reply.authorization_data = NULL;
 
-        old_life = enc_tkt_reply.times.endtime - enc_tkt_reply.times.starttime;
+        old_life = state->enc_tkt_reply.times.endtime -
+            state->enc_tkt_reply.times.starttime;
 
-        enc_tkt_reply.times.starttime = kdc_time;
-        enc_tkt_reply.times.endtime =
-            min(header_ticket->enc_part2->times.renew_till,
+        state->enc_tkt_reply.times.starttime = kdc_time;
+        state->enc_tkt_reply.times.endtime =
+            min(state->header_ticket->enc_part2->times.renew_till,
                 kdc_time + old_life);
     } else {
         /* not a renew request */
-        enc_tkt_reply.times.starttime = kdc_time;
-
-        kdc_get_ticket_endtime(kdc_context, enc_tkt_reply.times.starttime,
-                               header_enc_tkt->times.endtime, request->till,
-                               client, server, &enc_tkt_reply.times.endtime);
-
-        if (isflagset(request->kdc_options, KDC_OPT_RENEWABLE_OK) &&
-            (enc_tkt_reply.times.endtime < request->till) &&
-            isflagset(header_enc_tkt->flags, TKT_FLG_RENEWABLE)) {
-            setflag(request->kdc_options, KDC_OPT_RENEWABLE);
-            request->rtime =
-                min(request->till, header_enc_tkt->times.renew_till);
+        state->enc_tkt_reply.times.starttime = kdc_time;
+
+        kdc_get_ticket_endtime(kdc_context,
+                               state->enc_tkt_reply.times.starttime,
+                               state->header_enc_tkt->times.endtime,
+                               state->request->till, state->client,
+                               state->server,
+                               &state->enc_tkt_reply.times.endtime);
+
+        if (isflagset(state->request->kdc_options, KDC_OPT_RENEWABLE_OK) &&
+            (state->enc_tkt_reply.times.endtime < state->request->till) &&
+            isflagset(state->header_enc_tkt->flags, TKT_FLG_RENEWABLE)) {
+            setflag(state->request->kdc_options, KDC_OPT_RENEWABLE);
+            state->request->rtime =
+                min(state->request->till,
+                    state->header_enc_tkt->times.renew_till);
         }
     }
-    rtime = (request->rtime == 0) ? kdc_infinity : request->rtime;
+    rtime = (state->request->rtime == 0) ? kdc_infinity :
+        state->request->rtime;
 
-    if (isflagset(request->kdc_options, KDC_OPT_RENEWABLE)) {
+    if (isflagset(state->request->kdc_options, KDC_OPT_RENEWABLE)) {
         /* already checked above in policy check to reject request for a
            renewable ticket using a non-renewable ticket */
-        setflag(enc_tkt_reply.flags, TKT_FLG_RENEWABLE);
-        enc_tkt_reply.times.renew_till =
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_RENEWABLE);
+        state->enc_tkt_reply.times.renew_till =
             min(rtime,
-                min(header_enc_tkt->times.renew_till,
-                    enc_tkt_reply.times.starttime +
-                    min(server->max_renewable_life,
+                min(state->header_enc_tkt->times.renew_till,
+                    state->enc_tkt_reply.times.starttime +
+                    min(state->server->max_renewable_life,
                         max_renewable_life_for_realm)));
     } else {
-        enc_tkt_reply.times.renew_till = 0;
+        state->enc_tkt_reply.times.renew_till = 0;
     }
-    if (isflagset(header_enc_tkt->flags, TKT_FLG_ANONYMOUS))
-        setflag(enc_tkt_reply.flags, TKT_FLG_ANONYMOUS);
+    if (isflagset(state->header_enc_tkt->flags, TKT_FLG_ANONYMOUS))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_ANONYMOUS);
     /*
      * Set authtime to be the same as header or evidence ticket's
      */
-    enc_tkt_reply.times.authtime = authtime;
+    state->enc_tkt_reply.times.authtime = state->authtime;
 
     /*
      * Propagate the preauthentication flags through to the returned ticket.
      */
-    if (isflagset(header_enc_tkt->flags, TKT_FLG_PRE_AUTH))
-        setflag(enc_tkt_reply.flags, TKT_FLG_PRE_AUTH);
+    if (isflagset(state->header_enc_tkt->flags, TKT_FLG_PRE_AUTH))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_PRE_AUTH);
 
-    if (isflagset(header_enc_tkt->flags, TKT_FLG_HW_AUTH))
-        setflag(enc_tkt_reply.flags, TKT_FLG_HW_AUTH);
+    if (isflagset(state->header_enc_tkt->flags, TKT_FLG_HW_AUTH))
+        setflag(state->enc_tkt_reply.flags, TKT_FLG_HW_AUTH);
 
     /* starttime is optional, and treated as authtime if not present.
        so we can nuke it if it matches */
-    if (enc_tkt_reply.times.starttime == enc_tkt_reply.times.authtime)
-        enc_tkt_reply.times.starttime = 0;
-
-    if (isflagset(c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION)) {
-        errcode = krb5_unparse_name(kdc_context, s4u_x509_user->user_id.user,
-                                    &s4u_name);
-    } else if (isflagset(c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION)) {
-        errcode = krb5_unparse_name(kdc_context, subject_tkt->client,
-                                    &s4u_name);
+    if (state->enc_tkt_reply.times.starttime ==
+        state->enc_tkt_reply.times.authtime)
+        state->enc_tkt_reply.times.starttime = 0;
+
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION)) {
+        errcode = krb5_unparse_name(kdc_context,
+                                    state->s4u_x509_user->user_id.user,
+                                    &state->s4u_name);
+    } else if (isflagset(state->c_flags,
+                         KRB5_KDB_FLAG_CONSTRAINED_DELEGATION)) {
+        errcode = krb5_unparse_name(kdc_context, state->subject_tkt->client,
+                                    &state->s4u_name);
     } else {
         errcode = 0;
     }
     if (errcode) {
-        status = "UNPARSING S4U CLIENT";
+        state->status = "UNPARSING S4U CLIENT";
         goto cleanup;
     }
 
-    if (isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY)) {
-        krb5_enc_tkt_part *t2enc = request->second_ticket[st_idx]->enc_part2;
-        encrypting_key = *(t2enc->session);
+    if (isflagset(state->request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY)) {
+        krb5_enc_tkt_part *t2enc =
+            state->request->second_ticket[state->st_idx]->enc_part2;
+        state->encrypting_key = *(t2enc->session);
     } else {
         /*
          * Find the server key
          */
-        if ((errcode = krb5_dbe_find_enctype(kdc_context, server,
+        if ((errcode = krb5_dbe_find_enctype(kdc_context, state->server,
                                              -1, /* ignore keytype */
                                              -1, /* Ignore salttype */
                                              0,  /* Get highest kvno */
-                                             &server_key))) {
-            status = "FINDING_SERVER_KEY";
+                                             &state->server_key))) {
+            state->status = "FINDING_SERVER_KEY";
             goto cleanup;
         }
 
@@ -624,23 +671,30 @@ tgt_again:
          * Convert server.key into a real key
          * (it may be encrypted in the database)
          */
-        if ((errcode = krb5_dbe_decrypt_key_data(kdc_context, NULL,
-                                                 server_key, &encrypting_key,
-                                                 NULL))) {
-            status = "DECRYPT_SERVER_KEY";
+        if ((errcode = kdc_decrypt_key_data(state->server_key,
+                                            &state->server_kobj))) {
+            state->status = "DECRYPT_SERVER_KEY";
             goto cleanup;
         }
+        if ((errcode = krb5_k_key_keyblock(kdc_context, state->server_kobj,
+                                           &kb))) {
+            state->status = "DECRYPT_SERVER_KEY";
+            goto cleanup;
+        }
+        state->encrypting_key = *kb;
+        free(kb);
     }
 
-    if (isflagset(c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION)) {
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_CONSTRAINED_DELEGATION)) {
         /*
          * Don't allow authorization data to be disabled if constrained
          * delegation is requested. We don't want to deny the server
          * the ability to validate that delegation was used.
          */
-        clear(server->attributes, KRB5_KDB_NO_AUTH_DATA_REQUIRED);
+        clear(state->server->attributes, KRB5_KDB_NO_AUTH_DATA_REQUIRED);
     }
-    if (isflagset(server->attributes, KRB5_KDB_NO_AUTH_DATA_REQUIRED) == 0) {
+    if (isflagset(state->server->attributes,
+                  KRB5_KDB_NO_AUTH_DATA_REQUIRED) == 0) {
         /*
          * If we are not doing protocol transition/constrained delegation
          * try to lookup the client principal so plugins can add additional
@@ -649,44 +703,76 @@ tgt_again:
          * Always validate authorization data for constrained delegation
          * because we must validate the KDC signatures.
          */
-        if (!isflagset(c_flags, KRB5_KDB_FLAGS_S4U)) {
+        if (!isflagset(state->c_flags, KRB5_KDB_FLAGS_S4U)) {
             /* Generate authorization data so we can include it in ticket */
-            setflag(c_flags, KRB5_KDB_FLAG_INCLUDE_PAC);
+            setflag(state->c_flags, KRB5_KDB_FLAG_INCLUDE_PAC);
             /* Map principals from foreign (possibly non-AD) realms */
-            setflag(c_flags, KRB5_KDB_FLAG_MAP_PRINCIPALS);
+            setflag(state->c_flags, KRB5_KDB_FLAG_MAP_PRINCIPALS);
 
-            assert(client == NULL); /* should not have been set already */
+            /* should not have been set already */
+            assert(state->client == NULL);
 
-            errcode = krb5_db_get_principal(kdc_context, subject_tkt->client,
-                                            c_flags, &client);
+            errcode = krb5_db_get_principal(kdc_context,
+                                            state->subject_tkt->client,
+                                            state->c_flags, &state->client);
         }
     }
 
-    if (isflagset(c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION) &&
-        !isflagset(c_flags, KRB5_KDB_FLAG_CROSS_REALM))
-        enc_tkt_reply.client = s4u_x509_user->user_id.user;
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION) &&
+        !isflagset(state->c_flags, KRB5_KDB_FLAG_CROSS_REALM))
+        state->enc_tkt_reply.client = state->s4u_x509_user->user_id.user;
     else
-        enc_tkt_reply.client = subject_tkt->client;
-
-    enc_tkt_reply.session = &session_key;
-    enc_tkt_reply.transited.tr_type = KRB5_DOMAIN_X500_COMPRESS;
-    enc_tkt_reply.transited.tr_contents = empty_string; /* equivalent of "" */
-
-    errcode = handle_authdata(kdc_context, c_flags, client, server, krbtgt,
-                              subkey != NULL ? subkey :
-                              header_ticket->enc_part2->session,
-                              &encrypting_key, /* U2U or server key */
-                              tgskey,
-                              pkt,
-                              request,
-                              s4u_x509_user ?
-                              s4u_x509_user->user_id.user : NULL,
-                              subject_tkt,
-                              &enc_tkt_reply);
+        state->enc_tkt_reply.client = state->subject_tkt->client;
+
+    state->enc_tkt_reply.session = &state->session_key;
+    state->enc_tkt_reply.transited.tr_type = KRB5_DOMAIN_X500_COMPRESS;
+    /* equivalent of "" */
+    state->enc_tkt_reply.transited.tr_contents = empty_string;
+
+    kdc_timer_mark(&state->timer, KDC_PHASE_DB);
+    handle_authdata(kdc_context, vctx, state->c_flags, state->client,
+                    state->server, state->krbtgt,
+                    state->subkey != NULL ? state->subkey :
+                    state->header_ticket->enc_part2->session,
+                    &state->encrypting_key, /* U2U or server key */
+                    state->tgskey,
+                    pkt,
+                    state->request,
+                    state->s4u_x509_user ?
+                    state->s4u_x509_user->user_id.user : NULL,
+                    state->subject_tkt,
+                    &state->enc_tkt_reply,
+                    finish_tgs_req_authdata, state);
+    return;
+
+cleanup:
+    finish_process_tgs_req(state, errcode);
+    return;
+
+early_error:
+    kdc_stats_record(KDC_STATS_TGS_REQ, retval, &state->timer);
+    krb5_free_kdc_req(kdc_context, state->request);
+    free(state);
+    (*respond)(arg, retval, NULL);
+}
+
+/* Finish a TGS request once the authorization data has been computed. */
+static void
+finish_tgs_req_authdata(void *arg, krb5_error_code errcode)
+{
+    struct tgs_req_state *state = arg;
+    krb5_transited enc_tkt_transited;
+    const char *emsg = NULL;
+    krb5_kvno ticket_kvno = 0;
+    krb5_last_req_entry *nolrarray[2], nolrentry;
+    krb5_keyblock *tgt_session = state->header_ticket->enc_part2->session;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    kdc_timer_mark(&state->timer, KDC_PHASE_AUTHDATA);
     if (errcode) {
         krb5_klog_syslog(LOG_INFO, _("TGS_REQ : handle_authdata (%d)"),
                          errcode);
-        status = "HANDLE_AUTHDATA";
+        state->status = "HANDLE_AUTHDATA";
         goto cleanup;
     }
 
@@ -699,16 +785,17 @@ tgt_again:
      * listed).
      */
     /* realm compare is like strcmp, but knows how to deal with these args */
-    if (realm_compare(header_ticket->server, tgs_server) ||
-        realm_compare(header_ticket->server, enc_tkt_reply.client)) {
+    if (realm_compare(state->header_ticket->server, tgs_server) ||
+        realm_compare(state->header_ticket->server,
+                      state->enc_tkt_reply.client)) {
         /* tgt issued by local realm or issued by realm of client */
-        enc_tkt_reply.transited = header_enc_tkt->transited;
+        state->enc_tkt_reply.transited = state->header_enc_tkt->transited;
     } else {
         /* tgt issued by some other realm and not the realm of the client */
         /* assemble new transited field into allocated storage */
-        if (header_enc_tkt->transited.tr_type !=
+        if (state->header_enc_tkt->transited.tr_type !=
             KRB5_DOMAIN_X500_COMPRESS) {
-            status = "BAD_TRTYPE";
+            state->status = "BAD_TRTYPE";
             errcode = KRB5KDC_ERR_TRTYPE_NOSUPP;
             goto cleanup;
         }
@@ -717,67 +804,74 @@ tgt_again:
         enc_tkt_transited.tr_contents.magic = 0;
         enc_tkt_transited.tr_contents.data = 0;
         enc_tkt_transited.tr_contents.length = 0;
-        enc_tkt_reply.transited = enc_tkt_transited;
+        state->enc_tkt_reply.transited = enc_tkt_transited;
         if ((errcode =
-             add_to_transited(&header_enc_tkt->transited.tr_contents,
-                              &enc_tkt_reply.transited.tr_contents,
-                              header_ticket->server,
-                              enc_tkt_reply.client,
-                              request->server))) {
-            status = "ADD_TR_FAIL";
+             add_to_transited(&state->header_enc_tkt->transited.tr_contents,
+                              &state->enc_tkt_reply.transited.tr_contents,
+                              state->header_ticket->server,
+                              state->enc_tkt_reply.client,
+                              state->request->server))) {
+            state->status = "ADD_TR_FAIL";
             goto cleanup;
         }
-        newtransited = 1;
+        state->newtransited = 1;
     }
-    if (isflagset(c_flags, KRB5_KDB_FLAG_CROSS_REALM)) {
-        errcode = validate_transit_path(kdc_context, header_enc_tkt->client,
-                                        server, krbtgt);
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_CROSS_REALM)) {
+        errcode = validate_transit_path(kdc_context,
+                                        state->header_enc_tkt->client,
+                                        state->server, state->krbtgt);
         if (errcode) {
-            status = "NON_TRANSITIVE";
+            state->status = "NON_TRANSITIVE";
             goto cleanup;
         }
     }
-    if (!isflagset (request->kdc_options, KDC_OPT_DISABLE_TRANSITED_CHECK)) {
+    if (!isflagset (state->request->kdc_options,
+                    KDC_OPT_DISABLE_TRANSITED_CHECK)) {
         unsigned int tlen;
         char *tdots;
 
-        errcode = kdc_check_transited_list (kdc_context,
-                                            &enc_tkt_reply.transited.tr_contents,
-                                            krb5_princ_realm (kdc_context, header_enc_tkt->client),
-                                            krb5_princ_realm (kdc_context, request->server));
-        tlen = enc_tkt_reply.transited.tr_contents.length;
+        errcode = kdc_check_transited_list(
+            kdc_context, &state->enc_tkt_reply.transited.tr_contents,
+            krb5_princ_realm(kdc_context, state->header_enc_tkt->client),
+            krb5_princ_realm(kdc_context, state->request->server));
+        tlen = state->enc_tkt_reply.transited.tr_contents.length;
         tdots = tlen > 125 ? "..." : "";
         tlen = tlen > 125 ? 125 : tlen;
 
         if (errcode == 0) {
-            setflag (enc_tkt_reply.flags, TKT_FLG_TRANSIT_POLICY_CHECKED);
+            setflag(state->enc_tkt_reply.flags,
+                    TKT_FLG_TRANSIT_POLICY_CHECKED);
         } else if (errcode == KRB5KRB_AP_ERR_ILL_CR_TKT)
             krb5_klog_syslog(LOG_INFO, _("bad realm transit path from '%s' "
                                          "to '%s' via '%.*s%s'"),
-                             cname ? cname : "<unknown client>",
-                             sname ? sname : "<unknown server>", tlen,
-                             enc_tkt_reply.transited.tr_contents.data, tdots);
+                             state->cname ? state->cname : "<unknown client>",
+                             state->sname ? state->sname : "<unknown server>",
+                             tlen,
+                             state->enc_tkt_reply.transited.tr_contents.data,
+                             tdots);
         else {
             emsg = krb5_get_error_message(kdc_context, errcode);
             krb5_klog_syslog(LOG_ERR, _("unexpected error checking transit "
                                         "from '%s' to '%s' via '%.*s%s': %s"),
-                             cname ? cname : "<unknown client>",
-                             sname ? sname : "<unknown server>", tlen,
-                             enc_tkt_reply.transited.tr_contents.data, tdots,
-                             emsg);
+                             state->cname ? state->cname : "<unknown client>",
+                             state->sname ? state->sname : "<unknown server>",
+                             tlen,
+                             state->enc_tkt_reply.transited.tr_contents.data,
+                             tdots, emsg);
             krb5_free_error_message(kdc_context, emsg);
             emsg = NULL;
         }
     } else
         krb5_klog_syslog(LOG_INFO, _("not checking transit path"));
     if (reject_bad_transit
-        && !isflagset (enc_tkt_reply.flags, TKT_FLG_TRANSIT_POLICY_CHECKED)) {
+        && !isflagset (state->enc_tkt_reply.flags,
+                       TKT_FLG_TRANSIT_POLICY_CHECKED)) {
         errcode = KRB5KDC_ERR_POLICY;
-        status = "BAD_TRANSIT";
+        state->status = "BAD_TRANSIT";
         goto cleanup;
     }
 
-    ticket_reply.enc_part2 = &enc_tkt_reply;
+    state->ticket_reply.enc_part2 = &state->enc_tkt_reply;
 
     /*
      * If we are doing user-to-user authentication, then make sure
@@ -785,133 +879,164 @@ tgt_again:
      * server, and then encrypt the ticket using the session key of
      * the second ticket.
      */
-    if (isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY)) {
+    if (isflagset(state->request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY)) {
         /*
          * Make sure the client for the second ticket matches
          * requested server.
          */
-        krb5_enc_tkt_part *t2enc = request->second_ticket[st_idx]->enc_part2;
+        krb5_enc_tkt_part *t2enc =
+            state->request->second_ticket[state->st_idx]->enc_part2;
         krb5_principal client2 = t2enc->client;
-        if (!krb5_principal_compare(kdc_context, request->server, client2)) {
-            if ((errcode = krb5_unparse_name(kdc_context, client2, &altcname)))
-                altcname = 0;
-            if (altcname != NULL)
-                limit_string(altcname);
+        if (!krb5_principal_compare(kdc_context, state->request->server,
+                                    client2)) {
+            if ((errcode = krb5_unparse_name(kdc_context, client2,
+                                             &state->altcname)))
+                state->altcname = 0;
+            if (state->altcname != NULL)
+                limit_string(state->altcname);
 
             errcode = KRB5KDC_ERR_SERVER_NOMATCH;
-            status = "2ND_TKT_MISMATCH";
+            state->status = "2ND_TKT_MISMATCH";
             goto cleanup;
         }
 
         ticket_kvno = 0;
-        ticket_reply.enc_part.enctype = t2enc->session->enctype;
-        st_idx++;
+        state->ticket_reply.enc_part.enctype = t2enc->session->enctype;
+        state->st_idx++;
     } else {
-        ticket_kvno = server_key->key_data_kvno;
+        ticket_kvno = state->server_key->key_data_kvno;
     }
 
-    errcode = krb5_encrypt_tkt_part(kdc_context, &encrypting_key,
-                                    &ticket_reply);
-    if (!isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY))
-        krb5_free_keyblock_contents(kdc_context, &encrypting_key);
+    if (state->server_kobj != NULL)
+        errcode = kdc_encrypt_tkt_part(state->server_kobj,
+                                       &state->ticket_reply);
+    else
+        errcode = krb5_encrypt_tkt_part(kdc_context, &state->encrypting_key,
+                                        &state->ticket_reply);
+    if (!isflagset(state->request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY))
+        krb5_free_keyblock_contents(kdc_context, &state->encrypting_key);
     if (errcode) {
-        status = "TKT_ENCRYPT";
+        state->status = "TKT_ENCRYPT";
         goto cleanup;
     }
-    ticket_reply.enc_part.kvno = ticket_kvno;
+    state->ticket_reply.enc_part.kvno = ticket_kvno;
     /* Start assembling the response */
-    reply.msg_type = KRB5_TGS_REP;
-    if (isflagset(c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION) &&
-        find_pa_data(request->padata, KRB5_PADATA_S4U_X509_USER) != NULL) {
+    state->reply.msg_type = KRB5_TGS_REP;
+    if (isflagset(state->c_flags, KRB5_KDB_FLAG_PROTOCOL_TRANSITION) &&
+        find_pa_data(state->request->padata,
+                     KRB5_PADATA_S4U_X509_USER) != NULL) {
         errcode = kdc_make_s4u2self_rep(kdc_context,
-                                        subkey,
-                                        header_ticket->enc_part2->session,
-                                        s4u_x509_user,
-                                        &reply,
-                                        &reply_encpart);
+                                        state->subkey, tgt_session,
+                                        state->s4u_x509_user,
+                                        &state->reply,
+                                        &state->reply_encpart);
         if (errcode) {
-            status = "KDC_RETURN_S4U2SELF_PADATA";
+            state->status = "KDC_RETURN_S4U2SELF_PADATA";
             goto cleanup;
         }
     }
 
-    reply.client = enc_tkt_reply.client;
-    reply.enc_part.kvno = 0;/* We are using the session key */
-    reply.ticket = &ticket_reply;
+    state->reply.client = state->enc_tkt_reply.client;
+    state->reply.enc_part.kvno = 0;/* We are using the session key */
+    state->reply.ticket = &state->ticket_reply;
 
-    reply_encpart.session = &session_key;
-    reply_encpart.nonce = request->nonce;
+    state->reply_encpart.session = &state->session_key;
+    state->reply_encpart.nonce = state->request->nonce;
 
     /* copy the time fields */
-    reply_encpart.times = enc_tkt_reply.times;
+    state->reply_encpart.times = state->enc_tkt_reply.times;
 
     /* starttime is optional, and treated as authtime if not present.
        so we can nuke it if it matches */
-    if (enc_tkt_reply.times.starttime == enc_tkt_reply.times.authtime)
-        enc_tkt_reply.times.starttime = 0;
+    if (state->enc_tkt_reply.times.starttime ==
+        state->enc_tkt_reply.times.authtime)
+        state->enc_tkt_reply.times.starttime = 0;
 
     nolrentry.lr_type = KRB5_LRQ_NONE;
     nolrentry.value = 0;
     nolrarray[0] = &nolrentry;
     nolrarray[1] = 0;
-    reply_encpart.last_req = nolrarray;        /* not available for TGS reqs */
-    reply_encpart.key_exp = 0;/* ditto */
-    reply_encpart.flags = enc_tkt_reply.flags;
-    reply_encpart.server = ticket_reply.server;
+    state->reply_encpart.last_req = nolrarray; /* not available for TGS reqs */
+    state->reply_encpart.key_exp = 0;/* ditto */
+    state->reply_encpart.flags = state->enc_tkt_reply.flags;
+    state->reply_encpart.server = state->ticket_reply.server;
 
     /* use the session key in the ticket, unless there's a subsession key
        in the AP_REQ */
-    reply.enc_part.enctype = subkey ? subkey->enctype :
-        header_ticket->enc_part2->session->enctype;
-    errcode  = kdc_fast_response_handle_padata(state, request, &reply,
-                                               subkey ? subkey->enctype : header_ticket->enc_part2->session->enctype);
+    state->reply.enc_part.enctype = state->subkey ? state->subkey->enctype :
+        tgt_session->enctype;
+    errcode  = kdc_fast_response_handle_padata(state->rstate, state->request,
+                                               &state->reply,
+                                               state->reply.enc_part.enctype);
     if (errcode !=0 ) {
-        status = "Preparing FAST padata";
+        state->status = "Preparing FAST padata";
         goto cleanup;
     }
-    errcode =kdc_fast_handle_reply_key(state,
-                                       subkey?subkey:header_ticket->enc_part2->session, &reply_key);
+    errcode =kdc_fast_handle_reply_key(state->rstate,
+                                       state->subkey ? state->subkey :
+                                       tgt_session, &state->reply_key);
     if (errcode) {
-        status  = "generating reply key";
+        state->status  = "generating reply key";
         goto cleanup;
     }
-    errcode = return_enc_padata(kdc_context, pkt, request,
-                                reply_key, server, &reply_encpart,
-                                is_referral &&
-                                isflagset(s_flags,
+    errcode = return_enc_padata(kdc_context, state->pkt, state->request,
+                                state->reply_key, state->server,
+                                &state->reply_encpart,
+                                state->is_referral &&
+                                isflagset(state->s_flags,
                                           KRB5_KDB_FLAG_CANONICALIZE));
     if (errcode) {
-        status = "KDC_RETURN_ENC_PADATA";
+        state->status = "KDC_RETURN_ENC_PADATA";
         goto cleanup;
     }
 
-    errcode = krb5_encode_kdc_rep(kdc_context, KRB5_TGS_REP, &reply_encpart,
-                                  subkey ? 1 : 0,
-                                  reply_key,
-                                  &reply, response);
+    errcode = krb5_encode_kdc_rep(kdc_context, KRB5_TGS_REP,
+                                  &state->reply_encpart,
+                                  state->subkey ? 1 : 0,
+                                  state->reply_key,
+                                  &state->reply, &state->response);
+    kdc_timer_mark(&state->timer, KDC_PHASE_REPLY);
     if (errcode) {
-        status = "ENCODE_KDC_REP";
+        state->status = "ENCODE_KDC_REP";
     } else {
-        status = "ISSUE";
+        state->status = "ISSUE";
     }
 
-    memset(ticket_reply.enc_part.ciphertext.data, 0,
-           ticket_reply.enc_part.ciphertext.length);
-    free(ticket_reply.enc_part.ciphertext.data);
+    memset(state->ticket_reply.enc_part.ciphertext.data, 0,
+           state->ticket_reply.enc_part.ciphertext.length);
+    free(state->ticket_reply.enc_part.ciphertext.data);
     /* these parts are left on as a courtesy from krb5_encode_kdc_rep so we
        can use them in raw form if needed.  But, we don't... */
-    memset(reply.enc_part.ciphertext.data, 0,
-           reply.enc_part.ciphertext.length);
-    free(reply.enc_part.ciphertext.data);
+    memset(state->reply.enc_part.ciphertext.data, 0,
+           state->reply.enc_part.ciphertext.length);
+    free(state->reply.enc_part.ciphertext.data);
 
 cleanup:
-    assert(status != NULL);
-    if (reply_key)
-        krb5_free_keyblock(kdc_context, reply_key);
+    finish_process_tgs_req(state, errcode);
+}
+
+/* Log the outcome of a TGS request, construct an error reply if necessary,
+ * free the request state, and send the response. */
+static void
+finish_process_tgs_req(struct tgs_req_state *state, krb5_error_code errcode)
+{
+    loop_respond_fn respond;
+    void *arg;
+    krb5_data *response;
+    krb5_error_code retval = 0;
+    const char *emsg = NULL;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    assert(state->status != NULL);
+    if (state->reply_key)
+        krb5_free_keyblock(kdc_context, state->reply_key);
+    krb5_k_free_key(kdc_context, state->server_kobj);
     if (errcode)
         emsg = krb5_get_error_message (kdc_context, errcode);
-    log_tgs_req(from, request, &reply, cname, sname, altcname, authtime,
-                c_flags, s4u_name, status, errcode, emsg);
+    log_tgs_req(state->from, state->request, &state->reply, state->cname,
+                state->sname, state->altcname, state->authtime,
+                state->c_flags, state->s4u_name, state->status, errcode, emsg);
+    kdc_stats_record(KDC_STATS_TGS_REQ, errcode, &state->timer);
     if (errcode) {
         krb5_free_error_message (kdc_context, emsg);
         emsg = NULL;
@@ -919,61 +1044,70 @@ cleanup:
 
     if (errcode) {
         int got_err = 0;
-        if (status == 0) {
-            status = krb5_get_error_message (kdc_context, errcode);
+        if (state->status == 0) {
+            state->status = krb5_get_error_message (kdc_context, errcode);
             got_err = 1;
         }
         errcode -= ERROR_TABLE_BASE_krb5;
         if (errcode < 0 || errcode > 128)
             errcode = KRB_ERR_GENERIC;
 
-        retval = prepare_error_tgs(state, request, header_ticket, errcode,
-                                   (server != NULL) ? server->princ : NULL,
-                                   response, status, e_data);
+        retval = prepare_error_tgs(state->rstate, state->request,
+                                   state->header_ticket, errcode,
+                                   (state->server != NULL) ?
+                                   state->server->princ : NULL,
+                                   &state->response, state->status,
+                                   state->e_data);
         if (got_err) {
-            krb5_free_error_message (kdc_context, status);
-            status = 0;
+            krb5_free_error_message (kdc_context, state->status);
+            state->status = 0;
         }
     }
 
-    if (header_ticket != NULL)
-        krb5_free_ticket(kdc_context, header_ticket);
-    if (request != NULL)
-        krb5_free_kdc_req(kdc_context, request);
-    if (state)
-        kdc_free_rstate(state);
-    if (cname != NULL)
-        free(cname);
-    if (sname != NULL)
-        free(sname);
-    krb5_db_free_principal(kdc_context, server);
-    krb5_db_free_principal(kdc_context, krbtgt);
-    krb5_db_free_principal(kdc_context, client);
-    if (session_key.contents != NULL)
-        krb5_free_keyblock_contents(kdc_context, &session_key);
-    if (newtransited)
-        free(enc_tkt_reply.transited.tr_contents.data);
-    if (s4u_x509_user != NULL)
-        krb5_free_pa_s4u_x509_user(kdc_context, s4u_x509_user);
-    if (kdc_issued_auth_data != NULL)
-        krb5_free_authdata(kdc_context, kdc_issued_auth_data);
-    if (s4u_name != NULL)
-        free(s4u_name);
-    if (subkey != NULL)
-        krb5_free_keyblock(kdc_context, subkey);
-    if (tgskey != NULL)
-        krb5_free_keyblock(kdc_context, tgskey);
-    if (reply.padata)
-        krb5_free_pa_data(kdc_context, reply.padata);
-    if (reply_encpart.enc_padata)
-        krb5_free_pa_data(kdc_context, reply_encpart.enc_padata);
-    if (enc_tkt_reply.authorization_data != NULL)
-        krb5_free_authdata(kdc_context, enc_tkt_reply.authorization_data);
-    krb5_free_pa_data(kdc_context, e_data);
-
-    return retval;
+    if (state->header_ticket != NULL)
+        krb5_free_ticket(kdc_context, state->header_ticket);
+    if (state->request != NULL)
+        krb5_free_kdc_req(kdc_context, state->request);
+    if (state->rstate)
+        kdc_free_rstate(state->rstate);
+    if (state->cname != NULL)
+        free(state->cname);
+    if (state->sname != NULL)
+        free(state->sname);
+    krb5_db_free_principal(kdc_context, state->server);
+    krb5_db_free_principal(kdc_context, state->krbtgt);
+    krb5_db_free_principal(kdc_context, state->client);
+    if (state->session_key.contents != NULL)
+        krb5_free_keyblock_contents(kdc_context, &state->session_key);
+    if (state->newtransited)
+        free(state->enc_tkt_reply.transited.tr_contents.data);
+    if (state->s4u_x509_user != NULL)
+        krb5_free_pa_s4u_x509_user(kdc_context, state->s4u_x509_user);
+    if (state->kdc_issued_auth_data != NULL)
+        krb5_free_authdata(kdc_context, state->kdc_issued_auth_data);
+    if (state->s4u_name != NULL)
+        free(state->s4u_name);
+    if (state->subkey != NULL)
+        krb5_free_keyblock(kdc_context, state->subkey);
+    if (state->tgskey != NULL)
+        krb5_free_keyblock(kdc_context, state->tgskey);
+    if (state->reply.padata)
+        krb5_free_pa_data(kdc_context, state->reply.padata);
+    if (state->reply_encpart.enc_padata)
+        krb5_free_pa_data(kdc_context, state->reply_encpart.enc_padata);
+    if (state->enc_tkt_reply.authorization_data != NULL)
+        krb5_free_authdata(kdc_context,
+                           state->enc_tkt_reply.authorization_data);
+    krb5_free_pa_data(kdc_context, state->e_data);
+
+    response = state->response;
+    respond = state->respond;
+    arg = state->arg;
+    free(state);
+    (*respond)(arg, retval, response);
 }
 
+
 static krb5_error_code
 prepare_error_tgs (struct kdc_request_state *state,
                    krb5_kdc_req *request, krb5_ticket *ticket, int error,
@@ -63,6 +63,7 @@ typedef struct __kdc_realm_data {
      */
     char                *realm_ports;   /* Per-realm KDC UDP port */
     char                *realm_tcp_ports; /* Per-realm KDC TCP port */
+    struct kdc_key_cache_ent *realm_key_cache; /* Decrypted server keys */
     /*
      * Per-realm parameters.
      */
@@ -78,6 +79,7 @@ extern int              kdc_numrealms;
 extern kdc_realm_t      *kdc_active_realm;
 
 kdc_realm_t *find_realm_data (char *, krb5_ui_4);
+void kdc_free_key_cache (kdc_realm_t *);
 
 /*
  * Replace previously used global variables with the active (e.g. request's)
@@ -100,6 +102,7 @@ extern krb5_timestamp   kdc_infinity;   /* greater than all other timestamps */
 extern krb5_keyblock    psr_key;        /* key for predicted sam response */
 extern const int        kdc_modifies_kdb;
 extern krb5_int32       max_dgram_reply_size; /* maximum datagram size */
+extern krb5_deltat      authdata_cache_lifetime; /* 0 disables the cache */
 
 extern const int        vague_errors;
 #endif /* __KRB5_KDC_EXTERN__ */
@@ -96,15 +96,34 @@ static krb5_error_code handle_tgt_authdata(
     krb5_enc_tkt_part *enc_tkt_request,
     krb5_enc_tkt_part *enc_tkt_reply);
 
-static krb5_error_code
-handle_kdb_authdata(krb5_context context, unsigned int flags,
+/* Built-in authdata system which reports its result through respond. */
+typedef void (*authdata_proc_async)(
+    krb5_context, verto_ctx *vctx, unsigned int flags,
+    krb5_db_entry *client, krb5_db_entry *server,
+    krb5_db_entry *krbtgt,
+    krb5_keyblock *client_key,
+    krb5_keyblock *server_key,
+    krb5_keyblock *krbtgt_key,
+    krb5_data *req_pkt,
+    krb5_kdc_req *request,
+    krb5_const_principal for_user_princ,
+    krb5_enc_tkt_part *enc_tkt_request,
+    krb5_enc_tkt_part *enc_tkt_reply,
+    kdc_authdata_respond_fn respond, void *arg);
+
+static void
+handle_kdb_authdata(krb5_context context, verto_ctx *vctx, unsigned int flags,
                     krb5_db_entry *client, krb5_db_entry *server,
                     krb5_db_entry *krbtgt, krb5_keyblock *client_key,
                     krb5_keyblock *server_key, krb5_keyblock *krbtgt_key,
                     krb5_data *req_pkt, krb5_kdc_req *request,
                     krb5_const_principal for_user_princ,
                     krb5_enc_tkt_part *enc_tkt_request,
-                    krb5_enc_tkt_part *enc_tkt_reply);
+                    krb5_enc_tkt_part *enc_tkt_reply,
+                    kdc_authdata_respond_fn respond, void *arg);
+
+static void
+free_authdata_cache(krb5_context context);
 
 static krb5_error_code
 handle_signedpath_authdata(krb5_context context, unsigned int flags,
@@ -122,6 +141,7 @@ typedef struct _krb5_authdata_systems {
 #define AUTHDATA_SYSTEM_UNKNOWN -1
 #define AUTHDATA_SYSTEM_V0      0
 #define AUTHDATA_SYSTEM_V2      2
+#define AUTHDATA_SYSTEM_ASYNC   3 /* Built-in, completes through a callback */
     int         type;
 #define AUTHDATA_FLAG_CRITICAL  0x1
 #define AUTHDATA_FLAG_PRE_PLUGIN 0x2
@@ -134,6 +154,7 @@ typedef struct _krb5_authdata_systems {
         authdata_proc_2 v2;
         authdata_proc_0 v0;
     } handle_authdata;
+    authdata_proc_async handle_authdata_async;
 } krb5_authdata_systems;
 
 static krb5_authdata_systems static_authdata_systems[] = {
@@ -161,12 +182,13 @@ static krb5_authdata_systems static_authdata_systems[] = {
     {
         /* Verify and issue KDB issued authdata */
         "kdb",
-        AUTHDATA_SYSTEM_V2,
+        AUTHDATA_SYSTEM_ASYNC,
         AUTHDATA_FLAG_CRITICAL,
         NULL,
         NULL,
         NULL,
-        { handle_kdb_authdata }
+        { NULL },
+        handle_kdb_authdata
     },
     {
         /* Verify and issue signed delegation path */
@@ -384,6 +406,7 @@ unload_authdata_plugins(krb5_context context)
         n_authdata_systems = 0;
         krb5int_close_plugin_dirs(&authdata_plugins);
     }
+    free_authdata_cache(context);
     return 0;
 }
 
@@ -479,7 +502,9 @@ has_mandatory_for_kdc_authdata (krb5_context context,
  * Merge authdata.
  *
  * If copy is FALSE, in_authdata is invalid on successful return.
- * If ignore_kdc_issued is TRUE, KDC-issued authdata is not copied.
+ * If ignore_kdc_issued is TRUE, KDC-issued authdata is not copied.  The
+ * elements to be merged are chosen before anything is copied, so that
+ * KDC-issued elements such as a PAC are never copied only to be discarded.
  */
 static krb5_error_code
 merge_authdata (krb5_context context,
@@ -488,8 +513,9 @@ merge_authdata (krb5_context context,
                 krb5_boolean copy,
                 krb5_boolean ignore_kdc_issued)
 {
-    size_t i, j, nadata = 0;
-    krb5_authdata **authdata = *out_authdata;
+    krb5_error_code code;
+    size_t i, j, k, nadata = 0, nin;
+    krb5_authdata **authdata = *out_authdata, **keep, **merged;
 
     if (in_authdata == NULL || in_authdata[0] == NULL)
         return 0;
@@ -499,48 +525,58 @@ merge_authdata (krb5_context context,
             ;
     }
 
-    for (i = 0; in_authdata[i] != NULL; i++)
+    for (nin = 0; in_authdata[nin] != NULL; nin++)
         ;
 
-    if (authdata == NULL) {
-        authdata = (krb5_authdata **)calloc(i + 1, sizeof(krb5_authdata *));
-    } else {
-        authdata = (krb5_authdata **)realloc(authdata,
-                                             ((nadata + i + 1) * sizeof(krb5_authdata *)));
-    }
-    if (authdata == NULL)
+    keep = (krb5_authdata **)calloc(nin + 1, sizeof(krb5_authdata *));
+    if (keep == NULL)
         return ENOMEM;
+    for (i = 0, j = 0; i < nin; i++) {
+        if (!ignore_kdc_issued ||
+            !is_kdc_issued_authdatum(context, in_authdata[i], 0))
+            keep[j++] = in_authdata[i];
+    }
 
-    if (copy) {
-        krb5_error_code code;
-        krb5_authdata **tmp;
-
-        code = krb5_copy_authdata(context, in_authdata, &tmp);
-        if (code != 0)
+    merged = keep;
+    if (copy && j > 0) {
+        code = krb5_copy_authdata(context, keep, &merged);
+        if (code != 0) {
+            free(keep);
             return code;
-
-        in_authdata = tmp;
+        }
     }
 
-    for (i = 0, j = 0; in_authdata[i] != NULL; i++) {
-        if (ignore_kdc_issued &&
-            is_kdc_issued_authdatum(context, in_authdata[i], 0)) {
-            free(in_authdata[i]->contents);
-            free(in_authdata[i]);
-        } else
-            authdata[nadata + j++] = in_authdata[i];
+    if (j > 0) {
+        authdata = (krb5_authdata **)realloc(authdata,
+                                             ((nadata + j + 1) * sizeof(krb5_authdata *)));
+        if (authdata == NULL) {
+            if (merged != keep)
+                krb5_free_authdata(context, merged);
+            free(keep);
+            return ENOMEM;
+        }
+        for (i = 0; i < j; i++)
+            authdata[nadata + i] = merged[i];
+        authdata[nadata + j] = NULL;
+        *out_authdata = authdata;
     }
 
-    authdata[nadata + j] = NULL;
-
-    free(in_authdata);
-
-    if (authdata[0] == NULL) {
-        free(authdata);
-        authdata = NULL;
+    if (merged != keep)
+        free(merged);
+
+    if (!copy) {
+        /* Free the elements which were not merged, and the array. */
+        for (i = 0, k = 0; i < nin; i++) {
+            if (k < j && in_authdata[i] == keep[k]) {
+                k++;
+            } else {
+                free(in_authdata[i]->contents);
+                free(in_authdata[i]);
+            }
+        }
+        free(in_authdata);
     }
-
-    *out_authdata = authdata;
+    free(keep);
 
     return 0;
 }
@@ -656,9 +692,240 @@ handle_tgt_authdata (krb5_context context,
                           TRUE);    /* ignore_kdc_issued */
 }
 
+/*
+ * Authorization data produced by the KDB module for TGS requests may be
+ * cached for kdc_authdata_cache_lifetime seconds, so that a client asking
+ * for several service tickets within one login session does not make the
+ * module regenerate (and perhaps look up again) the same data each time.
+ * An entry is only reused for the same client, TGT authtime, server, KDB
+ * flags, server and TGS keys, and TGT authorization data.  The module's
+ * output must not depend on the reply session key, which is new for every
+ * ticket; this holds for PAC signatures.  The cache is off by default.
+ */
+#define AUTHDATA_CACHE_SIZE 1024
+
+struct authdata_cache_key {
+    krb5_const_principal client;
+    krb5_const_principal server;
+    krb5_timestamp authtime;
+    unsigned int flags;
+    krb5_keyblock *server_key;
+    krb5_keyblock *krbtgt_key;
+    krb5_authdata **tgt_authdata;
+};
+
+struct authdata_cache_ent {
+    krb5_principal client;      /* NULL if the slot is empty */
+    krb5_principal server;
+    krb5_timestamp authtime;
+    unsigned int flags;
+    krb5_keyblock server_key;
+    krb5_keyblock krbtgt_key;
+    krb5_authdata **tgt_authdata;
+    krb5_authdata **authdata;
+    krb5_timestamp expires;
+};
+
+static struct authdata_cache_ent *authdata_cache;
+
+static unsigned int
+hash_bytes(unsigned int h, const void *ptr, size_t len)
+{
+    const unsigned char *p = ptr;
+
+    while (len-- > 0)
+        h = (h ^ *p++) * 16777619U;
+    return h;
+}
+
+static unsigned int
+hash_principal(unsigned int h, krb5_const_principal princ)
+{
+    krb5_int32 i;
+
+    h = hash_bytes(h, princ->realm.data, princ->realm.length);
+    for (i = 0; i < princ->length; i++)
+        h = hash_bytes(h, princ->data[i].data, princ->data[i].length);
+    return h;
+}
+
+static krb5_boolean
+keyblock_equal(const krb5_keyblock *cached, const krb5_keyblock *key)
+{
+    if (key == NULL)
+        return cached->contents == NULL;
+    return cached->enctype == key->enctype &&
+        cached->length == key->length &&
+        memcmp(cached->contents, key->contents, key->length) == 0;
+}
+
+static krb5_boolean
+authdata_equal(krb5_authdata **ad1, krb5_authdata **ad2)
+{
+    if (ad1 == NULL || ad2 == NULL)
+        return ad1 == ad2;
+    for (; *ad1 != NULL && *ad2 != NULL; ad1++, ad2++) {
+        if ((*ad1)->ad_type != (*ad2)->ad_type ||
+            (*ad1)->length != (*ad2)->length ||
+            memcmp((*ad1)->contents, (*ad2)->contents, (*ad1)->length) != 0)
+            return FALSE;
+    }
+    return *ad1 == NULL && *ad2 == NULL;
+}
+
+static void
+free_authdata_cache_ent(krb5_context context, struct authdata_cache_ent *ent)
+{
+    krb5_free_principal(context, ent->client);
+    krb5_free_principal(context, ent->server);
+    krb5_free_keyblock_contents(context, &ent->server_key);
+    krb5_free_keyblock_contents(context, &ent->krbtgt_key);
+    krb5_free_authdata(context, ent->tgt_authdata);
+    krb5_free_authdata(context, ent->authdata);
+    memset(ent, 0, sizeof(*ent));
+}
+
+/* Return the cache slot for key, allocating the cache if necessary. */
+static struct authdata_cache_ent *
+authdata_cache_slot(const struct authdata_cache_key *key)
+{
+    unsigned int h = 2166136261U;
+
+    if (authdata_cache == NULL) {
+        authdata_cache = calloc(AUTHDATA_CACHE_SIZE,
+                                sizeof(struct authdata_cache_ent));
+        if (authdata_cache == NULL)
+            return NULL;
+    }
+    h = hash_principal(h, key->client);
+    h = hash_principal(h, key->server);
+    h = hash_bytes(h, &key->authtime, sizeof(key->authtime));
+    return &authdata_cache[h % AUTHDATA_CACHE_SIZE];
+}
+
+/* If the cache holds unexpired authdata for key, set *ad_out to a copy of it
+ * and return TRUE. */
+static krb5_boolean
+authdata_cache_get(krb5_context context, const struct authdata_cache_key *key,
+                   krb5_authdata ***ad_out)
+{
+    struct authdata_cache_ent *ent;
+    krb5_timestamp now;
+
+    *ad_out = NULL;
+    ent = authdata_cache_slot(key);
+    if (ent == NULL || ent->client == NULL)
+        return FALSE;
+    if (krb5_timeofday(context, &now) != 0 || now >= ent->expires) {
+        free_authdata_cache_ent(context, ent);
+        return FALSE;
+    }
+    if (ent->authtime != key->authtime || ent->flags != key->flags ||
+        !krb5_principal_compare(context, ent->client, key->client) ||
+        !krb5_principal_compare(context, ent->server, key->server) ||
+        !keyblock_equal(&ent->server_key, key->server_key) ||
+        !keyblock_equal(&ent->krbtgt_key, key->krbtgt_key) ||
+        !authdata_equal(ent->tgt_authdata, key->tgt_authdata))
+        return FALSE;
+    return krb5_copy_authdata(context, ent->authdata, ad_out) == 0;
+}
+
+/* Store a copy of authdata for key, replacing whatever is in its slot.
+ * Failure to cache is not an error. */
+static void
+authdata_cache_put(krb5_context context, const struct authdata_cache_key *key,
+                   krb5_authdata **authdata)
+{
+    struct authdata_cache_ent *ent, new_ent;
+    krb5_error_code ret;
+    krb5_timestamp now;
+
+    ent = authdata_cache_slot(key);
+    if (ent == NULL || krb5_timeofday(context, &now) != 0)
+        return;
+
+    memset(&new_ent, 0, sizeof(new_ent));
+    new_ent.authtime = key->authtime;
+    new_ent.flags = key->flags;
+    new_ent.expires = now + authdata_cache_lifetime;
+    ret = krb5_copy_principal(context, key->client, &new_ent.client);
+    if (!ret)
+        ret = krb5_copy_principal(context, key->server, &new_ent.server);
+    if (!ret && key->server_key != NULL) {
+        ret = krb5_copy_keyblock_contents(context, key->server_key,
+                                          &new_ent.server_key);
+    }
+    if (!ret && key->krbtgt_key != NULL) {
+        ret = krb5_copy_keyblock_contents(context, key->krbtgt_key,
+                                          &new_ent.krbtgt_key);
+    }
+    if (!ret)
+        ret = krb5_copy_authdata(context, key->tgt_authdata,
+                                 &new_ent.tgt_authdata);
+    if (!ret)
+        ret = krb5_copy_authdata(context, authdata, &new_ent.authdata);
+    if (ret) {
+        free_authdata_cache_ent(context, &new_ent);
+        return;
+    }
+    free_authdata_cache_ent(context, ent);
+    *ent = new_ent;
+}
+
+static void
+free_authdata_cache(krb5_context context)
+{
+    int i;
+
+    if (authdata_cache == NULL)
+        return;
+    for (i = 0; i < AUTHDATA_CACHE_SIZE; i++)
+        free_authdata_cache_ent(context, &authdata_cache[i]);
+    free(authdata_cache);
+    authdata_cache = NULL;
+}
+
+struct kdb_authdata_state {
+    krb5_context context;
+    krb5_enc_tkt_part *enc_tkt_reply;
+    krb5_boolean use_cache;
+    struct authdata_cache_key cache_key;
+    kdc_authdata_respond_fn respond;
+    void *arg;
+    kdc_realm_t *realm;
+};
+
+/* Merge the authdata produced by the KDB module into the ticket. */
+static void
+finish_kdb_authdata(void *arg, krb5_error_code code,
+                    krb5_authdata **db_authdata)
+{
+    struct kdb_authdata_state *state = arg;
+    kdc_authdata_respond_fn oldrespond = state->respond;
+    void *oldarg = state->arg;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    if (code == 0) {
+        if (state->use_cache)
+            authdata_cache_put(state->context, &state->cache_key, db_authdata);
+        code = merge_authdata(state->context,
+                              db_authdata,
+                              &state->enc_tkt_reply->authorization_data,
+                              FALSE,        /* !copy */
+                              FALSE);        /* !ignore_kdc_issued */
+        if (code != 0)
+            krb5_free_authdata(state->context, db_authdata);
+    } else if (code == KRB5_PLUGIN_OP_NOTSUPP)
+        code = 0;
+
+    free(state);
+    (*oldrespond)(oldarg, code);
+}
+
 /* Handle backend-managed authorization data */
-static krb5_error_code
+static void
 handle_kdb_authdata (krb5_context context,
+                     verto_ctx *vctx,
                      unsigned int flags,
                      krb5_db_entry *client,
                      krb5_db_entry *server,
@@ -670,12 +937,16 @@ handle_kdb_authdata (krb5_context context,
                      krb5_kdc_req *request,
                      krb5_const_principal for_user_princ,
                      krb5_enc_tkt_part *enc_tkt_request,
-                     krb5_enc_tkt_part *enc_tkt_reply)
+                     krb5_enc_tkt_part *enc_tkt_reply,
+                     kdc_authdata_respond_fn respond,
+                     void *arg)
 {
     krb5_error_code code;
-    krb5_authdata **tgt_authdata, **db_authdata = NULL;
+    krb5_authdata **tgt_authdata;
     krb5_boolean tgs_req = (request->msg_type == KRB5_TGS_REQ);
     krb5_const_principal actual_client;
+    krb5_authdata **db_authdata;
+    struct kdb_authdata_state *state;
 
     /*
      * Check whether KDC issued authorization data should be included.
@@ -690,17 +961,23 @@ handle_kdb_authdata (krb5_context context,
     if (tgs_req) {
         assert(enc_tkt_request != NULL);
 
-        if (isflagset(server->attributes, KRB5_KDB_NO_AUTH_DATA_REQUIRED))
-            return 0;
+        if (isflagset(server->attributes, KRB5_KDB_NO_AUTH_DATA_REQUIRED)) {
+            (*respond)(arg, 0);
+            return;
+        }
 
         if (enc_tkt_request->authorization_data == NULL &&
-            !isflagset(flags, KRB5_KDB_FLAG_CROSS_REALM | KRB5_KDB_FLAGS_S4U))
-            return 0;
+            !isflagset(flags, KRB5_KDB_FLAG_CROSS_REALM | KRB5_KDB_FLAGS_S4U)) {
+            (*respond)(arg, 0);
+            return;
+        }
 
         assert(enc_tkt_reply->times.authtime == enc_tkt_request->times.authtime);
     } else {
-        if (!isflagset(flags, KRB5_KDB_FLAG_INCLUDE_PAC))
-            return 0;
+        if (!isflagset(flags, KRB5_KDB_FLAG_INCLUDE_PAC)) {
+            (*respond)(arg, 0);
+            return;
+        }
     }
 
     /*
@@ -713,85 +990,220 @@ handle_kdb_authdata (krb5_context context,
     else
         actual_client = enc_tkt_reply->client;
 
+    state = k5alloc(sizeof(*state), &code);
+    if (state == NULL) {
+        (*respond)(arg, code);
+        return;
+    }
+    state->context = context;
+    state->enc_tkt_reply = enc_tkt_reply;
+    state->respond = respond;
+    state->arg = arg;
+    state->realm = kdc_active_realm;
     tgt_authdata = tgs_req ? enc_tkt_request->authorization_data : NULL;
-    code = krb5_db_sign_authdata(context, flags, actual_client, client,
-                                 server, krbtgt, client_key, server_key,
-                                 krbtgt_key, enc_tkt_reply->session,
-                                 enc_tkt_reply->times.authtime, tgt_authdata,
-                                 &db_authdata);
-    if (code == 0) {
-        code = merge_authdata(context,
-                              db_authdata,
-                              &enc_tkt_reply->authorization_data,
-                              FALSE,        /* !copy */
-                              FALSE);        /* !ignore_kdc_issued */
-        if (code != 0)
-            krb5_free_authdata(context, db_authdata);
-    } else if (code == KRB5_PLUGIN_OP_NOTSUPP)
-        code = 0;
 
-    return code;
+    if (tgs_req && authdata_cache_lifetime > 0) {
+        state->use_cache = TRUE;
+        state->cache_key.client = actual_client;
+        state->cache_key.server = server->princ;
+        state->cache_key.authtime = enc_tkt_reply->times.authtime;
+        state->cache_key.flags = flags;
+        state->cache_key.server_key = server_key;
+        state->cache_key.krbtgt_key = krbtgt_key;
+        state->cache_key.tgt_authdata = tgt_authdata;
+        if (authdata_cache_get(context, &state->cache_key, &db_authdata)) {
+            state->use_cache = FALSE;
+            finish_kdb_authdata(state, 0, db_authdata);
+            return;
+        }
+    }
+
+    /* The module may complete after we return, if it has to wait for an
+     * external lookup; finish_kdb_authdata picks up from there. */
+    krb5_db_sign_authdata_async(context, vctx, flags, actual_client, client,
+                                server, krbtgt, client_key, server_key,
+                                krbtgt_key, enc_tkt_reply->session,
+                                enc_tkt_reply->times.authtime, tgt_authdata,
+                                finish_kdb_authdata, state);
 }
 
-krb5_error_code
-handle_authdata (krb5_context context,
-                 unsigned int flags,
-                 krb5_db_entry *client,
-                 krb5_db_entry *server,
-                 krb5_db_entry *krbtgt,
-                 krb5_keyblock *client_key,
-                 krb5_keyblock *server_key,
-                 krb5_keyblock *krbtgt_key,
-                 krb5_data *req_pkt,
-                 krb5_kdc_req *request,
-                 krb5_const_principal for_user_princ,
-                 krb5_enc_tkt_part *enc_tkt_request,
-                 krb5_enc_tkt_part *enc_tkt_reply)
+/* State for running the authdata systems over one request. */
+struct authdata_state {
+    krb5_context context;
+    verto_ctx *vctx;
+    unsigned int flags;
+    krb5_db_entry *client;
+    krb5_db_entry *server;
+    krb5_db_entry *krbtgt;
+    krb5_keyblock *client_key;
+    krb5_keyblock *server_key;
+    krb5_keyblock *krbtgt_key;
+    krb5_data *req_pkt;
+    krb5_kdc_req *request;
+    krb5_const_principal for_user_princ;
+    krb5_enc_tkt_part *enc_tkt_request;
+    krb5_enc_tkt_part *enc_tkt_reply;
+    kdc_authdata_respond_fn respond;
+    void *arg;
+
+    int sys;                    /* Index of the current system */
+    krb5_error_code code;       /* Result of the last system run */
+    kdc_realm_t *realm;
+};
+
+/* Log a failure by asys, and return true if it should end processing. */
+static krb5_boolean
+authdata_system_failed(krb5_context context,
+                       const krb5_authdata_systems *asys,
+                       krb5_error_code code)
 {
-    krb5_error_code code = 0;
-    int i;
+    const char *emsg;
+
+    emsg = krb5_get_error_message (context, code);
+    krb5_klog_syslog(LOG_INFO, _("authdata (%s) handling failure: %s"),
+                     asys->name, emsg);
+    krb5_free_error_message (context, emsg);
+    return (asys->flags & AUTHDATA_FLAG_CRITICAL) != 0;
+}
+
+static void
+finish_authdata(struct authdata_state *state)
+{
+    kdc_authdata_respond_fn oldrespond = state->respond;
+    void *oldarg = state->arg;
+    krb5_error_code code = state->code;
+
+    free(state);
+    (*oldrespond)(oldarg, code);
+}
+
+static void run_authdata_systems(struct authdata_state *state);
 
-    for (i = 0; i < n_authdata_systems; i++) {
-        const krb5_authdata_systems *asys = &authdata_systems[i];
-        if (isflagset(enc_tkt_reply->flags, TKT_FLG_ANONYMOUS) &&
+/* Resume processing after an asynchronous system completes. */
+static void
+finish_authdata_system(void *arg, krb5_error_code code)
+{
+    struct authdata_state *state = arg;
+
+    kdc_active_realm = state->realm; /* Restore the realm. */
+    state->code = code;
+    if (code != 0 &&
+        authdata_system_failed(state->context,
+                               &authdata_systems[state->sys], code)) {
+        finish_authdata(state);
+        return;
+    }
+    state->sys++;
+    run_authdata_systems(state);
+}
+
+/* Run the authdata systems from state->sys onward, stopping to wait for any
+ * asynchronous system. */
+static void
+run_authdata_systems(struct authdata_state *state)
+{
+    krb5_context context = state->context;
+    const krb5_authdata_systems *asys;
+    krb5_error_code code;
+
+    for (; state->sys < n_authdata_systems; state->sys++) {
+        asys = &authdata_systems[state->sys];
+        if (isflagset(state->enc_tkt_reply->flags, TKT_FLG_ANONYMOUS) &&
             !isflagset(asys->flags, AUTHDATA_FLAG_ANONYMOUS))
             continue;
 
         switch (asys->type) {
         case AUTHDATA_SYSTEM_V0:
             /* V0 was only in AS-REQ code path */
-            if (request->msg_type != KRB5_AS_REQ)
+            if (state->request->msg_type != KRB5_AS_REQ)
                 continue;
 
-            code = (*asys->handle_authdata.v0)(context, client, req_pkt,
-                                               request, enc_tkt_reply);
+            code = (*asys->handle_authdata.v0)(context, state->client,
+                                               state->req_pkt, state->request,
+                                               state->enc_tkt_reply);
             break;
         case AUTHDATA_SYSTEM_V2:
-            code = (*asys->handle_authdata.v2)(context, flags,
-                                               client, server, krbtgt,
-                                               client_key, server_key, krbtgt_key,
-                                               req_pkt, request, for_user_princ,
-                                               enc_tkt_request,
-                                               enc_tkt_reply);
+            code = (*asys->handle_authdata.v2)(context, state->flags,
+                                               state->client, state->server,
+                                               state->krbtgt,
+                                               state->client_key,
+                                               state->server_key,
+                                               state->krbtgt_key,
+                                               state->req_pkt, state->request,
+                                               state->for_user_princ,
+                                               state->enc_tkt_request,
+                                               state->enc_tkt_reply);
             break;
+        case AUTHDATA_SYSTEM_ASYNC:
+            (*asys->handle_authdata_async)(context, state->vctx, state->flags,
+                                           state->client, state->server,
+                                           state->krbtgt, state->client_key,
+                                           state->server_key,
+                                           state->krbtgt_key, state->req_pkt,
+                                           state->request,
+                                           state->for_user_princ,
+                                           state->enc_tkt_request,
+                                           state->enc_tkt_reply,
+                                           finish_authdata_system, state);
+            return;
         default:
             code = 0;
             break;
         }
-        if (code != 0) {
-            const char *emsg;
+        state->code = code;
+        if (code != 0 && authdata_system_failed(context, asys, code))
+            break;
+    }
 
-            emsg = krb5_get_error_message (context, code);
-            krb5_klog_syslog(LOG_INFO, _("authdata (%s) handling failure: %s"),
-                             asys->name, emsg);
-            krb5_free_error_message (context, emsg);
+    finish_authdata(state);
+}
 
-            if (asys->flags & AUTHDATA_FLAG_CRITICAL)
-                break;
-        }
-    }
+void
+handle_authdata (krb5_context context,
+                 verto_ctx *vctx,
+                 unsigned int flags,
+                 krb5_db_entry *client,
+                 krb5_db_entry *server,
+                 krb5_db_entry *krbtgt,
+                 krb5_keyblock *client_key,
+                 krb5_keyblock *server_key,
+                 krb5_keyblock *krbtgt_key,
+                 krb5_data *req_pkt,
+                 krb5_kdc_req *request,
+                 krb5_const_principal for_user_princ,
+                 krb5_enc_tkt_part *enc_tkt_request,
+                 krb5_enc_tkt_part *enc_tkt_reply,
+                 kdc_authdata_respond_fn respond,
+                 void *arg)
+{
+    krb5_error_code code;
+    struct authdata_state *state;
 
-    return code;
+    state = k5alloc(sizeof(*state), &code);
+    if (state == NULL) {
+        (*respond)(arg, code);
+        return;
+    }
+    state->context = context;
+    state->vctx = vctx;
+    state->flags = flags;
+    state->client = client;
+    state->server = server;
+    state->krbtgt = krbtgt;
+    state->client_key = client_key;
+    state->server_key = server_key;
+    state->krbtgt_key = krbtgt_key;
+    state->req_pkt = req_pkt;
+    state->request = request;
+    state->for_user_princ = for_user_princ;
+    state->enc_tkt_request = enc_tkt_request;
+    state->enc_tkt_reply = enc_tkt_reply;
+    state->respond = respond;
+    state->arg = arg;
+    state->sys = 0;
+    state->code = 0;
+    state->realm = kdc_active_realm;
+    run_authdata_systems(state);
 }
 
 static krb5_error_code
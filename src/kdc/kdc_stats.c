@@ -0,0 +1,217 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/kdc_stats.c - Request timing statistics for the KDC */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * The KDC keeps counts, error counts, and latency histograms for each request
+ * type and for each timed phase of request processing.  Each KDC process
+ * (including each worker process) has a single thread.  Requests waiting on
+ * asynchronous preauth or authdata interleave in its event loop, but each
+ * statistics update runs to completion on that thread, so the statistics are
+ * plain per-process variables and need no locking.  Times are wall-clock, so
+ * a phase which waits also counts time spent on other requests meanwhile.
+ * kdc_stats_report() logs the statistics and starts a new interval.
+ */
+
+#include "k5-int.h"
+#include "kdc_util.h"
+#include "adm_proto.h"
+#include <syslog.h>
+
+/* Histogram bucket i counts durations below 2^i microseconds; the last
+ * bucket counts everything longer (about 16 seconds). */
+#define NBUCKETS 25
+
+/* Distinct error codes counted per request type. */
+#define MAX_ERRORS 32
+
+struct histogram {
+    unsigned long count;
+    double total_usec;
+    unsigned long max_usec;
+    unsigned long buckets[NBUCKETS];
+};
+
+struct error_count {
+    krb5_error_code code;
+    unsigned long count;
+};
+
+struct req_stats {
+    struct histogram total;
+    struct histogram phases[KDC_NPHASES];
+    unsigned long nerrors;
+    struct error_count errors[MAX_ERRORS];
+    unsigned long other_errors;
+};
+
+static struct req_stats stats[KDC_STATS_NREQTYPES];
+
+static const char *const reqtype_names[KDC_STATS_NREQTYPES] = {
+    "AS_REQ", "TGS_REQ"
+};
+
+static const char *const phase_names[KDC_NPHASES] = {
+    "decode", "auth", "db", "authdata", "reply"
+};
+
+/* Return the microseconds from the time in sec and usec to now, and update
+ * sec and usec to now. */
+static unsigned long
+elapsed(krb5_int32 *sec, krb5_int32 *usec)
+{
+    krb5_int32 now_sec, now_usec;
+    long diff;
+
+    if (krb5_crypto_us_timeofday(&now_sec, &now_usec) != 0)
+        return 0;
+    diff = (long)(now_sec - *sec) * 1000000 + (now_usec - *usec);
+    *sec = now_sec;
+    *usec = now_usec;
+    return (diff > 0) ? (unsigned long)diff : 0;
+}
+
+static void
+add_sample(struct histogram *h, unsigned long usec)
+{
+    int i;
+
+    for (i = 0; i < NBUCKETS - 1 && usec >= (1UL << i); i++);
+    h->buckets[i]++;
+    h->count++;
+    h->total_usec += usec;
+    if (usec > h->max_usec)
+        h->max_usec = usec;
+}
+
+/* Return the bucket bound at or below which pct percent of samples fall. */
+static unsigned long
+percentile(const struct histogram *h, int pct)
+{
+    unsigned long sum = 0, want = (h->count * pct + 99) / 100;
+    int i;
+
+    for (i = 0; i < NBUCKETS - 1; i++) {
+        sum += h->buckets[i];
+        if (sum >= want)
+            break;
+    }
+    return (i < NBUCKETS - 1) ? 1UL << i : h->max_usec;
+}
+
+static void
+format_histogram(const struct histogram *h, char *buf, size_t len)
+{
+    snprintf(buf, len, "avg %luus, max %luus, p50 <%luus, p90 <%luus, "
+             "p99 <%luus", (unsigned long)(h->total_usec / h->count),
+             h->max_usec, percentile(h, 50), percentile(h, 90),
+             percentile(h, 99));
+}
+
+void
+kdc_timer_start(struct kdc_timer *timer)
+{
+    memset(timer, 0, sizeof(*timer));
+    if (krb5_crypto_us_timeofday(&timer->start_sec, &timer->start_usec) != 0)
+        return;
+    timer->last_sec = timer->start_sec;
+    timer->last_usec = timer->start_usec;
+}
+
+/* Charge the time since the last mark (or the start) to phase. */
+void
+kdc_timer_mark(struct kdc_timer *timer, int phase)
+{
+    timer->phase_usec[phase] += elapsed(&timer->last_sec, &timer->last_usec);
+    timer->phases_seen |= 1U << phase;
+}
+
+/* Record a finished request of type reqtype with result code. */
+void
+kdc_stats_record(int reqtype, krb5_error_code code, struct kdc_timer *timer)
+{
+    struct req_stats *rs = &stats[reqtype];
+    int i;
+
+    add_sample(&rs->total, elapsed(&timer->start_sec, &timer->start_usec));
+    for (i = 0; i < KDC_NPHASES; i++) {
+        if (timer->phases_seen & (1U << i))
+            add_sample(&rs->phases[i], timer->phase_usec[i]);
+    }
+
+    if (code == 0)
+        return;
+    rs->nerrors++;
+    for (i = 0; i < MAX_ERRORS && rs->errors[i].count > 0; i++) {
+        if (rs->errors[i].code == code)
+            break;
+    }
+    if (i == MAX_ERRORS) {
+        rs->other_errors++;
+    } else {
+        rs->errors[i].code = code;
+        rs->errors[i].count++;
+    }
+}
+
+/* Log the statistics gathered since the last report, and reset them. */
+void
+kdc_stats_report(void)
+{
+    struct req_stats *rs;
+    char buf[256];
+    int t, i, any = 0;
+
+    for (t = 0; t < KDC_STATS_NREQTYPES; t++) {
+        rs = &stats[t];
+        if (rs->total.count == 0)
+            continue;
+        any = 1;
+        format_histogram(&rs->total, buf, sizeof(buf));
+        krb5_klog_syslog(LOG_INFO, _("stats: %s: %lu requests, %lu errors, "
+                                     "%s"), reqtype_names[t],
+                         rs->total.count, rs->nerrors, buf);
+        for (i = 0; i < KDC_NPHASES; i++) {
+            if (rs->phases[i].count == 0)
+                continue;
+            format_histogram(&rs->phases[i], buf, sizeof(buf));
+            krb5_klog_syslog(LOG_INFO, _("stats: %s: phase %s: %s"),
+                             reqtype_names[t], phase_names[i], buf);
+        }
+        for (i = 0; i < MAX_ERRORS && rs->errors[i].count > 0; i++) {
+            krb5_klog_syslog(LOG_INFO, _("stats: %s: error %ld (%s): %lu"),
+                             reqtype_names[t], (long)rs->errors[i].code,
+                             error_message(rs->errors[i].code),
+                             rs->errors[i].count);
+        }
+        if (rs->other_errors > 0) {
+            krb5_klog_syslog(LOG_INFO, _("stats: %s: other errors: %lu"),
+                             reqtype_names[t], rs->other_errors);
+        }
+    }
+    if (!any)
+        krb5_klog_syslog(LOG_INFO, _("stats: no requests"));
+    memset(stats, 0, sizeof(stats));
+}
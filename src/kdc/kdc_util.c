@@ -486,6 +486,7 @@ find_server_key(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
     krb5_error_code       retval;
     krb5_key_data       * server_key;
     krb5_keyblock       * key;
+    krb5_key              kobj;
 
     *key_out = NULL;
     retval = krb5_dbe_find_enctype(kdc_context, server, enctype, -1,
@@ -494,12 +495,15 @@ find_server_key(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
         return retval;
     if (!server_key)
         return KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN;
-    if ((key = (krb5_keyblock *)malloc(sizeof *key)) == NULL)
-        return ENOMEM;
-    retval = krb5_dbe_decrypt_key_data(kdc_context, NULL, server_key,
-                                       key, NULL);
+    /* The cache saves the master key decryption; our callers need a
+     * keyblock, so derived keys are not reused here. */
+    retval = kdc_decrypt_key_data(server_key, &kobj);
     if (retval)
-        goto errout;
+        return retval;
+    retval = krb5_k_key_keyblock(kdc_context, kobj, &key);
+    krb5_k_free_key(kdc_context, kobj);
+    if (retval)
+        return retval;
     if (enctype != -1) {
         krb5_boolean similar;
         retval = krb5_c_enctype_compare(kdc_context, enctype, key->enctype,
@@ -521,6 +525,139 @@ errout:
     return retval;
 }
 
+/*
+ * Server keys decrypted from the KDB are cached per realm, indexed by their
+ * encrypted form, so that repeated requests for the same service do not
+ * decrypt the key with the master key again.  Callers which keep using the
+ * krb5_key object, as kdc_encrypt_tkt_part() does, also reuse the encryption
+ * keys derived in it; callers which copy out a keyblock do not.  An entry
+ * only matches identical key data, so a key change in the database takes
+ * effect immediately.
+ */
+#define KDC_KEY_CACHE_SIZE 256
+
+struct kdc_key_cache_ent {
+    krb5_int16 type;
+    krb5_ui_2 length;
+    krb5_octet *contents;
+    krb5_key key;
+};
+
+/* Decrypt key_data into a key object, using the active realm's cache. */
+krb5_error_code
+kdc_decrypt_key_data(krb5_key_data *key_data, krb5_key *key_out)
+{
+    krb5_error_code retval;
+    struct kdc_key_cache_ent *ent = NULL;
+    krb5_keyblock kb;
+    krb5_octet *contents = key_data->key_data_contents[0];
+    krb5_ui_2 len = key_data->key_data_length[0], i;
+    krb5_key key;
+    unsigned int h = 2166136261U;
+
+    *key_out = NULL;
+
+    if (kdc_active_realm->realm_key_cache == NULL) {
+        kdc_active_realm->realm_key_cache =
+            calloc(KDC_KEY_CACHE_SIZE, sizeof(struct kdc_key_cache_ent));
+    }
+    if (kdc_active_realm->realm_key_cache != NULL && contents != NULL &&
+        len > 0) {
+        for (i = 0; i < len; i++)
+            h = (h ^ contents[i]) * 16777619U;
+        ent = &kdc_active_realm->realm_key_cache[h % KDC_KEY_CACHE_SIZE];
+        if (ent->key != NULL && ent->type == key_data->key_data_type[0] &&
+            ent->length == len && memcmp(ent->contents, contents, len) == 0) {
+            krb5_k_reference_key(kdc_context, ent->key);
+            *key_out = ent->key;
+            return 0;
+        }
+    }
+
+    retval = krb5_dbe_decrypt_key_data(kdc_context, NULL, key_data, &kb,
+                                       NULL);
+    if (retval)
+        return retval;
+    retval = krb5_k_create_key(kdc_context, &kb, &key);
+    krb5_free_keyblock_contents(kdc_context, &kb);
+    if (retval)
+        return retval;
+
+    /* Replace the entry in this slot; failing to cache is not an error. */
+    if (ent != NULL) {
+        contents = malloc(len);
+        if (contents != NULL) {
+            memcpy(contents, key_data->key_data_contents[0], len);
+            free(ent->contents);
+            krb5_k_free_key(kdc_context, ent->key);
+            ent->type = key_data->key_data_type[0];
+            ent->length = len;
+            ent->contents = contents;
+            krb5_k_reference_key(kdc_context, key);
+            ent->key = key;
+        }
+    }
+    *key_out = key;
+    return 0;
+}
+
+void
+kdc_free_key_cache(kdc_realm_t *rdp)
+{
+    struct kdc_key_cache_ent *ent;
+    int i;
+
+    if (rdp->realm_key_cache == NULL)
+        return;
+    for (i = 0; i < KDC_KEY_CACHE_SIZE; i++) {
+        ent = &rdp->realm_key_cache[i];
+        free(ent->contents);
+        krb5_k_free_key(rdp->realm_context, ent->key);
+    }
+    free(rdp->realm_key_cache);
+    rdp->realm_key_cache = NULL;
+}
+
+/*
+ * Encrypt ticket->enc_part2 into ticket->enc_part like
+ * krb5_encrypt_tkt_part(), but with a key object so that derived keys
+ * cached in it are reused.
+ */
+krb5_error_code
+kdc_encrypt_tkt_part(krb5_key key, krb5_ticket *ticket)
+{
+    krb5_error_code retval;
+    krb5_data *scratch;
+    krb5_enc_data *enc = &ticket->enc_part;
+    size_t enclen;
+
+    retval = encode_krb5_enc_tkt_part(ticket->enc_part2, &scratch);
+    if (retval)
+        return retval;
+    retval = krb5_c_encrypt_length(kdc_context, krb5_k_key_enctype(kdc_context,
+                                                                  key),
+                                   scratch->length, &enclen);
+    if (retval)
+        goto cleanup;
+    enc->ciphertext.data = malloc(enclen);
+    if (enc->ciphertext.data == NULL) {
+        retval = ENOMEM;
+        goto cleanup;
+    }
+    enc->ciphertext.length = enclen;
+    retval = krb5_k_encrypt(kdc_context, key, KRB5_KEYUSAGE_KDC_REP_TICKET,
+                            NULL, scratch, enc);
+    if (retval) {
+        free(enc->ciphertext.data);
+        enc->ciphertext.data = NULL;
+    }
+
+cleanup:
+    zapfree(scratch->data, scratch->length);
+    free(scratch);
+    return retval;
+}
+
 /* This probably wants to be updated if you support last_req stuff */
 
 static krb5_last_req_entry nolrentry = { KV5M_LAST_REQ_ENTRY, KRB5_LRQ_NONE, 0 };
@@ -71,6 +71,12 @@ kdc_get_server_key (krb5_ticket *, unsigned int,
                     krb5_boolean match_enctype,
                     krb5_db_entry **, krb5_keyblock **, krb5_kvno *);
 
+krb5_error_code
+kdc_decrypt_key_data (krb5_key_data *, krb5_key *);
+
+krb5_error_code
+kdc_encrypt_tkt_part (krb5_key, krb5_ticket *);
+
 int
 validate_as_request (krb5_kdc_req *, krb5_db_entry,
                      krb5_db_entry, krb5_timestamp,
@@ -105,15 +111,14 @@ rep_etypes2str(char *s, size_t len, krb5_kdc_rep *rep);
 
 /* do_as_req.c */
 void
-process_as_req (krb5_kdc_req *, krb5_data *,
-                const krb5_fulladdr *,
+process_as_req (krb5_data *, const krb5_fulladdr *,
                 verto_ctx *, loop_respond_fn, void *);
 
 /* do_tgs_req.c */
-krb5_error_code
+void
 process_tgs_req (krb5_data *,
                  const krb5_fulladdr *,
-                 krb5_data ** );
+                 verto_ctx *, loop_respond_fn, void *);
 /* dispatch.c */
 void
 dispatch (void *,
@@ -205,8 +210,17 @@ load_authdata_plugins(krb5_context context);
 krb5_error_code
 unload_authdata_plugins(krb5_context context);
 
-krb5_error_code
+/* Callback for handle_authdata; code is 0 if authorization data for the
+ * ticket was successfully handled. */
+typedef void (*kdc_authdata_respond_fn)(void *arg, krb5_error_code code);
+
+/* Run the authdata systems over a ticket being issued, adding authorization
+ * data to enc_tkt_reply.  respond may be invoked after this function returns
+ * if a system has to wait on an external lookup; the arguments must remain
+ * valid until then. */
+void
 handle_authdata (krb5_context context,
+                 verto_ctx *vctx,
                  unsigned int flags,
                  krb5_db_entry *client,
                  krb5_db_entry *server,
@@ -218,7 +232,9 @@ handle_authdata (krb5_context context,
                  krb5_kdc_req *request,
                  krb5_const_principal for_user_princ,
                  krb5_enc_tkt_part *enc_tkt_request,
-                 krb5_enc_tkt_part *enc_tkt_reply);
+                 krb5_enc_tkt_part *enc_tkt_reply,
+                 kdc_authdata_respond_fn respond,
+                 void *arg);
 
 /* replay.c */
 krb5_error_code kdc_init_lookaside(krb5_context context);
@@ -321,6 +337,35 @@ log_tgs_req(const krb5_fulladdr *from,
 void
 log_tgs_alt_tgt(krb5_principal p);
 
+/* kdc_stats.c */
+
+/* Request types for which statistics are kept. */
+#define KDC_STATS_AS_REQ        0
+#define KDC_STATS_TGS_REQ       1
+#define KDC_STATS_NREQTYPES     2
+
+/* Phases of request processing which are timed separately. */
+#define KDC_PHASE_DECODE        0       /* Decoding the request */
+#define KDC_PHASE_AUTH          1       /* Checking the TGT or preauth */
+#define KDC_PHASE_DB            2       /* Lookups, policy checks */
+#define KDC_PHASE_AUTHDATA      3       /* Authorization data, PAC */
+#define KDC_PHASE_REPLY         4       /* Encrypting and encoding reply */
+#define KDC_NPHASES             5
+
+/* Timing state for one request, kept by the request's processing code. */
+struct kdc_timer {
+    krb5_int32 start_sec, start_usec;
+    krb5_int32 last_sec, last_usec;
+    unsigned int phases_seen;
+    unsigned long phase_usec[KDC_NPHASES];
+};
+
+void kdc_timer_start(struct kdc_timer *timer);
+void kdc_timer_mark(struct kdc_timer *timer, int phase);
+void kdc_stats_record(int reqtype, krb5_error_code code,
+                      struct kdc_timer *timer);
+void kdc_stats_report(void);
+
 /*Request state*/
 
 struct kdc_request_state {
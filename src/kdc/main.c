@@ -92,6 +92,8 @@ static const char *pid_file = NULL;
 static int rkey_init_done = 0;
 static volatile int signal_received = 0;
 static volatile int sighup_received = 0;
+static volatile int sigusr1_received = 0;
+static krb5_int32 stats_interval = 0;
 
 #define KRB5_KDC_MAX_REALMS     32
 
@@ -181,6 +183,7 @@ finish_realm(kdc_realm_t *rdp)
             memset(rdp->realm_mkey.contents, 0, rdp->realm_mkey.length);
             free(rdp->realm_mkey.contents);
         }
+        kdc_free_key_cache(rdp);
         krb5_db_fini(rdp->realm_context);
         if (rdp->realm_tgsprinc)
             krb5_free_principal(rdp->realm_context, rdp->realm_tgsprinc);
@@ -510,6 +513,41 @@ on_monitor_sighup(int signo)
 #endif
 }
 
+static krb5_sigtype
+on_monitor_sigusr1(int signo)
+{
+    sigusr1_received = 1;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+static void
+on_stats_event(verto_ctx *ctx, verto_ev *ev)
+{
+    kdc_stats_report();
+}
+
+/*
+ * Arrange for request statistics to be logged on SIGUSR1, and every
+ * stats_interval seconds if that is set.
+ */
+static krb5_error_code
+setup_stats_events(verto_ctx *ctx)
+{
+    if (!verto_add_signal(ctx, VERTO_EV_FLAG_PERSIST, on_stats_event,
+                          SIGUSR1))
+        return ENOMEM;
+    if (stats_interval > 0 &&
+        !verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, on_stats_event,
+                           (time_t)stats_interval * 1000))
+        return ENOMEM;
+    return 0;
+}
+
 /*
  * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
  * are set to -1, and wait for them to exit (so that we know the ports are no
@@ -565,15 +603,19 @@ create_workers(verto_ctx *ctx, int num)
     (void) sigaction(SIGQUIT, &s_action, (struct sigaction *) NULL);
     s_action.sa_handler = on_monitor_sighup;
     (void) sigaction(SIGHUP, &s_action, (struct sigaction *) NULL);
+    s_action.sa_handler = on_monitor_sigusr1;
+    (void) sigaction(SIGUSR1, &s_action, (struct sigaction *) NULL);
 #else  /* POSIX_SIGNALS */
     signal(SIGINT, on_monitor_signal);
     signal(SIGTERM, on_monitor_signal);
     signal(SIGQUIT, on_monitor_signal);
     signal(SIGHUP, on_monitor_sighup);
+    signal(SIGUSR1, on_monitor_sigusr1);
 #endif /* POSIX_SIGNALS */
 
     /* Create child worker processes; return in each child. */
     krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), num);
+    krb5_klog_flush(NULL);
     pids = calloc(num, sizeof(pid_t));
     if (pids == NULL)
         return ENOMEM;
@@ -586,6 +628,8 @@ create_workers(verto_ctx *ctx, int num)
                 return ENOMEM;
             }
             retval = loop_setup_signals(ctx, NULL, reset_for_hangup);
+            if (retval == 0)
+                retval = setup_stats_events(ctx);
             if (retval) {
                 krb5_klog_syslog(LOG_ERR, _("Unable to initialize signal "
                                             "handlers in pid %d"), pid);
@@ -640,6 +684,15 @@ create_workers(verto_ctx *ctx, int num)
                     kill(pids[i], SIGHUP);
             }
         }
+
+        /* Likewise for USR1, so that each worker logs its statistics. */
+        if (sigusr1_received) {
+            sigusr1_received = 0;
+            for (i = 0; i < num; i++) {
+                if (pids[i] != -1)
+                    kill(pids[i], SIGUSR1);
+            }
+        }
     }
     if (signal_received)
         krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
@@ -708,6 +761,13 @@ initialize_realms(krb5_context kcontext, int argc, char **argv)
         hierarchy[1] = KRB5_CONF_MAX_DGRAM_REPLY_SIZE;
         if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &max_dgram_reply_size))
             max_dgram_reply_size = MAX_DGRAM_SIZE;
+        hierarchy[1] = KRB5_CONF_KDC_STATS_INTERVAL;
+        if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &stats_interval))
+            stats_interval = 0;
+        hierarchy[1] = KRB5_CONF_KDC_AUTHDATA_CACHE_LIFETIME;
+        if (krb5_aprof_get_deltat(aprof, hierarchy, TRUE,
+                                  &authdata_cache_lifetime))
+            authdata_cache_lifetime = 0;
         hierarchy[1] = KRB5_CONF_RESTRICT_ANONYMOUS_TO_TGT;
         if (krb5_aprof_get_boolean(aprof, hierarchy, TRUE, &def_restrict_anon))
             def_restrict_anon = FALSE;
@@ -1085,6 +1145,8 @@ int main(int argc, char **argv)
             return 1;
         }
         retval = loop_setup_signals(ctx, NULL, reset_for_hangup);
+        if (retval == 0)
+            retval = setup_stats_events(ctx);
         if (retval) {
             kdc_err(kcontext, retval, _("while initializing signal handlers"));
             finish_realms();
@@ -1126,6 +1188,7 @@ int main(int argc, char **argv)
 
     verto_run(ctx);
     loop_free(ctx);
+    kdc_stats_report();
     krb5_klog_syslog(LOG_INFO, _("shutting down"));
     unload_preauth_plugins(kcontext);
     unload_authdata_plugins(kcontext);
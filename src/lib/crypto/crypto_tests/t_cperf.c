@@ -0,0 +1,379 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/crypto_tests/t_cperf.c - crypto layer throughput benchmark */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program measures the throughput of libk5crypto operations, sweeping
+ * over operations, enctypes, message sizes, and thread counts.  Sample
+ * usages:
+ *
+ *     ./t_cperf
+ *     ./t_cperf -o encrypt -o encrypt_iov -e aes256-cts -t 1 -t 4 -d 2
+ *
+ * The first usage runs every operation for every supported enctype at
+ * message sizes from 64 bytes to 1MB, single-threaded, for one second each.
+ * The second compares the flat and IOV encryption interfaces for
+ * aes256-cts, with one and four threads, for two seconds each.
+ *
+ * Each thread uses its own key object, created from the same keyblock.  The
+ * krb5_k interfaces are used so that derived keys are cached, as they are in
+ * the library.  Results are written to stdout as tab-separated lines, after a
+ * header line beginning with "#", and include the name of the crypto
+ * implementation the library was built with, so that the output of builds
+ * using different back ends can be compared directly.
+ *
+ * Decryption of IOVs happens in place, so the decrypt_iov operation includes
+ * the cost of restoring the ciphertext before each call.
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+#include <pthread.h>
+
+#ifndef CRYPTO_IMPL_NAME
+#define CRYPTO_IMPL_NAME "unknown"
+#endif
+
+enum op {
+    OP_ENCRYPT, OP_DECRYPT, OP_ENCRYPT_IOV, OP_DECRYPT_IOV, OP_CHECKSUM,
+    OP_VERIFY, OP_PRF, OP_STR2KEY
+};
+
+static const struct {
+    const char *name;
+    enum op op;
+    krb5_boolean sized;         /* Sweep over message sizes? */
+} ops[] = {
+    { "encrypt", OP_ENCRYPT, TRUE },
+    { "decrypt", OP_DECRYPT, TRUE },
+    { "encrypt_iov", OP_ENCRYPT_IOV, TRUE },
+    { "decrypt_iov", OP_DECRYPT_IOV, TRUE },
+    { "checksum", OP_CHECKSUM, TRUE },
+    { "verify", OP_VERIFY, TRUE },
+    { "prf", OP_PRF, FALSE },
+    { "str2key", OP_STR2KEY, FALSE },
+};
+#define NOPS (sizeof(ops) / sizeof(*ops))
+
+static const char *default_enctypes[] = {
+    "aes256-cts", "aes128-cts", "des3-cbc-sha1", "arcfour-hmac",
+    "camellia256-cts-cmac", "camellia128-cts-cmac", "des-cbc-crc"
+};
+#define NDEFAULT_ENCTYPES (sizeof(default_enctypes) / sizeof(*default_enctypes))
+
+static const size_t default_sizes[] = {
+    64, 256, 1024, 4096, 16384, 65536, 262144, 1048576
+};
+#define NDEFAULT_SIZES (sizeof(default_sizes) / sizeof(*default_sizes))
+
+/* Input length for the unsized operations. */
+#define PRF_INPUT_LEN 16
+#define STR2KEY_PASSWORD "benchmark-password"
+#define STR2KEY_SALT "KRBTEST.COMbenchmark"
+
+#define MAX_ARGS 32
+
+struct job {
+    pthread_t tid;
+    enum op op;
+    krb5_keyblock *kb;
+    size_t size;
+    double stop;
+    unsigned long count;
+    double end;
+};
+
+static void
+t(krb5_error_code code)
+{
+    const char *msg;
+
+    if (code != 0) {
+        msg = krb5_get_error_message(NULL, code);
+        fprintf(stderr, "Failure: %s\n", msg);
+        krb5_free_error_message(NULL, msg);
+        exit(1);
+    }
+}
+
+static double
+now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+usage()
+{
+    fprintf(stderr, "Usage: t_cperf [-o op]... [-e enctype]... [-s size]... "
+            "[-t threads]... [-d seconds]\n");
+    exit(1);
+}
+
+/* Fill in iov with header, data, padding, and trailer for a message. */
+static void
+setup_iov(krb5_enctype enctype, size_t size, krb5_crypto_iov *iov)
+{
+    int i;
+
+    iov[0].flags = KRB5_CRYPTO_TYPE_HEADER;
+    iov[1].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[1].data.length = size;
+    iov[2].flags = KRB5_CRYPTO_TYPE_PADDING;
+    iov[3].flags = KRB5_CRYPTO_TYPE_TRAILER;
+    t(krb5_c_crypto_length_iov(NULL, enctype, iov, 4));
+    for (i = 0; i < 4; i++)
+        t(alloc_data(&iov[i].data, iov[i].data.length));
+}
+
+static void *
+run_job(void *arg)
+{
+    struct job *job = arg;
+    krb5_enctype enctype = job->kb->enctype;
+    krb5_key key;
+    krb5_cksumtype cktype;
+    krb5_data plain, prfin, prfout, saved[4];
+    krb5_data pw = string2data(STR2KEY_PASSWORD);
+    krb5_data salt = string2data(STR2KEY_SALT);
+    krb5_enc_data cipher;
+    krb5_crypto_iov iov[4];
+    krb5_checksum sum;
+    krb5_keyblock s2kkb;
+    krb5_boolean valid;
+    size_t len;
+    int i;
+
+    t(krb5_k_create_key(NULL, job->kb, &key));
+    t(krb5_c_encrypt_length(NULL, enctype, job->size, &len));
+    t(alloc_data(&cipher.ciphertext, len));
+    /* Some enctypes need room for padding when decrypting. */
+    t(alloc_data(&plain, len));
+    memset(plain.data, 'x', plain.length);
+    plain.length = job->size;
+    cipher.enctype = enctype;
+    t(krb5int_c_mandatory_cksumtype(NULL, enctype, &cktype));
+    memset(&sum, 0, sizeof(sum));
+    setup_iov(enctype, job->size, iov);
+    t(alloc_data(&prfin, PRF_INPUT_LEN));
+    t(krb5_c_prf_length(NULL, enctype, &len));
+    t(alloc_data(&prfout, len));
+    memset(&s2kkb, 0, sizeof(s2kkb));
+
+    /* Prepare inputs for the operations which consume earlier output. */
+    if (job->op == OP_DECRYPT)
+        t(krb5_k_encrypt(NULL, key, 0, NULL, &plain, &cipher));
+    if (job->op == OP_VERIFY)
+        t(krb5_k_make_checksum(NULL, cktype, key, 0, &plain, &sum));
+    if (job->op == OP_DECRYPT_IOV) {
+        t(krb5_k_encrypt_iov(NULL, key, 0, NULL, iov, 4));
+        for (i = 0; i < 4; i++)
+            t(krb5int_copy_data_contents(NULL, &iov[i].data, &saved[i]));
+    }
+
+    job->count = 0;
+    do {
+        switch (job->op) {
+        case OP_ENCRYPT:
+            t(krb5_k_encrypt(NULL, key, 0, NULL, &plain, &cipher));
+            break;
+        case OP_DECRYPT:
+            plain.length = cipher.ciphertext.length;
+            t(krb5_k_decrypt(NULL, key, 0, NULL, &cipher, &plain));
+            break;
+        case OP_ENCRYPT_IOV:
+            t(krb5_k_encrypt_iov(NULL, key, 0, NULL, iov, 4));
+            break;
+        case OP_DECRYPT_IOV:
+            for (i = 0; i < 4; i++)
+                memcpy(iov[i].data.data, saved[i].data, saved[i].length);
+            t(krb5_k_decrypt_iov(NULL, key, 0, NULL, iov, 4));
+            break;
+        case OP_CHECKSUM:
+            krb5_free_checksum_contents(NULL, &sum);
+            t(krb5_k_make_checksum(NULL, cktype, key, 0, &plain, &sum));
+            break;
+        case OP_VERIFY:
+            t(krb5_k_verify_checksum(NULL, key, 0, &plain, &sum, &valid));
+            if (!valid)
+                t(KRB5KRB_AP_ERR_BAD_INTEGRITY);
+            break;
+        case OP_PRF:
+            t(krb5_k_prf(NULL, key, &prfin, &prfout));
+            break;
+        case OP_STR2KEY:
+            krb5_free_keyblock_contents(NULL, &s2kkb);
+            t(krb5_c_string_to_key(NULL, enctype, &pw, &salt, &s2kkb));
+            break;
+        }
+        job->count++;
+    } while (now() < job->stop);
+    job->end = now();
+
+    if (job->op == OP_DECRYPT_IOV) {
+        for (i = 0; i < 4; i++)
+            krb5_free_data_contents(NULL, &saved[i]);
+    }
+    for (i = 0; i < 4; i++)
+        krb5_free_data_contents(NULL, &iov[i].data);
+    krb5_free_keyblock_contents(NULL, &s2kkb);
+    krb5_free_data_contents(NULL, &prfout);
+    krb5_free_data_contents(NULL, &prfin);
+    krb5_free_checksum_contents(NULL, &sum);
+    krb5_free_data_contents(NULL, &cipher.ciphertext);
+    krb5_free_data_contents(NULL, &plain);
+    krb5_k_free_key(NULL, key);
+    return NULL;
+}
+
+/* Run op with nthreads threads for the given duration and print a result. */
+static void
+bench(enum op op, const char *opname, const char *etname, krb5_keyblock *kb,
+      size_t size, int nthreads, double duration)
+{
+    struct job *jobs;
+    unsigned long count = 0;
+    double start, end = 0, elapsed, rate;
+    int i;
+
+    jobs = calloc(nthreads, sizeof(*jobs));
+    if (jobs == NULL)
+        t(ENOMEM);
+    start = now();
+    for (i = 0; i < nthreads; i++) {
+        jobs[i].op = op;
+        jobs[i].kb = kb;
+        jobs[i].size = size;
+        jobs[i].stop = start + duration;
+        t(pthread_create(&jobs[i].tid, NULL, run_job, &jobs[i]));
+    }
+    for (i = 0; i < nthreads; i++) {
+        t(pthread_join(jobs[i].tid, NULL));
+        count += jobs[i].count;
+        if (jobs[i].end > end)
+            end = jobs[i].end;
+    }
+    free(jobs);
+
+    elapsed = end - start;
+    rate = (elapsed > 0) ? count / elapsed : 0;
+    printf("%s\t%s\t%s\t%lu\t%d\t%lu\t%.6f\t%.1f\t%.3f\n", CRYPTO_IMPL_NAME,
+           opname, etname, (unsigned long)size, nthreads, count, elapsed,
+           rate, rate * size / 1048576);
+    fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *opnames[MAX_ARGS], *etnames[MAX_ARGS];
+    size_t sizes[MAX_ARGS], size;
+    int threads[MAX_ARGS], nopnames = 0, netnames = 0, nsizes = 0;
+    int nthreadargs = 0, c, o, e, s, th, n;
+    double duration = 1.0;
+    krb5_enctype enctypes[MAX_ARGS];
+    krb5_keyblock kb;
+    krb5_data seed = string2data("notrandom");
+    size_t j;
+
+    while ((c = getopt(argc, argv, "o:e:s:t:d:")) != -1) {
+        if (c == 'd') {
+            duration = strtod(optarg, NULL);
+            continue;
+        }
+        if (c == 'o' && nopnames < MAX_ARGS)
+            opnames[nopnames++] = optarg;
+        else if (c == 'e' && netnames < MAX_ARGS)
+            etnames[netnames++] = optarg;
+        else if (c == 's' && nsizes < MAX_ARGS)
+            sizes[nsizes++] = strtoul(optarg, NULL, 10);
+        else if (c == 't' && nthreadargs < MAX_ARGS)
+            threads[nthreadargs++] = atoi(optarg);
+        else
+            usage();
+    }
+    if (optind != argc || duration < 0)
+        usage();
+    if (nopnames == 0) {
+        for (j = 0; j < NOPS; j++)
+            opnames[nopnames++] = ops[j].name;
+    }
+    if (netnames == 0) {
+        for (j = 0; j < NDEFAULT_ENCTYPES; j++)
+            etnames[netnames++] = default_enctypes[j];
+    }
+    if (nsizes == 0) {
+        for (j = 0; j < NDEFAULT_SIZES; j++)
+            sizes[nsizes++] = default_sizes[j];
+    }
+    if (nthreadargs == 0)
+        threads[nthreadargs++] = 1;
+    for (th = 0; th < nthreadargs; th++) {
+        if (threads[th] <= 0)
+            usage();
+    }
+
+    /* Seed the PRNG instead of creating a context, so we don't need
+     * krb5.conf. */
+    t(krb5_c_random_seed(NULL, &seed));
+
+    printf("#impl\top\tenctype\tsize\tthreads\tops\tseconds\tops/s\tMB/s\n");
+    for (e = 0, n = 0; e < netnames; e++) {
+        if (krb5_string_to_enctype((char *)etnames[e], &enctypes[n]) != 0 ||
+            !krb5_c_valid_enctype(enctypes[n])) {
+            printf("# skipping unsupported enctype %s\n", etnames[e]);
+            continue;
+        }
+        etnames[n++] = etnames[e];
+    }
+    netnames = n;
+
+    for (o = 0; o < nopnames; o++) {
+        for (j = 0; j < NOPS; j++) {
+            if (strcmp(opnames[o], ops[j].name) == 0)
+                break;
+        }
+        if (j == NOPS) {
+            fprintf(stderr, "Unknown operation: %s\n", opnames[o]);
+            exit(1);
+        }
+        for (e = 0; e < netnames; e++) {
+            t(krb5_c_make_random_key(NULL, enctypes[e], &kb));
+            for (s = 0; s < (ops[j].sized ? nsizes : 1); s++) {
+                size = ops[j].sized ? sizes[s] : (ops[j].op == OP_PRF) ?
+                    PRF_INPUT_LEN : strlen(STR2KEY_PASSWORD);
+                for (th = 0; th < nthreadargs; th++) {
+                    bench(ops[j].op, ops[j].name, etnames[e], &kb, size,
+                          threads[th], duration);
+                }
+            }
+            krb5_free_keyblock_contents(NULL, &kb);
+        }
+    }
+    return 0;
+}
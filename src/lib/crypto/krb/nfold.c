@@ -47,8 +47,8 @@ void
 krb5int_nfold(unsigned int inbits, const unsigned char *in, unsigned int outbits,
               unsigned char *out)
 {
-    int a,b,c,lcm;
-    int byte, i, msbit;
+    unsigned int a, b, c, lcm, reps, rot, off, q, sh, o, j;
+    unsigned int byte = 0, val;
 
     /* the code below is more readable if I make these bytes
        instead of bits */
@@ -72,53 +72,49 @@ krb5int_nfold(unsigned int inbits, const unsigned char *in, unsigned int outbits
     /* now do the real work */
 
     memset(out, 0, outbits);
-    byte = 0;
-
-    /* this will end up cycling through k lcm(k,n)/k times, which
-       is correct */
-    for (i=lcm-1; i>=0; i--) {
-        /* compute the msbit in k which gets added into this byte */
-        msbit = (/* first, start with the msbit in the first, unrotated
-                    byte */
-            ((inbits<<3)-1)
-            /* then, for each byte, shift to the right for each
-               repetition */
-            +(((inbits<<3)+13)*(i/inbits))
-            /* last, pick out the correct byte within that
-               shifted repetition */
-            +((inbits-(i%inbits))<<3)
-        )%(inbits<<3);
-
-        /* pull out the byte value itself */
-        byte += (((in[((inbits-1)-(msbit>>3))%inbits]<<8)|
-                  (in[((inbits)-(msbit>>3))%inbits]))
-                 >>((msbit&7)+1))&0xff;
-
-        /* do the addition */
-        byte += out[i%outbits];
-        out[i%outbits] = byte&0xff;
-
-#if 0
-        printf("msbit[%d] = %d\tbyte = %02x\tsum = %03x\n", i, msbit,
-               (((in[((inbits-1)-(msbit>>3))%inbits]<<8)|
-                 (in[((inbits)-(msbit>>3))%inbits]))
-                >>((msbit&7)+1))&0xff, byte);
-#endif
-
-        /* keep around the carry bit, if any */
-        byte >>= 8;
-
-#if 0
-        printf("carry=%d\n", byte);
-#endif
+
+    /*
+     * Walk s from its last byte to its first, adding each byte into the
+     * matching byte of out and letting the carry run on into the next
+     * addition.  Repetition r of the input is rotated right by 13*r bits,
+     * so its byte j starts at bit off = (8*j - 13*r) mod 8k of the input and
+     * is made of the tail of input byte off/8 and the head of the next one.
+     * Stepping j and r downward only moves off by whole bytes within a
+     * repetition, so no division is needed per byte.
+     */
+    o = 0;
+    for (reps = lcm / inbits; reps-- > 0;) {
+        rot = (13 * reps) % (inbits << 3);
+        off = ((inbits << 3) * 2 - 8 - rot) % (inbits << 3);
+        for (j = inbits; j-- > 0;) {
+            q = off >> 3;
+            sh = off & 7;
+            if (sh == 0) {
+                val = in[q];
+            } else {
+                val = ((in[q] << sh) |
+                       (in[(q + 1 == inbits) ? 0 : q + 1] >> (8 - sh))) & 0xff;
+            }
+            off = (off >= 8) ? off - 8 : off + (inbits << 3) - 8;
+
+            /* do the addition */
+            if (o == 0)
+                o = outbits;
+            o--;
+            byte += out[o] + val;
+            out[o] = byte & 0xff;
+
+            /* keep around the carry bit, if any */
+            byte >>= 8;
+        }
     }
 
     /* if there's a carry bit left over, add it back in */
     if (byte) {
-        for (i=outbits-1; i>=0; i--) {
+        for (o = outbits; o-- > 0;) {
             /* do the addition */
-            byte += out[i];
-            out[i] = byte&0xff;
+            byte += out[o];
+            out[o] = byte&0xff;
 
             /* keep around the carry bit, if any */
             byte >>= 8;
@@ -85,11 +85,108 @@ static gss_mech_info g_mechList = NULL;
 static gss_mech_info g_mechListTail = NULL;
 static k5_mutex_t g_mechListLock = K5_MUTEX_PARTIAL_INITIALIZER;
 static time_t g_confFileModTime = (time_t)0;
+static time_t g_confLastCheck = (time_t)0;
 
-static time_t g_mechSetTime = (time_t)0;
+/* Don't look at the config file more often than this (in seconds). */
+#define MECH_CONF_CHECK_INTERVAL 1
+
+/* Bumped (with g_mechListLock held) whenever g_mechList may have changed. */
+static unsigned long g_mechListGen = 1;
+
+static unsigned long g_mechSetGen = 0;
 static gss_OID_set_desc g_mechSet = { 0, NULL };
 static k5_mutex_t g_mechSetLock = K5_MUTEX_PARTIAL_INITIALIZER;
 
+#ifdef __ATOMIC_ACQUIRE
+/*
+ * Immutable tables of the loaded mechanisms, which let
+ * gssint_get_mechanism() and gssint_get_mechanism_ext() find a loaded
+ * mechanism without taking g_mechListLock.  A new table is published (with
+ * g_mechListLock held) each time a mechanism or its extensions are loaded.
+ * Readers may still be using a superseded table, so old tables are only
+ * freed when the library is finalized; each mechanism causes at most two.
+ */
+struct mech_snapshot_entry {
+	gss_OID mech_type;
+	gss_mechanism mech;
+	gss_mechanism_ext mech_ext;
+};
+
+struct mech_snapshot {
+	struct mech_snapshot *older;
+	size_t count;
+	struct mech_snapshot_entry entries[1];
+};
+
+static struct mech_snapshot *g_mechSnapshot = NULL;
+
+static struct mech_snapshot_entry *
+searchSnapshot(gss_const_OID oid)
+{
+	struct mech_snapshot *snap;
+	size_t i;
+
+	if (oid == GSS_C_NULL_OID)
+		return (NULL);
+	snap = __atomic_load_n(&g_mechSnapshot, __ATOMIC_ACQUIRE);
+	if (snap == NULL)
+		return (NULL);
+	for (i = 0; i < snap->count; i++) {
+		if (g_OID_equal(snap->entries[i].mech_type, oid))
+			return (&snap->entries[i]);
+	}
+	return (NULL);
+}
+
+/* Call with g_mechListLock held.  On failure, the old table stays valid. */
+static void
+publishSnapshot(void)
+{
+	struct mech_snapshot *snap;
+	gss_mech_info aMech;
+	size_t count = 0;
+
+	for (aMech = g_mechList; aMech != NULL; aMech = aMech->next) {
+		if (aMech->mech != NULL)
+			count++;
+	}
+	if (count == 0)
+		return;
+	snap = malloc(sizeof(*snap) + (count - 1) * sizeof(snap->entries[0]));
+	if (snap == NULL)
+		return;
+	snap->count = 0;
+	for (aMech = g_mechList; aMech != NULL; aMech = aMech->next) {
+		if (aMech->mech == NULL)
+			continue;
+		snap->entries[snap->count].mech_type = aMech->mech_type;
+		snap->entries[snap->count].mech = aMech->mech;
+		snap->entries[snap->count].mech_ext = aMech->mech_ext;
+		snap->count++;
+	}
+	snap->older = g_mechSnapshot;
+	__atomic_store_n(&g_mechSnapshot, snap, __ATOMIC_RELEASE);
+}
+
+static void
+freeSnapshots(void)
+{
+	struct mech_snapshot *snap, *older;
+
+	for (snap = g_mechSnapshot; snap != NULL; snap = older) {
+		older = snap->older;
+		free(snap);
+	}
+	g_mechSnapshot = NULL;
+}
+#else /* __ATOMIC_ACQUIRE */
+/* Without atomic pointer operations, all lookups take g_mechListLock. */
+#define searchSnapshot(oid) ((struct mech_snapshot_entry *)NULL)
+#define publishSnapshot()
+#define freeSnapshots()
+struct mech_snapshot_entry { gss_mechanism mech; gss_mechanism_ext mech_ext; };
+#endif /* __ATOMIC_ACQUIRE */
+
 MAKE_INIT_FUNCTION(gssint_mechglue_init);
 MAKE_FINI_FUNCTION(gssint_mechglue_fini);
 
@@ -136,6 +233,7 @@ gssint_mechglue_fini(void)
 	k5_mutex_destroy(&g_mechSetLock);
 	k5_mutex_destroy(&g_mechListLock);
 	free_mechSet();
+	freeSnapshots();
 	freeMechList();
 	remove_error_table(&et_ggss_error_table);
 	gssint_mecherrmap_destroy();
@@ -210,8 +308,6 @@ gss_indicate_mechs(minorStatus, mechSet_out)
 OM_uint32 *minorStatus;
 gss_OID_set *mechSet_out;
 {
-	char *fileName;
-	struct stat fileInfo;
 	OM_uint32 status;
 
 	/* Initialize outputs. */
@@ -230,16 +326,11 @@ gss_OID_set *mechSet_out;
 	if (*minorStatus != 0)
 		return (GSS_S_FAILURE);
 
-	fileName = MECH_CONF;
-
 	/*
 	 * If we have already computed the mechanisms supported and if it
 	 * is still valid; make a copy and return to caller,
 	 * otherwise build it first.
 	 */
-	if ((stat(fileName, &fileInfo) == 0 &&
-		fileInfo.st_mtime > g_mechSetTime)) {
-	} /* if g_mechSet is out of date or not initialized */
 	if (build_mechSet())
 		return GSS_S_FAILURE;
 
@@ -314,6 +405,13 @@ build_mechSet(void)
 	if (k5_mutex_lock(&g_mechSetLock) != 0)
 		return GSS_S_FAILURE;
 
+	/* nothing to do if the list hasn't changed since we last built it */
+	if (g_mechSetGen == g_mechListGen) {
+		(void) k5_mutex_unlock(&g_mechSetLock);
+		(void) k5_mutex_unlock(&g_mechListLock);
+		return GSS_S_COMPLETE;
+	}
+
 	/* if the oid list already exists we must free it first */
 	free_mechSet();
 
@@ -368,9 +466,7 @@ build_mechSet(void)
 		}
 	}
 
-#if 0
-	g_mechSetTime = fileInfo.st_mtime;
-#endif
+	g_mechSetGen = g_mechListGen;
 	(void) k5_mutex_unlock(&g_mechSetLock);
 	(void) k5_mutex_unlock(&g_mechListLock);
 
@@ -523,23 +619,36 @@ gssint_get_mechanisms(char *mechArray[], int arrayLen)
 
 /*
  * determines if the mechList needs to be updated from file
- * and performs the update.
+ * and performs the update.  The configuration is checked at most once
+ * every MECH_CONF_CHECK_INTERVAL seconds.
  * this functions must be called with a lock of g_mechListLock
  */
 static void
 updateMechList(void)
 {
+	time_t now;
+#if defined(_WIN32)
+	time_t lastConfModTime;
+#else
+	char *fileName;
+	struct stat fileInfo;
+#endif
+
+	now = time(NULL);
+	if (g_confLastCheck != 0 && now >= g_confLastCheck &&
+	    now - g_confLastCheck < MECH_CONF_CHECK_INTERVAL)
+		return;
+	g_confLastCheck = now;
+
 #if defined(_WIN32)
-	time_t lastConfModTime = getRegConfigModTime(MECH_KEY);
+	lastConfModTime = getRegConfigModTime(MECH_KEY);
 	if (g_confFileModTime < lastConfModTime) {
 		g_confFileModTime = lastConfModTime;
 		loadConfigFromRegistry(HKEY_CURRENT_USER, MECH_KEY);
 		loadConfigFromRegistry(HKEY_LOCAL_MACHINE, MECH_KEY);
+		g_mechListGen++;
 	}
 #else /* _WIN32 */
-	char *fileName;
-	struct stat fileInfo;
-
 	fileName = MECH_CONF;
 
 	/* check if mechList needs updating */
@@ -547,6 +656,7 @@ updateMechList(void)
 		(fileInfo.st_mtime > g_confFileModTime)) {
 		loadConfigFile(fileName);
 		g_confFileModTime = fileInfo.st_mtime;
+		g_mechListGen++;
 	}
 #if 0
 	init_hardcoded();
@@ -661,13 +771,16 @@ gssint_register_mechinfo(gss_mech_info template)
 			return ENOMEM;
 		}
 	}
+	g_mechListGen++;
 	if (g_mechList == NULL) {
 		g_mechList = new_cf;
 		g_mechListTail = new_cf;
+		publishSnapshot();
 		return 0;
 	} else if (new_cf->priority < g_mechList->priority) {
 		new_cf->next = g_mechList;
 		g_mechList = new_cf;
+		publishSnapshot();
 		return 0;
 	}
 
@@ -683,6 +796,7 @@ gssint_register_mechinfo(gss_mech_info template)
 		}
 	}
 
+	publishSnapshot();
 	return 0;
 }
 #endif /* _GSS_STATIC_LINK */
@@ -850,6 +964,7 @@ gss_mechanism
 gssint_get_mechanism(gss_const_OID oid)
 {
 	gss_mech_info aMech;
+	struct mech_snapshot_entry *snapEnt;
 	gss_mechanism (*sym)(const gss_OID);
 	struct plugin_file_handle *dl;
 	struct errinfo errinfo;
@@ -857,6 +972,11 @@ gssint_get_mechanism(gss_const_OID oid)
 	if (gssint_mechglue_initialize_library() != 0)
 		return (NULL);
 
+	/* check the published table of loaded mechanisms, without locking */
+	snapEnt = searchSnapshot(oid);
+	if (snapEnt != NULL)
+		return (snapEnt->mech);
+
 	if (k5_mutex_lock(&g_mechListLock) != 0)
 		return NULL;
 	/* check if the mechanism is already loaded */
@@ -917,6 +1037,7 @@ gssint_get_mechanism(gss_const_OID oid)
 	}
 
 	aMech->dl_handle = dl;
+	publishSnapshot();
 
 	(void) k5_mutex_unlock(&g_mechListLock);
 	return (aMech->mech);
@@ -927,10 +1048,16 @@ gssint_get_mechanism_ext(oid)
 const gss_OID oid;
 {
 	gss_mech_info aMech;
+	struct mech_snapshot_entry *snapEnt;
 
 	if (gssint_mechglue_initialize_library() != 0)
 		return (NULL);
 
+	/* check the published table of loaded mechanisms, without locking */
+	snapEnt = searchSnapshot(oid);
+	if (snapEnt != NULL && snapEnt->mech_ext != NULL)
+		return (snapEnt->mech_ext);
+
 	if (k5_mutex_lock(&g_mechListLock) != 0)
 		return NULL;
 	/* check if the mechanism is already loaded */
@@ -966,6 +1093,7 @@ const gss_OID oid;
 		(void) k5_mutex_unlock(&g_mechListLock);
 		return ((gss_mechanism_ext)NULL);
 	}
+	publishSnapshot();
 
 	(void) k5_mutex_unlock(&g_mechListLock);
 	return (aMech->mech_ext);
@@ -234,6 +234,28 @@ typedef struct _kadm5_policy_ent_t {
     krb5_tl_data    *tl_data;
 } kadm5_policy_ent_rec, *kadm5_policy_ent_t;
 
+/*
+ * Operation types for kadm5_batch_principals()
+ */
+#define KADM5_BATCH_CREATE      1       /* kadm5_create_principal_3 */
+#define KADM5_BATCH_MODIFY      2       /* kadm5_modify_principal */
+#define KADM5_BATCH_RANDKEY     3       /* kadm5_randkey_principal_3 */
+
+/*
+ * One operation in a batch.  rec.principal names the target of every
+ * operation type; the remaining fields are used as the corresponding
+ * single-principal call would use them.
+ */
+typedef struct _kadm5_batch_op_t {
+    int                 op;
+    kadm5_principal_ent_rec rec;
+    long                mask;           /* create, modify */
+    krb5_boolean        keepold;        /* randkey */
+    int                 n_ks_tuple;     /* create, randkey */
+    krb5_key_salt_tuple *ks_tuple;      /* create, randkey */
+    char                *pass;          /* create; NULL for a random key */
+} kadm5_batch_op_rec, *kadm5_batch_op_t;
+
 /*
  * Data structure returned by kadm5_get_config_params()
  */
@@ -542,6 +564,17 @@ kadm5_ret_t    kadm5_free_strings(void *server_handle,
                                   krb5_string_attr *strings,
                                   int count);
 
+/*
+ * Apply n_ops principal operations in order, storing the result of each in
+ * codes[i].  The server holds the database and update log locks across the
+ * whole batch and commits the update log once at the end.  A failed
+ * operation does not prevent later ones or undo earlier ones.  The return
+ * value reports failures which affect the batch as a whole.
+ */
+kadm5_ret_t    kadm5_batch_principals(void *server_handle,
+                                      kadm5_batch_op_t ops, int n_ops,
+                                      kadm5_ret_t *codes);
+
 KADM5INT_END_DECLS
 
 #endif /* __KADM5_ADMIN_H__ */
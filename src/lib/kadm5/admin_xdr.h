@@ -59,6 +59,9 @@ bool_t      xdr_purgekeys_arg(XDR *xdrs, purgekeys_arg *objp);
 bool_t      xdr_gstrings_arg(XDR *xdrs, gstrings_arg *objp);
 bool_t      xdr_gstrings_ret(XDR *xdrs, gstrings_ret *objp);
 bool_t      xdr_sstring_arg(XDR *xdrs, sstring_arg *objp);
+bool_t      xdr_kadm5_batch_op_rec(XDR *xdrs, kadm5_batch_op_rec *objp);
+bool_t      xdr_batch_arg(XDR *xdrs, batch_arg *objp);
+bool_t      xdr_batch_ret(XDR *xdrs, batch_ret *objp);
 bool_t	    xdr_krb5_principal(XDR *xdrs, krb5_principal *objp);
 bool_t	    xdr_krb5_octet(XDR *xdrs, krb5_octet *objp);
 bool_t	    xdr_krb5_int32(XDR *xdrs, krb5_int32 *objp);
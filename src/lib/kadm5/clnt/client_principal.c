@@ -530,3 +530,145 @@ kadm5_set_string(void *server_handle, krb5_principal principal,
         eret();
     return r->code;
 }
+
+/*
+ * Create op's principal with random keys on a server which cannot do that
+ * directly (pre-1.8), as kadmin's add_principal does: create it with a dummy
+ * password and tickets disallowed, then randomize its keys and restore its
+ * attributes.
+ */
+static kadm5_ret_t
+create_old_style_randkey(void *server_handle, kadm5_batch_op_t op)
+{
+    kadm5_principal_ent_rec rec;
+    kadm5_ret_t ret;
+    krb5_flags attributes;
+    char dummybuf[256];
+    size_t i;
+
+    /* Must try to pass any password policy in place, and be valid UTF-8. */
+    memcpy(dummybuf, "6F a[", 5);
+    for (i = 5; i < sizeof(dummybuf) - 1; i++)
+        dummybuf[i] = 'a' + (i % 26);
+    dummybuf[sizeof(dummybuf) - 1] = '\0';
+
+    rec = op->rec;
+    attributes = (op->mask & KADM5_ATTRIBUTES) ? rec.attributes : 0;
+    rec.attributes = attributes | KRB5_KDB_DISALLOW_ALL_TIX;
+    ret = kadm5_create_principal_3(server_handle, &rec,
+                                   op->mask | KADM5_ATTRIBUTES,
+                                   op->n_ks_tuple, op->ks_tuple, dummybuf);
+    if (ret)
+        return ret;
+    ret = kadm5_randkey_principal_3(server_handle, rec.principal, FALSE,
+                                    op->n_ks_tuple, op->ks_tuple, NULL, NULL);
+    if (ret)
+        return ret;
+    rec.attributes = attributes;
+    return kadm5_modify_principal(server_handle, &rec, KADM5_ATTRIBUTES);
+}
+
+/* Apply a batch one operation at a time, for servers without the batch
+ * RPC. */
+static kadm5_ret_t
+batch_singly(void *server_handle, kadm5_batch_op_t ops, int n_ops,
+             kadm5_ret_t *codes)
+{
+    kadm5_batch_op_t op;
+    int i;
+
+    for (i = 0; i < n_ops; i++) {
+        op = &ops[i];
+        switch (op->op) {
+        case KADM5_BATCH_CREATE:
+            codes[i] = kadm5_create_principal_3(server_handle, &op->rec,
+                                                op->mask, op->n_ks_tuple,
+                                                op->ks_tuple, op->pass);
+            if (codes[i] == EINVAL && op->pass == NULL)
+                codes[i] = create_old_style_randkey(server_handle, op);
+            break;
+        case KADM5_BATCH_MODIFY:
+            codes[i] = kadm5_modify_principal(server_handle, &op->rec,
+                                              op->mask);
+            break;
+        case KADM5_BATCH_RANDKEY:
+            codes[i] = kadm5_randkey_principal_3(server_handle,
+                                                 op->rec.principal,
+                                                 op->keepold, op->n_ks_tuple,
+                                                 op->ks_tuple, NULL, NULL);
+            break;
+        default:
+            codes[i] = EINVAL;
+        }
+        if (codes[i] == KADM5_RPC_ERROR)
+            return KADM5_RPC_ERROR;
+    }
+    return KADM5_OK;
+}
+
+kadm5_ret_t
+kadm5_batch_principals(void *server_handle, kadm5_batch_op_t ops, int n_ops,
+                       kadm5_ret_t *codes)
+{
+    batch_arg arg;
+    batch_ret *r;
+    kadm5_batch_op_rec *sent;
+    struct rpc_err err;
+    kadm5_ret_t ret;
+    int i;
+    kadm5_server_handle_t handle = server_handle;
+
+    CHECK_HANDLE(server_handle);
+    if (n_ops < 0 || (n_ops > 0 && (ops == NULL || codes == NULL)))
+        return EINVAL;
+    if (n_ops == 0)
+        return KADM5_OK;
+
+    /* Send only the entry fields selected by each operation's mask, as the
+     * single-principal calls do. */
+    sent = calloc(n_ops, sizeof(*sent));
+    if (sent == NULL)
+        return ENOMEM;
+    for (i = 0; i < n_ops; i++) {
+        if (ops[i].rec.principal == NULL) {
+            free(sent);
+            return EINVAL;
+        }
+        sent[i] = ops[i];
+        if (sent[i].op == KADM5_BATCH_RANDKEY)
+            sent[i].mask = 0;
+        sent[i].rec.mod_name = NULL;
+        if (!(sent[i].mask & KADM5_POLICY))
+            sent[i].rec.policy = NULL;
+        if (!(sent[i].mask & KADM5_KEY_DATA)) {
+            sent[i].rec.n_key_data = 0;
+            sent[i].rec.key_data = NULL;
+        }
+        if (!(sent[i].mask & KADM5_TL_DATA)) {
+            sent[i].rec.n_tl_data = 0;
+            sent[i].rec.tl_data = NULL;
+        }
+    }
+
+    arg.api_version = handle->api_version;
+    arg.ops = sent;
+    arg.n_ops = n_ops;
+    r = batch_principals_2(&arg, handle->clnt);
+    free(sent);
+    if (r == NULL) {
+        clnt_geterr(handle->clnt, &err);
+        if (err.re_status == RPC_PROCUNAVAIL)
+            return batch_singly(server_handle, ops, n_ops, codes);
+        eret();
+    }
+    ret = r->code;
+    if (ret == KADM5_OK) {
+        if (r->n_codes == n_ops)
+            memcpy(codes, r->codes, n_ops * sizeof(*codes));
+        else
+            ret = KADM5_RPC_ERROR;
+    }
+    free(r->codes);
+    r->codes = NULL;
+    return ret;
+}
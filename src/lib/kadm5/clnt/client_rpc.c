@@ -371,3 +371,18 @@ set_string_2(sstring_arg *argp, CLIENT *clnt)
      }
      return (&clnt_res);
 }
+
+batch_ret *
+batch_principals_2(batch_arg *argp, CLIENT *clnt)
+{
+     static batch_ret clnt_res;
+
+     memset(&clnt_res, 0, sizeof(clnt_res));
+     if (clnt_call(clnt, BATCH_PRINCIPALS,
+		   (xdrproc_t) xdr_batch_arg, (caddr_t) argp,
+		   (xdrproc_t) xdr_batch_ret, (caddr_t) &clnt_res,
+		   TIMEOUT) != RPC_SUCCESS) {
+	  return (NULL);
+     }
+     return (&clnt_res);
+}
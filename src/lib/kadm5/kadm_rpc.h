@@ -229,6 +229,21 @@ struct sstring_arg {
 };
 typedef struct sstring_arg sstring_arg;
 
+struct batch_arg {
+	krb5_ui_4 api_version;
+	kadm5_batch_op_rec *ops;
+	int n_ops;
+};
+typedef struct batch_arg batch_arg;
+
+struct batch_ret {
+	krb5_ui_4 api_version;
+	kadm5_ret_t code;
+	kadm5_ret_t *codes;
+	int n_codes;
+};
+typedef struct batch_ret batch_ret;
+
 #define KADM 2112
 #define KADMVERS 2
 #define CREATE_PRINCIPAL 1
@@ -303,6 +318,9 @@ extern  gstrings_ret * get_strings_2_svc(gstrings_arg *, struct svc_req *);
 #define SET_STRING 24
 extern  generic_ret * set_string_2(sstring_arg *, CLIENT *);
 extern  generic_ret * set_string_2_svc(sstring_arg *, struct svc_req *);
+#define BATCH_PRINCIPALS 25
+extern  batch_ret * batch_principals_2(batch_arg *, CLIENT *);
+extern  batch_ret * batch_principals_2_svc(batch_arg *, struct svc_req *);
 
 extern bool_t xdr_cprinc_arg ();
 extern bool_t xdr_cprinc3_arg ();
@@ -343,6 +361,8 @@ extern bool_t xdr_purgekeys_arg ();
 extern bool_t xdr_gstrings_arg ();
 extern bool_t xdr_gstrings_ret ();
 extern bool_t xdr_sstring_arg ();
+extern bool_t xdr_batch_arg ();
+extern bool_t xdr_batch_ret ();
 extern bool_t xdr_krb5_string_attr ();
 
 
@@ -1055,6 +1055,68 @@ xdr_sstring_arg(XDR *xdrs, sstring_arg *objp)
 	return (TRUE);
 }
 
+bool_t
+xdr_kadm5_batch_op_rec(XDR *xdrs, kadm5_batch_op_rec *objp)
+{
+	if (!xdr_int(xdrs, &objp->op)) {
+		return (FALSE);
+	}
+	if (!_xdr_kadm5_principal_ent_rec(xdrs, &objp->rec,
+					  KADM5_API_VERSION_3)) {
+		return (FALSE);
+	}
+	if (!xdr_long(xdrs, &objp->mask)) {
+		return (FALSE);
+	}
+	if (!xdr_krb5_boolean(xdrs, &objp->keepold)) {
+		return (FALSE);
+	}
+	if (!xdr_array(xdrs, (caddr_t *)&objp->ks_tuple,
+		       (unsigned int *)&objp->n_ks_tuple, ~0,
+		       sizeof(krb5_key_salt_tuple),
+		       xdr_krb5_key_salt_tuple)) {
+		return (FALSE);
+	}
+	if (!xdr_nullstring(xdrs, &objp->pass)) {
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+bool_t
+xdr_batch_arg(XDR *xdrs, batch_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return (FALSE);
+	}
+	if (!xdr_array(xdrs, (caddr_t *)&objp->ops,
+		       (unsigned int *)&objp->n_ops, ~0,
+		       sizeof(kadm5_batch_op_rec),
+		       xdr_kadm5_batch_op_rec)) {
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+bool_t
+xdr_batch_ret(XDR *xdrs, batch_ret *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return (FALSE);
+	}
+	if (!xdr_kadm5_ret_t(xdrs, &objp->code)) {
+		return (FALSE);
+	}
+	if (objp->code == KADM5_OK) {
+		if (!xdr_array(xdrs, (caddr_t *)&objp->codes,
+			       (unsigned int *)&objp->n_codes, ~0,
+			       sizeof(kadm5_ret_t), xdr_kadm5_ret_t)) {
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
 bool_t
 xdr_krb5_principal(XDR *xdrs, krb5_principal *objp)
 {
@@ -41,6 +41,7 @@
 #include <stdarg.h>
 
 #define KRB5_KLOG_MAX_ERRMSG_SIZE       2048
+#define KRB5_KLOG_BUFSIZ                65536
 #ifndef MAXHOSTNAMELEN
 #define MAXHOSTNAMELEN  256
 #endif  /* MAXHOSTNAMELEN */
@@ -139,6 +140,8 @@ struct log_control {
     char                *log_whoami;
     char                *log_hostname;
     krb5_boolean        log_opened;
+    int                 log_flush_interval;
+    time_t              log_last_flush;
 };
 
 static struct log_control log_control = {
@@ -146,6 +149,8 @@ static struct log_control log_control = {
     0,
     (char *) NULL,
     (char *) NULL,
+    0,
+    0,
     0
 };
 static struct log_entry def_log_entry;
@@ -168,6 +173,52 @@ static struct log_entry def_log_entry;
  */
 static krb5_context err_context;
 
+/*
+ * Prepare a newly opened log file.  If log_flush_interval is set, give it a
+ * large buffer so that records are written in batches by klog_flush_files()
+ * rather than one write per record.
+ */
+static void
+klog_setup_file(FILE *f)
+{
+    set_cloexec_file(f);
+    if (log_control.log_flush_interval > 0)
+        (void) setvbuf(f, NULL, _IOFBF, KRB5_KLOG_BUFSIZ);
+}
+
+/*
+ * Flush file and standard error destinations.  Unless force is set, do
+ * nothing if log_flush_interval is set and that many seconds have not passed
+ * since the last flush, so that a busy server doesn't pay for a write(2) on
+ * every record.
+ */
+static void
+klog_flush_files(krb5_boolean force)
+{
+    int lindex;
+    time_t now;
+    FILE *f;
+
+    if (log_control.log_flush_interval > 0) {
+        now = time(NULL);
+        if (!force &&
+            now - log_control.log_last_flush < log_control.log_flush_interval)
+            return;
+        log_control.log_last_flush = now;
+    }
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        if (log_control.log_entries[lindex].log_type != K_LOG_FILE &&
+            log_control.log_entries[lindex].log_type != K_LOG_STDERR)
+            continue;
+        f = log_control.log_entries[lindex].lfu_filep;
+        if (fflush(f) == EOF) {
+            /* Attempt to report error */
+            fprintf(stderr, log_file_err, log_control.log_whoami,
+                    log_control.log_entries[lindex].lfu_fname);
+        }
+    }
+}
+
 static void
 klog_com_err_proc(const char *whoami, long int code, const char *format, va_list ap)
 #if !defined(__cplusplus) && (__GNUC__ > 2)
@@ -286,9 +337,6 @@ klog_com_err_proc(const char *whoami, long int code, const char *format, va_list
                 fprintf(stderr, log_file_err, whoami,
                         log_control.log_entries[lindex].lfu_fname);
             }
-            else {
-                fflush(log_control.log_entries[lindex].lfu_filep);
-            }
             break;
         case K_LOG_CONSOLE:
         case K_LOG_DEVICE:
@@ -325,6 +373,7 @@ klog_com_err_proc(const char *whoami, long int code, const char *format, va_list
             break;
         }
     }
+    klog_flush_files(FALSE);
 }
 
 /*
@@ -380,6 +429,18 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
     logging_specs = (char **) NULL;
     ngood = 0;
     log_control.log_nentries = 0;
+
+    /*
+     * Look up [logging]->log_flush_interval, which allows output to log
+     * files to be buffered for up to that many seconds.
+     */
+    if (profile_get_integer(kcontext->profile, KRB5_CONF_LOGGING,
+                            KRB5_CONF_LOG_FLUSH_INTERVAL, NULL, 0,
+                            &log_control.log_flush_interval) ||
+        log_control.log_flush_interval < 0)
+        log_control.log_flush_interval = 0;
+    log_control.log_last_flush = time(NULL);
+
     if (!profile_get_values(kcontext->profile,
                             logging_profent,
                             &logging_specs) ||
@@ -425,7 +486,7 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
                     if (cp[4] == ':' || cp[4] == '=') {
                         f = fopen(&cp[5], (cp[4] == ':') ? "a" : "w");
                         if (f) {
-                            set_cloexec_file(f);
+                            klog_setup_file(f);
                             log_control.log_entries[i].lfu_filep = f;
                             log_control.log_entries[i].log_type = K_LOG_FILE;
                             log_control.log_entries[i].lfu_fname = &cp[5];
@@ -890,9 +951,6 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
                 fprintf(stderr, log_file_err, log_control.log_whoami,
                         log_control.log_entries[lindex].lfu_fname);
             }
-            else {
-                fflush(log_control.log_entries[lindex].lfu_filep);
-            }
             break;
         case K_LOG_CONSOLE:
         case K_LOG_DEVICE:
@@ -920,6 +978,7 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
             break;
         }
     }
+    klog_flush_files(FALSE);
     return(0);
 }
 
@@ -935,6 +994,17 @@ krb5_klog_syslog(int priority, const char *format, ...)
     return(retval);
 }
 
+/*
+ * krb5_klog_flush()    - Write out any buffered log records.  Callers should
+ *                        use this before forking so that buffered records
+ *                        are not duplicated in the child.
+ */
+void
+krb5_klog_flush(krb5_context kcontext)
+{
+    klog_flush_files(TRUE);
+}
+
 /*
  * krb5_klog_reopen() - Close and reopen any open (non-syslog) log files.
  *                      This function is called when a SIGHUP is received
@@ -961,7 +1031,7 @@ krb5_klog_reopen(krb5_context kcontext)
              */
             f = fopen(log_control.log_entries[lindex].lfu_fname, "a+");
             if (f) {
-                set_cloexec_file(f);
+                klog_setup_file(f);
                 log_control.log_entries[lindex].lfu_filep = f;
             } else {
                 fprintf(stderr, _("Couldn't open log file %s: %s\n"),
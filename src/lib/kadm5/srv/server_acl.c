@@ -53,8 +53,18 @@ typedef struct _acl_entry {
     /* eg: "-maxlife 3h -service +proxiable" */
     krb5_boolean        ae_restriction_bad;
     restriction_t       *ae_restrictions;
+    int                 ae_index;       /* position in the ACL file */
+    struct _acl_entry   *ae_chain;      /* next entry in same index chain */
 } aent_t;
 
+/* A remembered result of kadm5int_acl_find_entry(). */
+typedef struct _acl_cache_entry {
+    struct _acl_cache_entry     *ac_next;
+    krb5_principal              ac_caller;
+    krb5_principal              ac_target;
+    aent_t                      *ac_entry;
+} acache_t;
+
 static const aop_t acl_op_table[] = {
     { 'a',      ACL_ADD },
     { 'd',      ACL_DELETE },
@@ -77,6 +87,27 @@ typedef struct _wildstate {
 static aent_t   *acl_list_head = (aent_t *) NULL;
 static aent_t   *acl_list_tail = (aent_t *) NULL;
 
+/*
+ * Index of the loaded entries.  Entries naming a single caller principal are
+ * chained in hash buckets keyed by that principal; entries with a wildcard
+ * in the caller name are chained on acl_wild_head.  Both chains are in file
+ * order, so a lookup merges the caller's bucket with the wildcard chain by
+ * ae_index to find the first matching entry without walking the whole list.
+ */
+static aent_t   **acl_index = NULL;
+static unsigned int acl_index_size = 0;
+static aent_t   *acl_wild_head = NULL;
+
+/*
+ * Results of kadm5int_acl_find_entry() for recently seen caller and target
+ * pairs.  The results depend only on the loaded ACL, so the cache is only
+ * discarded when the ACL is, or when it grows too large.
+ */
+#define ACL_CACHE_BUCKETS       1024
+#define ACL_CACHE_MAX           8192
+static acache_t *acl_cache[ACL_CACHE_BUCKETS];
+static int      acl_cache_count = 0;
+
 static const char *acl_acl_file = (char *) NULL;
 static int acl_inited = 0;
 static int acl_debug_level = 0;
@@ -440,6 +471,126 @@ kadm5int_acl_impose_restrictions(kcontext, recp, maskp, rp)
     return 0;
 }
 
+/*
+ * kadm5int_acl_hash_princ()    - Hash a principal's realm and components.
+ */
+static unsigned int
+kadm5int_acl_hash_princ(princ, h)
+    krb5_const_principal        princ;
+    unsigned int                h;
+{
+    const krb5_data     *d;
+    unsigned int        j;
+    int                 i;
+
+    /* FNV-1a, with a separator byte after each component. */
+    for (i = -1; i < princ->length; i++) {
+        d = (i < 0) ? &princ->realm : &princ->data[i];
+        for (j = 0; j < d->length; j++)
+            h = (h ^ (unsigned char)d->data[j]) * 16777619U;
+        h = (h ^ 0xff) * 16777619U;
+    }
+    return h;
+}
+
+/*
+ * kadm5int_acl_cache_flush()   - Discard all cached lookup results.
+ */
+static void
+kadm5int_acl_cache_flush()
+{
+    acache_t    *cp, *np;
+    int         i;
+
+    for (i = 0; i < ACL_CACHE_BUCKETS; i++) {
+        for (cp = acl_cache[i]; cp; cp = np) {
+            np = cp->ac_next;
+            krb5_free_principal((krb5_context) NULL, cp->ac_caller);
+            krb5_free_principal((krb5_context) NULL, cp->ac_target);
+            free(cp);
+        }
+        acl_cache[i] = (acache_t *) NULL;
+    }
+    acl_cache_count = 0;
+}
+
+/*
+ * kadm5int_acl_cache_hash()    - Hash a caller and (possibly null) target.
+ */
+static unsigned int
+kadm5int_acl_cache_hash(caller, target)
+    krb5_const_principal        caller;
+    krb5_const_principal        target;
+{
+    unsigned int        h;
+
+    h = kadm5int_acl_hash_princ(caller, 2166136261U);
+    if (target)
+        h = kadm5int_acl_hash_princ(target, h);
+    return h % ACL_CACHE_BUCKETS;
+}
+
+/*
+ * kadm5int_acl_cache_lookup()  - Find a cached lookup result.
+ *
+ * Returns 1 and sets *entryp (possibly to NULL) if the result is cached.
+ */
+static int
+kadm5int_acl_cache_lookup(kcontext, caller, target, entryp)
+    krb5_context                kcontext;
+    krb5_const_principal        caller;
+    krb5_const_principal        target;
+    aent_t                      **entryp;
+{
+    acache_t    *cp;
+
+    cp = acl_cache[kadm5int_acl_cache_hash(caller, target)];
+    for (; cp; cp = cp->ac_next) {
+        if (!krb5_principal_compare(kcontext, cp->ac_caller, caller))
+            continue;
+        if (target == NULL ? cp->ac_target != NULL :
+            (cp->ac_target == NULL ||
+             !krb5_principal_compare(kcontext, cp->ac_target, target)))
+            continue;
+        *entryp = cp->ac_entry;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * kadm5int_acl_cache_add()     - Remember a lookup result.  Failures are
+ *                                ignored; the result just isn't cached.
+ */
+static void
+kadm5int_acl_cache_add(kcontext, caller, target, entry)
+    krb5_context                kcontext;
+    krb5_const_principal        caller;
+    krb5_const_principal        target;
+    aent_t                      *entry;
+{
+    acache_t            *cp;
+    unsigned int        h;
+
+    if (acl_cache_count >= ACL_CACHE_MAX)
+        kadm5int_acl_cache_flush();
+    cp = (acache_t *) calloc(1, sizeof(acache_t));
+    if (cp == NULL)
+        return;
+    if (krb5_copy_principal(kcontext, caller, &cp->ac_caller) ||
+        (target &&
+         krb5_copy_principal(kcontext, target, &cp->ac_target))) {
+        krb5_free_principal(kcontext, cp->ac_caller);
+        free(cp);
+        return;
+    }
+    cp->ac_entry = entry;
+    h = kadm5int_acl_cache_hash(caller, target);
+    cp->ac_next = acl_cache[h];
+    acl_cache[h] = cp;
+    acl_cache_count++;
+}
+
 /*
  * kadm5int_acl_free_entries() - Free all ACL entries.
  */
@@ -470,15 +621,118 @@ kadm5int_acl_free_entries()
         free(ap);
     }
     acl_list_head = acl_list_tail = (aent_t *) NULL;
+    free(acl_index);
+    acl_index = NULL;
+    acl_index_size = 0;
+    acl_wild_head = NULL;
+    kadm5int_acl_cache_flush();
     acl_inited = 0;
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_free_entries()\n"));
 }
 
+/*
+ * kadm5int_acl_wild_data()     - Would this ACL name component match more
+ *                                than one value?  (See
+ *                                kadm5int_acl_match_data().)
+ */
+static krb5_boolean
+kadm5int_acl_wild_data(d)
+    const krb5_data     *d;
+{
+    return (d->length == 0 || (d->length == 1 && d->data[0] == '*'));
+}
+
+/*
+ * kadm5int_acl_compile_entries() - Parse the names, targets and restrictions
+ *                                  of all entries and build the index used
+ *                                  by kadm5int_acl_find_entry().
+ *
+ * Entries with unparseable fields are marked bad here rather than when they
+ * are first matched; such entries never match either way.
+ */
+static int
+kadm5int_acl_compile_entries(kcontext)
+    krb5_context        kcontext;
+{
+    aent_t              *entry, **tails, **tailp;
+    krb5_boolean        wild;
+    unsigned int        n, size;
+    int                 i;
+
+    n = 0;
+    for (entry = acl_list_head; entry; entry = entry->ae_next)
+        n++;
+    for (size = 16; size < n; size *= 2);
+    acl_index = (aent_t **) calloc(size, sizeof(aent_t *));
+    tails = (aent_t **) calloc(size, sizeof(aent_t *));
+    if (acl_index == NULL || tails == NULL) {
+        free(tails);
+        return 0;
+    }
+    acl_index_size = size;
+
+    n = 0;
+    tailp = &acl_wild_head;
+    for (entry = acl_list_head; entry; entry = entry->ae_next) {
+        entry->ae_index = n++;
+        entry->ae_chain = (aent_t *) NULL;
+
+        wild = !strcmp(entry->ae_name, "*");
+        if (!wild && krb5_parse_name(kcontext, entry->ae_name,
+                                     &entry->ae_principal)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad ACL entry %s\n", entry->ae_name));
+            entry->ae_name_bad = 1;
+            continue;
+        }
+        if (entry->ae_target && strcmp(entry->ae_target, "*") &&
+            krb5_parse_name(kcontext, entry->ae_target,
+                            &entry->ae_target_princ)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad target in ACL entry for %s\n", entry->ae_name));
+            entry->ae_target_bad = 1;
+            entry->ae_name_bad = 1;
+            continue;
+        }
+        if (entry->ae_restriction_string &&
+            kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
+                                            &entry->ae_restrictions)) {
+            DPRINT(DEBUG_ACL, acl_debug_level,
+                   ("Bad restrictions in ACL entry for %s\n",
+                    entry->ae_name));
+            entry->ae_restriction_bad = 1;
+            entry->ae_name_bad = 1;
+            continue;
+        }
+
+        if (!wild) {
+            wild = kadm5int_acl_wild_data(&entry->ae_principal->realm);
+            for (i = 0; !wild && i < entry->ae_principal->length; i++)
+                wild = kadm5int_acl_wild_data(&entry->ae_principal->data[i]);
+        }
+        if (wild) {
+            *tailp = entry;
+            tailp = &entry->ae_chain;
+        } else {
+            i = kadm5int_acl_hash_princ(entry->ae_principal, 2166136261U) &
+                (size - 1);
+            if (tails[i])
+                tails[i]->ae_chain = entry;
+            else
+                acl_index[i] = entry;
+            tails[i] = entry;
+        }
+    }
+    free(tails);
+    return 1;
+}
+
 /*
  * kadm5int_acl_load_acl_file() - Open and parse the ACL file.
  */
 static int
-kadm5int_acl_load_acl_file()
+kadm5int_acl_load_acl_file(kcontext)
+    krb5_context        kcontext;
 {
     FILE        *afp;
     char        *alinep;
@@ -539,6 +793,8 @@ kadm5int_acl_load_acl_file()
         }
     }
 
+    if (retval)
+        retval = kadm5int_acl_compile_entries(kcontext);
     if (!retval) {
         kadm5int_acl_free_entries();
     }
@@ -596,113 +852,99 @@ kadm5int_acl_match_data(e1, e2, targetflag, ws)
 }
 
 /*
- * kadm5int_acl_find_entry()    - Find a matching entry.
+ * kadm5int_acl_match_entry()   - Does this entry apply to this caller and
+ *                                target?
  */
-static aent_t *
-kadm5int_acl_find_entry(kcontext, principal, dest_princ)
-    krb5_context        kcontext;
+static krb5_boolean
+kadm5int_acl_match_entry(entry, principal, dest_princ)
+    aent_t              *entry;
     krb5_principal      principal;
     krb5_principal      dest_princ;
 {
-    aent_t              *entry;
-    krb5_error_code     kret;
     int                 i;
-    int                 matchgood;
     wildstate_t         state;
 
-    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
     memset(&state, 0, sizeof state);
-    for (entry=acl_list_head; entry; entry = entry->ae_next) {
-        if (entry->ae_name_bad)
-            continue;
-        if (!strcmp(entry->ae_name, "*")) {
-            DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
-            matchgood = 1;
-        }
-        else {
-            if (!entry->ae_principal && !entry->ae_name_bad) {
-                kret = krb5_parse_name(kcontext,
-                                       entry->ae_name,
-                                       &entry->ae_principal);
-                if (kret)
-                    entry->ae_name_bad = 1;
-            }
-            if (entry->ae_name_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad ACL entry %s\n", entry->ae_name));
-                continue;
-            }
-            matchgood = 0;
-            if (kadm5int_acl_match_data(&entry->ae_principal->realm,
-                                        &principal->realm, 0, (wildstate_t *)0) &&
-                (entry->ae_principal->length == principal->length)) {
-                matchgood = 1;
-                for (i=0; i<principal->length; i++) {
-                    if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
-                                                 &principal->data[i], 0, &state)) {
-                        matchgood = 0;
-                        break;
-                    }
-                }
-            }
+    if (entry->ae_name_bad)
+        return 0;
+    if (!strcmp(entry->ae_name, "*")) {
+        DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
+    } else {
+        if (!kadm5int_acl_match_data(&entry->ae_principal->realm,
+                                     &principal->realm, 0, (wildstate_t *)0) ||
+            (entry->ae_principal->length != principal->length))
+            return 0;
+        for (i=0; i<principal->length; i++) {
+            if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
+                                         &principal->data[i], 0, &state))
+                return 0;
         }
-        if (!matchgood)
-            continue;
+    }
 
-        /* We've matched the principal.  If we have a target, then try it */
-        if (entry->ae_target && strcmp(entry->ae_target, "*")) {
-            if (!entry->ae_target_princ && !entry->ae_target_bad) {
-                kret = krb5_parse_name(kcontext, entry->ae_target,
-                                       &entry->ae_target_princ);
-                if (kret)
-                    entry->ae_target_bad = 1;
-            }
-            if (entry->ae_target_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad target in ACL entry for %s\n", entry->ae_name));
-                entry->ae_name_bad = 1;
-                continue;
-            }
-            if (!dest_princ)
-                matchgood = 0;
-            else if (entry->ae_target_princ && dest_princ) {
-                if (kadm5int_acl_match_data(&entry->ae_target_princ->realm,
-                                            &dest_princ->realm, 1, (wildstate_t *)0) &&
-                    (entry->ae_target_princ->length == dest_princ->length)) {
-                    for (i=0; i<dest_princ->length; i++) {
-                        if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
-                                                     &dest_princ->data[i], 1, &state)) {
-                            matchgood = 0;
-                            break;
-                        }
-                    }
-                }
-                else
-                    matchgood = 0;
-            }
+    /* We've matched the principal.  If we have a target, then try it */
+    if (entry->ae_target_princ) {
+        if (!dest_princ)
+            return 0;
+        if (!kadm5int_acl_match_data(&entry->ae_target_princ->realm,
+                                     &dest_princ->realm, 1, (wildstate_t *)0) ||
+            (entry->ae_target_princ->length != dest_princ->length))
+            return 0;
+        for (i=0; i<dest_princ->length; i++) {
+            if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
+                                         &dest_princ->data[i], 1, &state))
+                return 0;
         }
-        if (!matchgood)
-            continue;
+    }
+    return 1;
+}
 
-        if (entry->ae_restriction_string
-            && !entry->ae_restriction_bad
-            && !entry->ae_restrictions
-            && kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
-                                               &entry->ae_restrictions)) {
-            DPRINT(DEBUG_ACL, acl_debug_level,
-                   ("Bad restrictions in ACL entry for %s\n", entry->ae_name));
-            entry->ae_restriction_bad = 1;
-        }
-        if (entry->ae_restriction_bad) {
-            entry->ae_name_bad = 1;
-            continue;
+/*
+ * kadm5int_acl_find_entry()    - Find the first matching entry.
+ */
+static aent_t *
+kadm5int_acl_find_entry(kcontext, principal, dest_princ)
+    krb5_context        kcontext;
+    krb5_principal      principal;
+    krb5_principal      dest_princ;
+{
+    aent_t              *entry, *exact, *wild;
+    unsigned int        h;
+
+    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
+    if (kadm5int_acl_cache_lookup(kcontext, principal, dest_princ, &entry))
+        goto done;
+
+    exact = (aent_t *) NULL;
+    if (acl_index) {
+        h = kadm5int_acl_hash_princ(principal, 2166136261U);
+        exact = acl_index[h & (acl_index_size - 1)];
+    }
+    wild = acl_wild_head;
+    for (;;) {
+        /* Skip entries for other callers which share the hash bucket. */
+        while (exact && !krb5_principal_compare(kcontext, exact->ae_principal,
+                                                principal))
+            exact = exact->ae_chain;
+        if (exact && (!wild || exact->ae_index < wild->ae_index)) {
+            entry = exact;
+            exact = exact->ae_chain;
+        } else if (wild) {
+            entry = wild;
+            wild = wild->ae_chain;
+        } else {
+            entry = (aent_t *) NULL;
+            break;
         }
-        break;
+        if (kadm5int_acl_match_entry(entry, principal, dest_princ))
+            break;
     }
+    kadm5int_acl_cache_add(kcontext, principal, dest_princ, entry);
+
+done:
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_find_entry()=%x\n",entry));
     return(entry);
 }
-
+
 /*
  * kadm5int_acl_init()  - Initialize ACL context.
  */
@@ -720,7 +962,7 @@ kadm5int_acl_init(kcontext, debug_level, acl_file)
            ("* kadm5int_acl_init(afile=%s)\n",
             ((acl_file) ? acl_file : "(null)")));
     acl_acl_file = (acl_file) ? acl_file : (char *) KRB5_DEFAULT_ADMIN_ACL;
-    acl_inited = kadm5int_acl_load_acl_file();
+    acl_inited = kadm5int_acl_load_acl_file(kcontext);
 
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_init() = %d\n", kret));
     return(kret);
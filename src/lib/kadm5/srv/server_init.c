@@ -22,6 +22,9 @@
 #include "osconf.h"
 #include "iprop_hdr.h"
 
+extern krb5_principal master_princ;
+extern krb5_keyblock master_keyblock;
+
 /*
  * Function check_handle
  *
@@ -391,9 +394,13 @@ kadm5_ret_t kadm5_flush(void *server_handle)
 
     CHECK_HANDLE(server_handle);
 
+    /* Closing the database discards the master key list, so reload it with
+     * the master key fetched at initialization. */
     if ((ret = krb5_db_fini(handle->context)) ||
         (ret = krb5_db_open(handle->context, handle->db_args,
                             KRB5_KDB_OPEN_RW | KRB5_KDB_SRV_TYPE_ADMIN)) ||
+        (ret = krb5_db_fetch_mkey_list(handle->context, master_princ,
+                                       &master_keyblock)) ||
         (ret = adb_policy_close(handle)) ||
         (ret = adb_policy_init(handle))) {
         (void) kadm5_destroy(server_handle);
@@ -8,6 +8,7 @@
 #include        <sys/time.h>
 #include        <kadm5/admin.h>
 #include        <kdb.h>
+#include        <kdb_log.h>
 #include        "server_internal.h"
 #ifdef USE_PASSWORD_SERVER
 #include        <sys/wait.h>
@@ -2511,3 +2512,59 @@ done:
     kdb_free_entry(handle, kdb, &adb);
     return ret;
 }
+
+kadm5_ret_t
+kadm5_batch_principals(void *server_handle, kadm5_batch_op_t ops, int n_ops,
+                       kadm5_ret_t *codes)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_batch_op_t op;
+    kadm5_ret_t ret;
+    int i, db_locked = 0;
+
+    CHECK_HANDLE(server_handle);
+    if (n_ops < 0 || (n_ops > 0 && (ops == NULL || codes == NULL)))
+        return EINVAL;
+
+    /* Take the update log lock before the database lock, in the same order
+     * as krb5_db_put_principal(), and hold both for the whole batch. */
+    ret = ulog_begin_batch(handle->context);
+    if (ret)
+        return ret;
+    ret = krb5_db_lock(handle->context, KRB5_DB_LOCKMODE_EXCLUSIVE);
+    if (ret == 0)
+        db_locked = 1;
+    else if (ret != KRB5_PLUGIN_OP_NOTSUPP)
+        goto cleanup;
+
+    for (i = 0; i < n_ops; i++) {
+        op = &ops[i];
+        switch (op->op) {
+        case KADM5_BATCH_CREATE:
+            codes[i] = kadm5_create_principal_3(handle, &op->rec, op->mask,
+                                                op->n_ks_tuple, op->ks_tuple,
+                                                op->pass);
+            break;
+        case KADM5_BATCH_MODIFY:
+            codes[i] = kadm5_modify_principal(handle, &op->rec, op->mask);
+            break;
+        case KADM5_BATCH_RANDKEY:
+            codes[i] = kadm5_randkey_principal_3(handle, op->rec.principal,
+                                                 op->keepold, op->n_ks_tuple,
+                                                 op->ks_tuple, NULL, NULL);
+            break;
+        default:
+            codes[i] = EINVAL;
+        }
+    }
+    ret = KADM5_OK;
+
+cleanup:
+    if (db_locked)
+        (void) krb5_db_unlock(handle->context);
+    if (ret)
+        (void) ulog_end_batch(handle->context);
+    else
+        ret = ulog_end_batch(handle->context);
+    return ret;
+}
@@ -289,6 +289,19 @@ kdb_setup_opt_functions(db_library lib)
         lib->vftabl.encrypt_key_data = krb5_dbe_def_encrypt_key_data;
 }
 
+/* Copy a module's vtable into lib, leaving methods added after the module's
+ * minor version as NULL. */
+static void
+copy_vtable(db_library lib, const kdb_vftabl *vftabl)
+{
+    size_t size = sizeof(kdb_vftabl);
+
+    if (vftabl->min_ver < 1)
+        size = offsetof(kdb_vftabl, sign_authdata_async);
+    memset(&lib->vftabl, 0, sizeof(kdb_vftabl));
+    memcpy(&lib->vftabl, vftabl, size);
+}
+
 #ifdef STATIC_PLUGINS
 
 extern kdb_vftabl krb5_db2_kdb_function_table;
@@ -321,7 +334,7 @@ kdb_load_library(krb5_context kcontext, char *lib_name, db_library *libptr)
         return ENOMEM;
 
     strlcpy(lib->name, lib_name, sizeof(lib->name));
-    memcpy(&lib->vftabl, vftabl_addr, sizeof(kdb_vftabl));
+    copy_vtable(lib, vftabl_addr);
     kdb_setup_opt_functions(lib);
 
     status = lib->vftabl.init_library();
@@ -427,7 +440,7 @@ kdb_load_library(krb5_context kcontext, char *lib_name, db_library *lib)
         goto clean_n_exit;
     }
 
-    memcpy(&(*lib)->vftabl, vftabl_addrs[0], sizeof(kdb_vftabl));
+    copy_vtable(*lib, vftabl_addrs[0]);
     kdb_setup_opt_functions(*lib);
 
     if ((status = (*lib)->vftabl.init_library()))
@@ -2523,6 +2536,43 @@ krb5_db_sign_authdata(krb5_context kcontext, unsigned int flags,
                             signed_auth_data);
 }
 
+void
+krb5_db_sign_authdata_async(krb5_context kcontext, struct verto_ctx *vctx,
+                            unsigned int flags,
+                            krb5_const_principal client_princ,
+                            krb5_db_entry *client, krb5_db_entry *server,
+                            krb5_db_entry *krbtgt, krb5_keyblock *client_key,
+                            krb5_keyblock *server_key,
+                            krb5_keyblock *krbtgt_key,
+                            krb5_keyblock *session_key,
+                            krb5_timestamp authtime,
+                            krb5_authdata **tgt_auth_data,
+                            krb5_db_sign_authdata_respond_fn respond,
+                            void *arg)
+{
+    krb5_error_code status;
+    kdb_vftabl *v;
+    krb5_authdata **signed_auth_data = NULL;
+
+    status = get_vftabl(kcontext, &v);
+    if (status == 0 && v->sign_authdata_async != NULL) {
+        v->sign_authdata_async(kcontext, vctx, flags, client_princ, client,
+                               server, krbtgt, client_key, server_key,
+                               krbtgt_key, session_key, authtime,
+                               tgt_auth_data, respond, arg);
+        return;
+    }
+
+    /* Fall back to the synchronous method. */
+    if (status == 0) {
+        status = krb5_db_sign_authdata(kcontext, flags, client_princ, client,
+                                       server, krbtgt, client_key, server_key,
+                                       krbtgt_key, session_key, authtime,
+                                       tgt_auth_data, &signed_auth_data);
+    }
+    (*respond)(arg, status, signed_auth_data);
+}
+
 krb5_error_code
 krb5_db_check_transited_realms(krb5_context kcontext,
                                const krb5_data *tr_contents,
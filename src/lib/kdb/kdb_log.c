@@ -54,10 +54,60 @@ ulog_lock(krb5_context ctx, int mode)
         return KRB5_LOG_ERROR;
     if (ctx->kdblog_context == NULL || ctx->kdblog_context->iproprole == IPROP_NULL)
         return 0;
+    /* The lock is held from ulog_begin_batch() until ulog_end_batch(). */
+    if (ctx->kdblog_context->ulogbatch)
+        return 0;
     INIT_ULOG(ctx);
     return krb5_lock_file(ctx, log_ctx->ulogfd, mode);
 }
 
+/*
+ * Begin a group of updates.  The ulog lock is held until ulog_end_batch(), so
+ * that callers' own lock and unlock calls have no effect in between, and
+ * syncing updates to disk is deferred so that the whole group is committed
+ * with one msync.  Updates are still written to the shared mapping as they
+ * are made, so other processes see them immediately.
+ */
+krb5_error_code
+ulog_begin_batch(krb5_context ctx)
+{
+    krb5_error_code retval;
+
+    if (ctx->kdblog_context == NULL ||
+        ctx->kdblog_context->iproprole == IPROP_NULL)
+        return 0;
+    retval = ulog_lock(ctx, KRB5_LOCKMODE_EXCLUSIVE);
+    if (retval)
+        return retval;
+    ctx->kdblog_context->ulogbatch = 1;
+    return 0;
+}
+
+/* Sync the updates made since ulog_begin_batch() and release the lock. */
+krb5_error_code
+ulog_end_batch(krb5_context ctx)
+{
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog = NULL;
+    ulong_t size;
+    krb5_error_code retval = 0;
+
+    if (ctx->kdblog_context == NULL || !ctx->kdblog_context->ulogbatch)
+        return 0;
+    INIT_ULOG(ctx);
+    log_ctx->ulogbatch = 0;
+
+    if (!pagesize)
+        pagesize = getpagesize();
+    size = sizeof(kdb_hlog_t) + log_ctx->ulogentries * ulog->kdb_block;
+    size = (size + (pagesize - 1)) & ~(pagesize - 1);
+    if (msync((caddr_t)ulog, size, MS_SYNC))
+        retval = errno;
+
+    (void) ulog_lock(ctx, KRB5_LOCKMODE_UNLOCK);
+    return retval;
+}
+
 /*
  * Sync update entry to disk.
  */
@@ -233,7 +283,7 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     if (!xdr_kdb_incr_update_t(&xdrs, upd))
         return (KRB5_LOG_CONV);
 
-    if ((retval = ulog_sync_update(ulog, indx_log)))
+    if (!log_ctx->ulogbatch && (retval = ulog_sync_update(ulog, indx_log)))
         return (retval);
 
     if (ulog->kdb_num < ulogentries)
@@ -256,7 +306,8 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
         ulog->kdb_first_time = indx_log->kdb_time;
     }
 
-    ulog_sync_header(ulog);
+    if (!log_ctx->ulogbatch)
+        ulog_sync_header(ulog);
 
     return (0);
 }
@@ -286,6 +337,9 @@ ulog_finish_update(krb5_context context, kdb_incr_update_t *upd)
 
     ulog->kdb_state = KDB_STABLE;
 
+    if (log_ctx->ulogbatch)
+        return (0);
+
     if ((retval = ulog_sync_update(ulog, indx_log)))
         return (retval);
 
@@ -1198,8 +1198,8 @@ decode_sequence(const unsigned char *asn1, size_t len,
                 const struct seq_info *seq, void *val);
 static asn1_error_code
 decode_sequence_of(const unsigned char *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out);
+                   const struct atype_info *elemtype, size_t extra,
+                   void **seq_out, size_t *count_out);
 
 /* Given the enclosing tag t, decode from asn1/len the contents of the ASN.1
  * type specified by a, placing the result into val (caller-allocated). */
@@ -1337,7 +1337,7 @@ decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
         const struct ptr_info *ptrinfo = a->tinfo;
         void *seq;
         assert(a->type == atype_ptr);
-        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, &seq,
+        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, 0, &seq,
                                  count_out);
         if (ret)
             return ret;
@@ -1369,23 +1369,17 @@ decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
     return 0;
 }
 
-/* Add a null pointer to the end of a sequence.  ptr is consumed on success
- * (to be replaced by *ptr_out), left alone on failure. */
-static asn1_error_code
-null_terminate(const struct atype_info *eltinfo, void *ptr, size_t count,
-               void **ptr_out)
+/* Store a null pointer in the spare slot after the count elements of a
+ * sequence decoded with one extra element of space. */
+static void
+null_terminate(const struct atype_info *eltinfo, void *ptr, size_t count)
 {
     const struct ptr_info *ptrinfo = eltinfo->tinfo;
     void *endptr;
 
     assert(eltinfo->type == atype_ptr);
-    ptr = realloc(ptr, (count + 1) * eltinfo->size);
-    if (ptr == NULL)
-        return ENOMEM;
     endptr = (char *)ptr + count * eltinfo->size;
     STOREPTR(NULL, ptrinfo, endptr);
-    *ptr_out = ptr;
-    return 0;
 }
 
 static asn1_error_code
@@ -1401,14 +1395,10 @@ decode_atype_to_ptr(const taginfo *t, const unsigned char *asn1,
     switch (a->type) {
     case atype_nullterm_sequence_of:
     case atype_nonempty_nullterm_sequence_of:
-        ret = decode_sequence_of(asn1, len, a->tinfo, &ptr, &count);
+        ret = decode_sequence_of(asn1, len, a->tinfo, 1, &ptr, &count);
         if (ret)
             return ret;
-        ret = null_terminate(a->tinfo, ptr, count, &ptr);
-        if (ret) {
-            free_sequence_of(a->tinfo, ptr, count);
-            return ret;
-        }
+        null_terminate(a->tinfo, ptr, count);
         /* Historically we do not enforce non-emptiness of sequences when
          * decoding, even when it is required by the ASN.1 type. */
         break;
@@ -1525,39 +1515,65 @@ error:
     return ret;
 }
 
+/* Count the elements of the DER encoding of a sequence-of in asn1/len,
+ * checking that each has the tag of elemtype. */
 static asn1_error_code
-decode_sequence_of(const unsigned char *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out)
+count_sequence_of(const unsigned char *asn1, size_t len,
+                  const struct atype_info *elemtype, size_t *count_out)
 {
     asn1_error_code ret;
-    void *seq = NULL, *elem, *newseq;
     const unsigned char *contents;
     size_t clen, count = 0;
     taginfo t;
 
-    *seq_out = NULL;
     *count_out = 0;
     while (len > 0) {
+        ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
+        if (ret)
+            return ret;
+        if (!check_atype_tag(elemtype, &t))
+            return ASN1_BAD_ID;
+        count++;
+    }
+    *count_out = count;
+    return 0;
+}
+
+/*
+ * Decode a sequence-of into an array of elemtype objects, allocated with
+ * room for extra additional elements after the decoded ones.  The elements
+ * are counted first so that the array is allocated once rather than grown
+ * per element.
+ */
+static asn1_error_code
+decode_sequence_of(const unsigned char *asn1, size_t len,
+                   const struct atype_info *elemtype, size_t extra,
+                   void **seq_out, size_t *count_out)
+{
+    asn1_error_code ret;
+    void *seq = NULL, *elem;
+    const unsigned char *contents;
+    size_t clen, count = 0, n;
+    taginfo t;
+
+    *seq_out = NULL;
+    *count_out = 0;
+    ret = count_sequence_of(asn1, len, elemtype, &n);
+    if (ret)
+        return ret;
+    if (n + extra == 0)
+        return 0;
+    seq = calloc(n + extra, elemtype->size);
+    if (seq == NULL)
+        return ENOMEM;
+    for (count = 0; count < n; count++) {
         ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
         if (ret)
             goto error;
-        if (!check_atype_tag(elemtype, &t)) {
-            ret = ASN1_BAD_ID;
-            goto error;
-        }
-        newseq = realloc(seq, (count + 1) * elemtype->size);
-        if (newseq == NULL) {
-            ret = ENOMEM;
-            goto error;
-        }
-        seq = newseq;
         elem = (char *)seq + count * elemtype->size;
-        memset(elem, 0, elemtype->size);
         ret = decode_atype(&t, contents, clen, elemtype, elem);
         if (ret)
             goto error;
-        count++;
     }
     *seq_out = seq;
     *count_out = count;
@@ -1592,25 +1608,46 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
 {
     size_t len;
     asn1_error_code ret;
-    asn1buf *buf = NULL;
-    krb5_data *d;
+    asn1buf buf;
+    krb5_data *d = NULL;
+    char *bytes = NULL;
 
     *code_out = NULL;
 
     if (rep == NULL)
         return ASN1_MISSING_FIELD;
-    ret = asn1buf_create(&buf);
+
+    /* Compute the exact length of the encoding. */
+    asn1buf_init_sizing(&buf);
+    ret = encode_atype_and_tag(&buf, rep, a, &len);
     if (ret)
         return ret;
-    ret = encode_atype_and_tag(buf, rep, a, &len);
-    if (ret)
+    len = asn1buf_len(&buf);
+
+    /* Encode into a single allocation which becomes the result. */
+    d = malloc(sizeof(*d));
+    bytes = malloc(len + 1);
+    if (d == NULL || bytes == NULL) {
+        ret = ENOMEM;
         goto cleanup;
-    ret = asn12krb5_buf(buf, &d);
+    }
+    asn1buf_init_output(&buf, bytes, len);
+    ret = encode_atype_and_tag(&buf, rep, a, &len);
     if (ret)
         goto cleanup;
+    if (buf.next != bytes) {
+        /* The two passes disagreed. */
+        ret = ASN1_BAD_LENGTH;
+        goto cleanup;
+    }
+    bytes[len] = '\0';
+    *d = make_data(bytes, len);
     *code_out = d;
+    return 0;
+
 cleanup:
-    asn1buf_destroy(&buf);
+    free(bytes);
+    free(d);
     return ret;
 }
 
@@ -97,9 +97,20 @@ extern krb5_error_code krb5_change_cache (void);
 
 #define KRB5_OK 0
 
-/* Individual credentials within a cache, in a linked list.  */
+/* Initial and maximum average chain lengths of the hash tables below. */
+#define MCC_CRED_TABLE_INIT     8
+#define MCC_CACHE_TABLE_INIT    64
+#define MCC_MAX_LOAD            2
+
+/*
+ * Individual credentials within a cache, in a linked list, newest first.
+ * Each link is also chained into a hash bucket of its cache, indexed by the
+ * server principal name.
+ */
 typedef struct _krb5_mcc_link {
     struct _krb5_mcc_link *next;
+    struct _krb5_mcc_link *hnext;
+    unsigned int hash;
     krb5_creds *creds;
 } krb5_mcc_link, *krb5_mcc_cursor;
 
@@ -109,12 +120,17 @@ typedef struct _krb5_mcc_data {
     k5_cc_mutex lock;
     krb5_principal prin;
     krb5_mcc_cursor link;
+    krb5_mcc_link **buckets;
+    size_t nbuckets;
+    size_t ncreds;
     krb5_timestamp changetime;
 } krb5_mcc_data;
 
-/* List of memory caches.  */
+/* List of memory caches, also chained into a hash table by name.  */
 typedef struct krb5_mcc_list_node {
-    struct krb5_mcc_list_node *next;
+    struct krb5_mcc_list_node *next, *prev;
+    struct krb5_mcc_list_node *hnext;
+    unsigned int hash;
     krb5_mcc_data *cache;
 } krb5_mcc_list_node;
 
@@ -125,11 +141,123 @@ struct krb5_mcc_ptcursor_data {
 
 k5_cc_mutex krb5int_mcc_mutex = K5_CC_MUTEX_PARTIAL_INITIALIZER;
 static krb5_mcc_list_node *mcc_head = 0;
+static krb5_mcc_list_node **mcc_table = NULL;
+static size_t mcc_table_size = 0;
+static size_t mcc_count = 0;
 
 static void update_mcc_change_time(krb5_mcc_data *);
 
 static void krb5_mcc_free (krb5_context context, krb5_ccache id);
 
+/* Continue an FNV-1a hash over len bytes at p. */
+static unsigned int
+mcc_hash_bytes(unsigned int h, const void *p, size_t len)
+{
+    const unsigned char *b = p;
+
+    while (len-- > 0)
+        h = (h ^ *b++) * 16777619U;
+    return h;
+}
+
+#define MCC_HASH_INIT 2166136261U
+
+/*
+ * Hash the name components of a server principal.  The realm is left out so
+ * that lookups with KRB5_TC_MATCH_SRV_NAMEONLY can use the index too.
+ */
+static unsigned int
+mcc_hash_server(krb5_const_principal server)
+{
+    unsigned int h = MCC_HASH_INIT, len;
+    krb5_int32 i;
+
+    if (server == NULL)
+        return 0;
+    for (i = 0; i < server->length; i++) {
+        len = server->data[i].length;
+        h = mcc_hash_bytes(h, &len, sizeof(len));
+        h = mcc_hash_bytes(h, server->data[i].data, len);
+    }
+    return h;
+}
+
+/*
+ * Double the size of a credential index, keeping each chain in the same
+ * newest-first order as the credential list.  Call with d->lock held.  On
+ * allocation failure, the existing table is kept.
+ */
+static void
+grow_cred_table(krb5_mcc_data *d)
+{
+    krb5_mcc_link **buckets, *l, *next, *prev;
+    size_t i, n = d->nbuckets * 2;
+
+    buckets = calloc(n, sizeof(*buckets));
+    if (buckets == NULL)
+        return;
+    for (l = d->link; l != NULL; l = l->next) {
+        i = l->hash % n;
+        l->hnext = buckets[i];
+        buckets[i] = l;
+    }
+    for (i = 0; i < n; i++) {
+        prev = NULL;
+        for (l = buckets[i]; l != NULL; l = next) {
+            next = l->hnext;
+            l->hnext = prev;
+            prev = l;
+        }
+        buckets[i] = prev;
+    }
+    free(d->buckets);
+    d->buckets = buckets;
+    d->nbuckets = n;
+}
+
+/*
+ * Double the size of the cache name table, or create it if it does not
+ * exist yet.  Call with the global list lock held.  On allocation failure,
+ * the existing table is kept, but an error is returned if there is none.
+ */
+static krb5_error_code
+grow_cache_table(void)
+{
+    krb5_mcc_list_node **table, *n;
+    size_t i, size;
+
+    size = (mcc_table_size == 0) ? MCC_CACHE_TABLE_INIT : mcc_table_size * 2;
+    table = calloc(size, sizeof(*table));
+    if (table == NULL)
+        return (mcc_table == NULL) ? KRB5_CC_NOMEM : 0;
+    for (n = mcc_head; n != NULL; n = n->next) {
+        i = n->hash % size;
+        n->hnext = table[i];
+        table[i] = n;
+    }
+    free(mcc_table);
+    mcc_table = table;
+    mcc_table_size = size;
+    return 0;
+}
+
+/* Look up a memory cache by name.  Call with the global list lock held. */
+static krb5_mcc_list_node *
+find_cache_node(const char *name)
+{
+    krb5_mcc_list_node *n;
+    unsigned int hash;
+
+    if (mcc_table == NULL)
+        return NULL;
+    hash = mcc_hash_bytes(MCC_HASH_INIT, name, strlen(name));
+    for (n = mcc_table[hash % mcc_table_size]; n != NULL; n = n->hnext) {
+        if (n->hash == hash && strcmp(n->cache->name, name) == 0)
+            return n;
+    }
+    return NULL;
+}
+
 /*
  * Modifies:
  * id
@@ -194,6 +322,9 @@ krb5_mcc_free(krb5_context context, krb5_ccache id)
         curr = next;
     }
     d->link = NULL;
+    free(d->buckets);
+    d->buckets = NULL;
+    d->nbuckets = d->ncreds = 0;
     krb5_free_principal(context, d->prin);
 }
 
@@ -216,13 +347,19 @@ krb5_mcc_destroy(krb5_context context, krb5_ccache id)
         return err;
 
     d = (krb5_mcc_data *)id->data;
-    for (curr = &mcc_head; *curr; curr = &(*curr)->next) {
-        if ((*curr)->cache == d) {
-            node = *curr;
-            *curr = node->next;
-            free(node);
-            break;
-        }
+    node = find_cache_node(d->name);
+    if (node != NULL && node->cache == d) {
+        for (curr = &mcc_table[node->hash % mcc_table_size]; *curr != node;
+             curr = &(*curr)->hnext);
+        *curr = node->hnext;
+        if (node->prev != NULL)
+            node->prev->next = node->next;
+        else
+            mcc_head = node->next;
+        if (node->next != NULL)
+            node->next->prev = node->prev;
+        mcc_count--;
+        free(node);
     }
     k5_cc_mutex_unlock(context, &krb5int_mcc_mutex);
 
@@ -273,9 +410,7 @@ krb5_mcc_resolve (krb5_context context, krb5_ccache *id, const char *residual)
     err = k5_cc_mutex_lock(context, &krb5int_mcc_mutex);
     if (err)
         return err;
-    for (ptr = mcc_head; ptr; ptr=ptr->next)
-        if (!strcmp(ptr->cache->name, residual))
-            break;
+    ptr = find_cache_node(residual);
     if (ptr)
         d = ptr->cache;
     else {
@@ -392,7 +527,7 @@ krb5_mcc_end_seq_get(krb5_context context, krb5_ccache id, krb5_cc_cursor *curso
 }
 
 /* Utility routine: Creates the back-end data for a memory cache, and
-   threads it into the global linked list.
+   threads it into the global linked list and name table.
 
    Call with the global list lock held.  */
 static krb5_error_code
@@ -402,6 +537,12 @@ new_mcc_data (const char *name, krb5_mcc_data **dataptr)
     krb5_mcc_data *d;
     krb5_mcc_list_node *n;
 
+    if (mcc_count >= mcc_table_size * MCC_MAX_LOAD) {
+        err = grow_cache_table();
+        if (err)
+            return err;
+    }
+
     d = malloc(sizeof(krb5_mcc_data));
     if (d == NULL)
         return KRB5_CC_NOMEM;
@@ -419,6 +560,8 @@ new_mcc_data (const char *name, krb5_mcc_data **dataptr)
         return KRB5_CC_NOMEM;
     }
     d->link = NULL;
+    d->buckets = NULL;
+    d->nbuckets = d->ncreds = 0;
     d->prin = NULL;
     d->changetime = 0;
     update_mcc_change_time(d);
@@ -432,8 +575,15 @@ new_mcc_data (const char *name, krb5_mcc_data **dataptr)
     }
 
     n->cache = d;
+    n->hash = mcc_hash_bytes(MCC_HASH_INIT, name, strlen(name));
+    n->hnext = mcc_table[n->hash % mcc_table_size];
+    mcc_table[n->hash % mcc_table_size] = n;
+    n->prev = NULL;
     n->next = mcc_head;
+    if (mcc_head != NULL)
+        mcc_head->prev = n;
     mcc_head = n;
+    mcc_count++;
 
     *dataptr = d;
     return 0;
@@ -476,8 +626,6 @@ krb5_mcc_generate_new (krb5_context context, krb5_ccache *id)
 
     /* Check for uniqueness with mutex locked to avoid race conditions */
     while (1) {
-        krb5_mcc_list_node *ptr;
-
         err = krb5int_random_string (context, uniquename, sizeof (uniquename));
         if (err) {
             k5_cc_mutex_unlock(context, &krb5int_mcc_mutex);
@@ -485,12 +633,8 @@ krb5_mcc_generate_new (krb5_context context, krb5_ccache *id)
             return err;
         }
 
-        for (ptr = mcc_head; ptr; ptr=ptr->next) {
-            if (!strcmp(ptr->cache->name, uniquename)) {
-                break;  /* got a match, loop again */
-            }
-        }
-        if (!ptr) break; /* got to the end without finding a match */
+        if (find_cache_node(uniquename) == NULL)
+            break;
     }
 
     err = new_mcc_data(uniquename, &d);
@@ -581,12 +725,79 @@ krb5_mcc_get_principal(krb5_context context, krb5_ccache id, krb5_principal *pri
     return krb5_copy_principal(context, ptr->prin, princ);
 }
 
+/* Return the preference index of enctype in ktypes, or -1 if absent. */
+static int
+enctype_pref(krb5_enctype enctype, int nktypes, krb5_enctype *ktypes)
+{
+    int i;
+
+    for (i = 0; i < nktypes; i++) {
+        if (ktypes[i] == enctype)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Effects:
+ * Searches id for credentials matching mcreds, with the same semantics as
+ * krb5_cc_retrieve_cred_default(), but only examines credentials in the
+ * index chain for the server name of mcreds, and copies only the
+ * credentials which are returned.
+ *
+ * Errors:
+ * KRB5_CC_NOTFOUND
+ * KRB5_CC_NOT_KTYPE
+ * system errors
+ */
 krb5_error_code KRB5_CALLCONV
 krb5_mcc_retrieve(krb5_context context, krb5_ccache id, krb5_flags whichfields,
                   krb5_creds *mcreds, krb5_creds *creds)
 {
-    return krb5_cc_retrieve_cred_default (context, id, whichfields,
-                                          mcreds, creds);
+    krb5_error_code ret;
+    krb5_mcc_data *d = id->data;
+    krb5_mcc_link *l, *best = NULL;
+    krb5_enctype *ktypes = NULL;
+    int nktypes = 0, pref, best_pref = 0;
+    unsigned int hash;
+
+    if (whichfields & KRB5_TC_SUPPORTED_KTYPES) {
+        ret = krb5_get_tgs_ktypes(context, mcreds->server, &ktypes);
+        if (ret)
+            return ret;
+        nktypes = k5_count_etypes(ktypes);
+    }
+
+    ret = k5_cc_mutex_lock(context, &d->lock);
+    if (ret)
+        goto cleanup;
+    ret = KRB5_CC_NOTFOUND;
+    hash = mcc_hash_server(mcreds->server);
+    l = (d->buckets == NULL) ? NULL : d->buckets[hash % d->nbuckets];
+    for (; l != NULL; l = l->hnext) {
+        if (l->hash != hash ||
+            !krb5int_cc_creds_match_request(context, whichfields, mcreds,
+                                            l->creds))
+            continue;
+        if (ktypes == NULL) {
+            best = l;
+            break;
+        }
+        pref = enctype_pref(l->creds->keyblock.enctype, nktypes, ktypes);
+        if (pref < 0) {
+            ret = KRB5_CC_NOT_KTYPE;
+        } else if (best == NULL || pref < best_pref) {
+            best = l;
+            best_pref = pref;
+        }
+    }
+    if (best != NULL)
+        ret = krb5int_copy_creds_contents(context, best->creds, creds);
+    k5_cc_mutex_unlock(context, &d->lock);
+
+cleanup:
+    free(ktypes);
+    return ret;
 }
 
 /*
@@ -648,18 +859,35 @@ krb5_mcc_store(krb5_context ctx, krb5_ccache id, krb5_creds *creds)
     new_node = malloc(sizeof(krb5_mcc_link));
     if (new_node == NULL)
         return ENOMEM;
+    new_node->creds = NULL;
     err = krb5_copy_creds(ctx, creds, &new_node->creds);
     if (err)
         goto cleanup;
+    new_node->hash = mcc_hash_server(new_node->creds->server);
     err = k5_cc_mutex_lock(ctx, &mptr->lock);
     if (err)
         goto cleanup;
+    if (mptr->buckets == NULL) {
+        mptr->buckets = calloc(MCC_CRED_TABLE_INIT, sizeof(*mptr->buckets));
+        if (mptr->buckets == NULL) {
+            k5_cc_mutex_unlock(ctx, &mptr->lock);
+            err = ENOMEM;
+            goto cleanup;
+        }
+        mptr->nbuckets = MCC_CRED_TABLE_INIT;
+    }
     new_node->next = mptr->link;
     mptr->link = new_node;
+    new_node->hnext = mptr->buckets[new_node->hash % mptr->nbuckets];
+    mptr->buckets[new_node->hash % mptr->nbuckets] = new_node;
+    if (++mptr->ncreds > mptr->nbuckets * MCC_MAX_LOAD)
+        grow_cred_table(mptr);
     update_mcc_change_time(mptr);
     k5_cc_mutex_unlock(ctx, &mptr->lock);
     return 0;
 cleanup:
+    if (new_node->creds != NULL)
+        krb5_free_creds(ctx, new_node->creds);
     free(new_node);
     return err;
 }
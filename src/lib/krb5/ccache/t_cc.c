@@ -385,6 +385,79 @@ test_misc(krb5_context context)
     krb5_cc_dfl_ops = ops_save;
 
 }
+
+/*
+ * Store enough credentials and caches to grow the memory cache hash tables,
+ * then check that each credential and cache can still be found.
+ */
+static void
+test_memory_index(krb5_context context)
+{
+    krb5_error_code kret;
+    krb5_ccache id, ids[200];
+    krb5_creds creds, mcreds;
+    krb5_principal server;
+    char name[64];
+    int i;
+
+    kret = init_test_cred(context);
+    CHECK(kret, "init_creds");
+
+    for (i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "MEMORY:index%d", i);
+        kret = krb5_cc_resolve(context, name, &ids[i]);
+        CHECK(kret, "resolve index cache");
+    }
+    kret = krb5_cc_initialize(context, ids[199], test_creds.client);
+    CHECK(kret, "initialize index cache");
+
+    server = test_creds.server;
+    for (i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "host%d", i);
+        kret = krb5_build_principal(context, &test_creds.server,
+                                    sizeof(REALM) - 1, REALM, "host", name,
+                                    NULL);
+        CHECK(kret, "build_principal");
+        kret = krb5_cc_store_cred(context, ids[199], &test_creds);
+        CHECK(kret, "store index cred");
+        krb5_free_principal(context, test_creds.server);
+    }
+    test_creds.server = server;
+
+    /* Resolving the same name again should find the populated cache. */
+    kret = krb5_cc_resolve(context, "MEMORY:index199", &id);
+    CHECK(kret, "resolve index cache again");
+    memset(&mcreds, 0, sizeof(mcreds));
+    mcreds.client = test_creds.client;
+    for (i = 99; i >= 0; i--) {
+        snprintf(name, sizeof(name), "host%d", i);
+        kret = krb5_build_principal(context, &mcreds.server,
+                                    sizeof("OTHER") - 1, "OTHER", "host",
+                                    name, NULL);
+        CHECK(kret, "build_principal");
+        kret = krb5_cc_retrieve_cred(context, id, 0, &mcreds, &creds);
+        CHECK_FAIL(KRB5_CC_NOTFOUND, kret, "retrieve wrong realm");
+        kret = krb5_cc_retrieve_cred(context, id, KRB5_TC_MATCH_SRV_NAMEONLY,
+                                     &mcreds, &creds);
+        CHECK(kret, "retrieve index cred");
+        CHECK_BOOL(!krb5_principal_compare_any_realm(context, creds.server,
+                                                     mcreds.server),
+                   "server does not match", "retrieve index cred");
+        krb5_free_cred_contents(context, &creds);
+        krb5_free_principal(context, mcreds.server);
+    }
+    mcreds.server = test_creds.server;
+    kret = krb5_cc_retrieve_cred(context, id, 0, &mcreds, &creds);
+    CHECK_FAIL(KRB5_CC_NOTFOUND, kret, "retrieve missing cred");
+    krb5_cc_close(context, id);
+
+    for (i = 0; i < 200; i++) {
+        kret = krb5_cc_destroy(context, ids[i]);
+        CHECK(kret, "destroy index cache");
+    }
+    free_test_cred(context);
+}
+
 extern const krb5_cc_ops krb5_mcc_ops;
 extern const krb5_cc_ops krb5_fcc_ops;
 
@@ -431,6 +504,7 @@ main(void)
         printf("Skiping KEYRING: test - unregistered type\n");
 
     do_test(context, "MEMORY:");
+    test_memory_index(context);
     do_test(context, "FILE:");
 
     krb5_free_context(context);
@@ -82,15 +82,34 @@ krb5_copy_context(krb5_context ctx, krb5_context *nctx_out)
     memset(&nctx->libkrb5_plugins, 0, sizeof(nctx->libkrb5_plugins));
     nctx->vtbl = NULL;
     nctx->locate_fptrs = NULL;
+    nctx->rd_req_keys = NULL;
+
+    /* Module contexts are per-context state; the copy builds its own on
+     * first use, from plugin mappings shared with ctx below. */
+    nctx->preauth_context = NULL;
+    nctx->ccselect_handles = NULL;
+    nctx->kdblog_context = NULL;
+    memset(&nctx->plugins, 0, sizeof(nctx->plugins));
+    nctx->plugin_base_dir = NULL;
+
+    /* The trace callback is told when its context is freed, so it stays with
+     * ctx. */
+    nctx->trace_callback = NULL;
+    nctx->trace_callback_data = NULL;
 
     memset(&nctx->err, 0, sizeof(nctx->err));
 
-    ret = k5_copy_etypes(ctx->in_tkt_etypes, &nctx->in_tkt_etypes);
-    if (ret)
-        goto errout;
-    ret = k5_copy_etypes(ctx->tgs_etypes, &nctx->tgs_etypes);
-    if (ret)
-        goto errout;
+    /* Null enctype lists mean the profile defaults, which the copy shares. */
+    if (ctx->in_tkt_etypes != NULL) {
+        ret = k5_copy_etypes(ctx->in_tkt_etypes, &nctx->in_tkt_etypes);
+        if (ret)
+            goto errout;
+    }
+    if (ctx->tgs_etypes != NULL) {
+        ret = k5_copy_etypes(ctx->tgs_etypes, &nctx->tgs_etypes);
+        if (ret)
+            goto errout;
+    }
 
     if (ctx->os_context.default_ccname != NULL) {
         nctx->os_context.default_ccname =
@@ -100,9 +119,29 @@ krb5_copy_context(krb5_context ctx, krb5_context *nctx_out)
             goto errout;
         }
     }
+    if (ctx->default_realm != NULL) {
+        nctx->default_realm = strdup(ctx->default_realm);
+        if (nctx->default_realm == NULL) {
+            ret = ENOMEM;
+            goto errout;
+        }
+    }
+    if (ctx->plugin_base_dir != NULL) {
+        nctx->plugin_base_dir = strdup(ctx->plugin_base_dir);
+        if (nctx->plugin_base_dir == NULL) {
+            ret = ENOMEM;
+            goto errout;
+        }
+    }
+
+    /* Share ctx's parsed profile data and loaded plugin objects, so that
+     * copying a context is much cheaper than initializing one. */
     ret = krb5_get_profile(ctx, &nctx->profile);
     if (ret)
         goto errout;
+    ret = k5_plugin_copy_context(ctx, nctx);
+    if (ret)
+        goto errout;
 
 errout:
     if (ret) {
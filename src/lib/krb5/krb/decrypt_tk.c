@@ -25,35 +25,40 @@
  */
 
 #include "k5-int.h"
+#include "int-proto.h"
 
-/*
-  Decrypts dec_ticket->enc_part
-  using *srv_key, and places result in dec_ticket->enc_part2.
-  The storage of dec_ticket->enc_part2 will be allocated before return.
+static krb5_error_code
+check_enctype(krb5_context context, krb5_ticket *ticket)
+{
+    if (!krb5_c_valid_enctype(ticket->enc_part.enctype))
+        return KRB5_PROG_ETYPE_NOSUPP;
 
-  returns errors from encryption routines, system errors
+    if (!krb5_is_permitted_enctype(context, ticket->enc_part.enctype))
+        return KRB5_NOPERM_ETYPE;
 
-*/
+    return 0;
+}
 
-krb5_error_code KRB5_CALLCONV
-krb5_decrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, register krb5_ticket *ticket)
+/* Like krb5_decrypt_tkt_part(), but using a krb5_key, so that keys derived
+ * from srv_key can be reused across tickets. */
+krb5_error_code
+k5_decrypt_tkt_part_key(krb5_context context, krb5_key srv_key,
+                        krb5_ticket *ticket)
 {
     krb5_enc_tkt_part *dec_tkt_part;
     krb5_data scratch;
     krb5_error_code retval;
 
-    if (!krb5_c_valid_enctype(ticket->enc_part.enctype))
-        return KRB5_PROG_ETYPE_NOSUPP;
-
-    if (!krb5_is_permitted_enctype(context, ticket->enc_part.enctype))
-        return KRB5_NOPERM_ETYPE;
+    retval = check_enctype(context, ticket);
+    if (retval)
+        return retval;
 
     scratch.length = ticket->enc_part.ciphertext.length;
     if (!(scratch.data = malloc(ticket->enc_part.ciphertext.length)))
         return(ENOMEM);
 
     /* call the encryption routine */
-    if ((retval = krb5_c_decrypt(context, srv_key,
+    if ((retval = krb5_k_decrypt(context, srv_key,
                                  KRB5_KEYUSAGE_KDC_REP_TICKET, 0,
                                  &ticket->enc_part, &scratch))) {
         free(scratch.data);
@@ -71,3 +76,30 @@ krb5_decrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, regist
     clean_scratch();
     return retval;
 }
+
+/*
+  Decrypts dec_ticket->enc_part
+  using *srv_key, and places result in dec_ticket->enc_part2.
+  The storage of dec_ticket->enc_part2 will be allocated before return.
+
+  returns errors from encryption routines, system errors
+
+*/
+
+krb5_error_code KRB5_CALLCONV
+krb5_decrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, register krb5_ticket *ticket)
+{
+    krb5_key key;
+    krb5_error_code retval;
+
+    retval = check_enctype(context, ticket);
+    if (retval)
+        return retval;
+
+    retval = krb5_k_create_key(context, srv_key, &key);
+    if (retval)
+        return retval;
+    retval = k5_decrypt_tkt_part_key(context, key, ticket);
+    krb5_k_free_key(context, key);
+    return retval;
+}
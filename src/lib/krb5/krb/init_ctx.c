@@ -281,6 +281,23 @@ cleanup:
     return retval;
 }
 
+/* Release the AP-REQ key cache used by krb5_rd_req_decoded(). */
+static void
+free_rd_req_keys(krb5_context context)
+{
+    struct rd_req_key_cache *cache = context->rd_req_keys;
+    int i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < RD_REQ_KEY_CACHE_SIZE; i++) {
+        krb5_free_principal(context, cache->ents[i].princ);
+        krb5_k_free_key(context, cache->ents[i].key);
+    }
+    free(cache);
+    context->rd_req_keys = NULL;
+}
+
 void KRB5_CALLCONV
 krb5_free_context(krb5_context ctx)
 {
@@ -307,6 +324,7 @@ krb5_free_context(krb5_context ctx)
 #endif
 
     k5_ccselect_free_context(ctx);
+    free_rd_req_keys(ctx);
     k5_plugin_free_context(ctx);
     free(ctx->plugin_base_dir);
 
@@ -195,6 +195,29 @@ krb5int_mk_setpw_req(krb5_context context, krb5_auth_context auth_context,
 void
 k5_ccselect_free_context(krb5_context context);
 
+krb5_error_code
+k5_decrypt_tkt_part_key(krb5_context context, krb5_key srv_key,
+                        krb5_ticket *ticket);
+
+/*
+ * A small per-context cache of krb5_key objects made from keytab entries.
+ * Reusing a krb5_key across AP-REQs lets the crypto library keep the keys it
+ * derives for ticket decryption instead of deriving them for every request.
+ * Entries are found by principal, kvno, and enctype, and are used only if
+ * the keytab still holds the same key, so a changed keytab simply causes a
+ * miss.
+ */
+#define RD_REQ_KEY_CACHE_SIZE 8
+
+struct rd_req_key_cache {
+    struct {
+        krb5_principal princ;
+        krb5_kvno kvno;
+        krb5_key key;
+    } ents[RD_REQ_KEY_CACHE_SIZE];
+    int next;                   /* Slot to replace next */
+};
+
 krb5_error_code
 k5_init_creds_get(krb5_context context, krb5_init_creds_context ctx,
                   int *use_master);
@@ -50,6 +50,7 @@ free_plugin_mapping(struct plugin_mapping *map)
     if (map == NULL)
         return;
     free(map->modname);
+    free(map->dyn_path);
     if (map->dyn_handle != NULL)
         krb5int_close_plugin(map->dyn_handle);
     free(map);
@@ -63,7 +64,7 @@ free_plugin_mapping(struct plugin_mapping *map)
 static krb5_error_code
 register_module(krb5_context context, struct plugin_interface *interface,
                 const char *modname, krb5_plugin_initvt_fn module,
-                struct plugin_file_handle *dyn_handle)
+                struct plugin_file_handle *dyn_handle, const char *dyn_path)
 {
     struct plugin_mapping *map, **pmap;
 
@@ -86,6 +87,15 @@ register_module(krb5_context context, struct plugin_interface *interface,
         free(map);
         return ENOMEM;
     }
+    map->dyn_path = NULL;
+    if (dyn_path != NULL) {
+        map->dyn_path = strdup(dyn_path);
+        if (map->dyn_path == NULL) {
+            free(map->modname);
+            free(map);
+            return ENOMEM;
+        }
+    }
     map->module = module;
     map->dyn_handle = dyn_handle;
 
@@ -196,7 +206,7 @@ register_dyn_module(krb5_context context, struct plugin_interface *interface,
 
     /* Create a mapping for the module. */
     ret = register_module(context, interface, modname,
-                          (krb5_plugin_initvt_fn)initvt_fn, handle);
+                          (krb5_plugin_initvt_fn)initvt_fn, handle, path);
     if (ret != 0)
         goto cleanup;
     handle = NULL;              /* Now owned by the module mapping. */
@@ -279,9 +289,12 @@ configure_interface(krb5_context context, int id)
         ret = register_dyn_mapping(context, interface, iname, *mod,
                                    enable, disable);
         if (ret != 0)
-            return ret;
+            goto cleanup;
     }
 
+    /* Later loads (and copies of this context) use the mappings as they
+     * stand, without consulting the profile again. */
+    interface->configured = TRUE;
     ret = 0;
 cleanup:
     profile_free_list(modules);
@@ -364,12 +377,14 @@ k5_plugin_register(krb5_context context, int interface_id, const char *modname,
     if (interface == NULL)
         return EINVAL;
 
-    /* Disallow registering plugins after load.  We may need to reconsider
-     * this, but it simplifies the design. */
+    /* Ignore registrations after load.  Consumers register their built-in
+     * modules each time they build their module handles, which may happen
+     * again after the interface is configured (e.g. in a copied context);
+     * the mappings made at configuration time stand. */
     if (interface->configured)
-        return EINVAL;
+        return 0;
 
-    return register_module(context, interface, modname, module, NULL);
+    return register_module(context, interface, modname, module, NULL, NULL);
 }
 
 krb5_error_code
@@ -380,9 +395,12 @@ k5_plugin_register_dyn(krb5_context context, int interface_id,
     struct plugin_interface *interface = get_interface(context, interface_id);
     char *path;
 
-    /* Disallow registering plugins after load. */
-    if (interface == NULL || interface->configured)
+    if (interface == NULL)
         return EINVAL;
+
+    /* Ignore registrations after load, as in k5_plugin_register. */
+    if (interface->configured)
+        return 0;
     if (asprintf(&path, "%s/%s/%s%s", context->plugin_base_dir, modsubdir,
                  modname, PLUGIN_EXT) < 0)
         return ENOMEM;
@@ -410,3 +428,52 @@ k5_plugin_free_context(krb5_context context)
         interface->configured = FALSE;
     }
 }
+
+krb5_error_code
+k5_plugin_copy_context(krb5_context ctx, krb5_context nctx)
+{
+    krb5_error_code ret;
+    int i;
+    struct plugin_interface *interface, *ninterface;
+    struct plugin_mapping *map, *nmap, **pnext;
+    struct plugin_file_handle *handle;
+
+    for (i = 0; i < PLUGIN_NUM_INTERFACES; i++) {
+        interface = &ctx->plugins[i];
+        ninterface = &nctx->plugins[i];
+        pnext = &ninterface->modules;
+        for (map = interface->modules; map != NULL; map = map->next) {
+            /* Reopening an object the parent holds open yields the same
+             * handle, so map->module remains valid for the copy. */
+            handle = NULL;
+            if (map->dyn_handle != NULL) {
+                ret = krb5int_open_plugin(map->dyn_path, &handle, &nctx->err);
+                if (ret)
+                    return ret;
+            }
+            nmap = calloc(1, sizeof(*nmap));
+            if (nmap == NULL)
+                goto enomem;
+            nmap->dyn_handle = handle;
+            handle = NULL;
+            *pnext = nmap;
+            pnext = &nmap->next;
+            nmap->module = map->module;
+            nmap->modname = strdup(map->modname);
+            if (nmap->modname == NULL)
+                goto enomem;
+            if (map->dyn_path != NULL) {
+                nmap->dyn_path = strdup(map->dyn_path);
+                if (nmap->dyn_path == NULL)
+                    goto enomem;
+            }
+        }
+        ninterface->configured = interface->configured;
+    }
+    return 0;
+
+enomem:
+    if (handle != NULL)
+        krb5int_close_plugin(handle);
+    return ENOMEM;
+}
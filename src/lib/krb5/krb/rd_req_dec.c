@@ -96,6 +96,66 @@ is_matching(krb5_context context, krb5_const_principal princ)
                 context->ignore_acceptor_hostname));
 }
 
+/* Get a krb5_key for the key in ent, from the context's cache if possible.
+ * The caller must release it with krb5_k_free_key(). */
+static krb5_error_code
+get_entry_key(krb5_context context, krb5_keytab_entry *ent, krb5_key *key_out)
+{
+    struct rd_req_key_cache *cache = context->rd_req_keys;
+    krb5_keyblock *kb;
+    krb5_principal princ;
+    krb5_key key;
+    krb5_error_code ret;
+    int i;
+
+    *key_out = NULL;
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(*cache));
+        if (cache == NULL)
+            return krb5_k_create_key(context, &ent->key, key_out);
+        context->rd_req_keys = cache;
+    }
+
+    for (i = 0; i < RD_REQ_KEY_CACHE_SIZE; i++) {
+        key = cache->ents[i].key;
+        if (key == NULL || cache->ents[i].kvno != ent->vno ||
+            key->keyblock.enctype != ent->key.enctype ||
+            !krb5_principal_compare(context, cache->ents[i].princ,
+                                    ent->principal))
+            continue;
+        kb = &key->keyblock;
+        if (kb->length == ent->key.length &&
+            memcmp(kb->contents, ent->key.contents, kb->length) == 0) {
+            krb5_k_reference_key(context, key);
+            *key_out = key;
+            return 0;
+        }
+        /* The keytab entry has changed; replace this slot. */
+        break;
+    }
+    if (i == RD_REQ_KEY_CACHE_SIZE) {
+        i = cache->next;
+        cache->next = (i + 1) % RD_REQ_KEY_CACHE_SIZE;
+    }
+
+    ret = krb5_k_create_key(context, &ent->key, &key);
+    if (ret)
+        return ret;
+    if (krb5_copy_principal(context, ent->principal, &princ) != 0) {
+        /* Use the key without caching it. */
+        *key_out = key;
+        return 0;
+    }
+    krb5_free_principal(context, cache->ents[i].princ);
+    krb5_k_free_key(context, cache->ents[i].key);
+    cache->ents[i].princ = princ;
+    cache->ents[i].kvno = ent->vno;
+    cache->ents[i].key = key;
+    krb5_k_reference_key(context, key);
+    *key_out = key;
+    return 0;
+}
+
 /* Decrypt the ticket in req using the key in ent. */
 static krb5_error_code
 try_one_entry(krb5_context context, const krb5_ap_req *req,
@@ -103,9 +163,14 @@ try_one_entry(krb5_context context, const krb5_ap_req *req,
 {
     krb5_error_code ret;
     krb5_principal tmp = NULL;
+    krb5_key key;
 
     /* Try decrypting the ticket with this entry's key. */
-    ret = krb5_decrypt_tkt_part(context, &ent->key, req->ticket);
+    ret = get_entry_key(context, ent, &key);
+    if (ret)
+        return ret;
+    ret = k5_decrypt_tkt_part_key(context, key, req->ticket);
+    krb5_k_free_key(context, key);
     if (ret)
         return ret;
 
@@ -0,0 +1,169 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/krb/t_copy_context.c - Test program for krb5_copy_context */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * Copy contexts in various states, check that the copies carry the same
+ * settings and module configuration as their parents, and check that each
+ * copy remains usable after its parent is freed.  Run under valgrind to
+ * catch state which is wrongly shared between the two contexts.
+ */
+
+#include "k5-int.h"
+
+static void
+check(int cond)
+{
+    if (!cond)
+        abort();
+}
+
+static void
+compare_string(const char *str1, const char *str2)
+{
+    check((str1 == NULL) == (str2 == NULL));
+    if (str1 != NULL)
+        check(strcmp(str1, str2) == 0);
+}
+
+static void
+compare_etypes(krb5_enctype *list1, krb5_enctype *list2)
+{
+    check((list1 == NULL) == (list2 == NULL));
+    if (list1 == NULL)
+        return;
+    while (*list1 != ENCTYPE_NULL && *list1 == *list2)
+        list1++, list2++;
+    check(*list1 == *list2);
+}
+
+static int
+count_modules(struct plugin_interface *interface)
+{
+    struct plugin_mapping *map;
+    int count = 0;
+
+    for (map = interface->modules; map != NULL; map = map->next)
+        count++;
+    return count;
+}
+
+/* Check that the context copy nctx has the same settings as ctx. */
+static void
+check_context(krb5_context nctx, krb5_context ctx)
+{
+    int i;
+
+    check(nctx->magic == KV5M_CONTEXT);
+    compare_etypes(nctx->in_tkt_etypes, ctx->in_tkt_etypes);
+    compare_etypes(nctx->tgs_etypes, ctx->tgs_etypes);
+    check(nctx->os_context.time_offset == ctx->os_context.time_offset);
+    check(nctx->os_context.os_flags == ctx->os_context.os_flags);
+    compare_string(nctx->os_context.default_ccname,
+                   ctx->os_context.default_ccname);
+    compare_string(nctx->default_realm, ctx->default_realm);
+    check(nctx->profile != NULL && nctx->profile != ctx->profile);
+    check(nctx->clockskew == ctx->clockskew);
+    check(nctx->kdc_default_options == ctx->kdc_default_options);
+    check(nctx->library_options == ctx->library_options);
+    check(nctx->allow_weak_crypto == ctx->allow_weak_crypto);
+    check(nctx->preauth_context == NULL);
+    check(nctx->ccselect_handles == NULL);
+    check(nctx->rd_req_keys == NULL);
+    check(nctx->trace_callback == NULL);
+    compare_string(nctx->plugin_base_dir, ctx->plugin_base_dir);
+    for (i = 0; i < PLUGIN_NUM_INTERFACES; i++) {
+        check(nctx->plugins[i].configured == ctx->plugins[i].configured);
+        check(count_modules(&nctx->plugins[i]) ==
+              count_modules(&ctx->plugins[i]));
+    }
+}
+
+/* Use ctx in ways which read the profile and load plugin modules. */
+static void
+exercise(krb5_context ctx)
+{
+    krb5_principal server;
+    krb5_ccache cache;
+    krb5_principal client;
+    krb5_error_code ret;
+    char *realm, *val;
+
+    check(krb5_get_default_realm(ctx, &realm) == 0);
+    krb5_free_default_realm(ctx, realm);
+    check(profile_get_string(ctx->profile, KRB5_CONF_LIBDEFAULTS,
+                             "ticket_lifetime", NULL, NULL, &val) == 0);
+    check(val != NULL && strcmp(val, "600") == 0);
+    profile_release_string(val);
+
+    /* This loads the ccselect modules; there is no matching cache. */
+    check(krb5_parse_name(ctx, "host/example.com", &server) == 0);
+    ret = krb5_cc_select(ctx, server, &cache, &client);
+    if (ret == 0)
+        krb5_cc_close(ctx, cache);
+    krb5_free_principal(ctx, client);
+    krb5_free_principal(ctx, server);
+}
+
+/* Copy ctx, check the copy, then free ctx and make sure the copy works. */
+static void
+copy_and_check(krb5_context ctx)
+{
+    krb5_context nctx, nctx2;
+
+    check(krb5_copy_context(ctx, &nctx) == 0);
+    check_context(nctx, ctx);
+    check(krb5_copy_context(nctx, &nctx2) == 0);
+    check_context(nctx2, nctx);
+    krb5_free_context(nctx);
+    exercise(nctx2);
+    krb5_free_context(nctx2);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_enctype etypes[3] = { ENCTYPE_AES128_CTS_HMAC_SHA1_96,
+                               ENCTYPE_DES3_CBC_SHA1, ENCTYPE_NULL };
+
+    /* A freshly initialized context. */
+    check(krb5_init_context(&ctx) == 0);
+    copy_and_check(ctx);
+
+    /* A context with explicit settings and loaded plugin modules. */
+    check(krb5_set_default_realm(ctx, "EXAMPLE.COM") == 0);
+    check(krb5_set_default_tgs_enctypes(ctx, etypes) == 0);
+    check(krb5_set_default_in_tkt_ktypes(ctx, etypes + 1) == 0);
+    check(krb5_cc_set_default_name(ctx, "MEMORY:t_copy_context") == 0);
+    ctx->clockskew = 1000;
+    ctx->allow_weak_crypto = TRUE;
+    exercise(ctx);
+    check(ctx->plugins[PLUGIN_INTERFACE_CCSELECT].configured);
+    copy_and_check(ctx);
+
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -935,8 +935,42 @@ cleanup:
     return retval;
 }
 
+/*
+ * Return the length of the literal prefix of the iteration pattern
+ * match_expr, which every principal name matching it begins with.  The
+ * pattern may be a regular expression, so stop at any character with a
+ * special meaning there, and before any character which a following
+ * quantifier might make optional or repeat.  A shorter prefix only costs
+ * some extra records, as the caller still matches each name.
+ */
+static size_t
+glob_prefix_len(const char *match_expr)
+{
+    const char *q;
+    size_t len;
+
+    /* An alternative can begin anywhere after a '|'. */
+    if (match_expr == NULL || strchr(match_expr, '|') != NULL)
+        return 0;
+    len = strcspn(match_expr, "?*[\\+(){}|.^$");
+    /* Quantifiers may be written with a backslash in basic regexps. */
+    q = match_expr + len;
+    if (*q == '\\')
+        q++;
+    if (len > 0 && *q != '\0' && strchr("+?{*", *q) != NULL)
+        len--;
+    return len;
+}
+
+/*
+ * Invoke func for each principal entry whose database key begins with the
+ * first plen bytes of prefix.  Keys are checked before entries are decoded,
+ * and in a btree database the iteration seeks directly to the first key not
+ * less than the prefix and stops after the last key that has it.
+ */
 static krb5_error_code
 ctx_iterate(krb5_context context, krb5_db2_context *dbc,
+            const char *prefix, size_t plen,
             krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
             krb5_pointer func_arg)
 {
@@ -944,14 +978,29 @@ ctx_iterate(krb5_context context, krb5_db2_context *dbc,
     krb5_data contdata;
     krb5_db_entry *entry;
     krb5_error_code retval, retval2;
+    krb5_boolean sorted;
     int dbret;
 
     retval = ctx_lock(context, dbc, KRB5_LOCKMODE_SHARED);
     if (retval)
         return retval;
 
-    dbret = dbc->db->seq(dbc->db, &key, &contents, R_FIRST);
+    sorted = !dbc->hashfirst;
+    if (plen > 0 && sorted) {
+        key.data = (char *)prefix;
+        key.size = plen;
+        dbret = dbc->db->seq(dbc->db, &key, &contents, R_CURSOR);
+    } else {
+        dbret = dbc->db->seq(dbc->db, &key, &contents, R_FIRST);
+    }
     while (dbret == 0) {
+        if (key.size < plen || memcmp(key.data, prefix, plen) != 0) {
+            /* In key order, no later key can have the prefix. */
+            if (sorted)
+                break;
+            dbret = dbc->db->seq(dbc->db, &key, &contents, R_NEXT);
+            continue;
+        }
         contdata.data = contents.data;
         contdata.length = contents.size;
         retval = krb5_decode_princ_entry(context, &contdata, &entry);
@@ -993,8 +1042,8 @@ krb5_db2_iterate(krb5_context context, char *match_expr,
 {
     if (!inited(context))
         return KRB5_KDB_DBNOTINITED;
-    return ctx_iterate(context, context->dal_handle->db_context, func,
-                       func_arg);
+    return ctx_iterate(context, context->dal_handle->db_context, match_expr,
+                       glob_prefix_len(match_expr), func, func_arg);
 }
 
 krb5_boolean
@@ -1277,7 +1326,8 @@ ctx_merge_nra(krb5_context context, krb5_db2_context *dbc_temp,
 
     nra.kcontext = context;
     nra.db_context = dbc_real;
-    return ctx_iterate(context, dbc_temp, krb5_db2_merge_nra_iterator, &nra);
+    return ctx_iterate(context, dbc_temp, NULL, 0, krb5_db2_merge_nra_iterator,
+                       &nra);
 }
 
 /*
@@ -216,6 +216,9 @@ typedef struct _krb5_ldap_context {
     krb5_ldap_realm_params        *lrparams;
     krb5_boolean                  disable_last_success;
     krb5_boolean                  disable_lockout;
+    krb5_ui_4                     princ_cache_ttl;
+    k5_mutex_t                    princ_cache_lock;
+    struct _krb5_ldap_princ_cache_ent *princ_cache;
     krb5_context                  kcontext;   /* to set the error code and message */
 } krb5_ldap_context;
 
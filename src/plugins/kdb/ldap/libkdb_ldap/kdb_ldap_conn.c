@@ -176,7 +176,7 @@ krb5_ldap_initialize(krb5_ldap_context *ldap_context,
         st = KRB5_KDB_ACCESS_ERROR;
         server_info->server_status = OFF;
         time(&server_info->downtime);
-        /* ldap_unbind_s(ldap_server_handle->ldap_handle); */
+        ldap_unbind_ext_s(ldap_server_handle->ldap_handle, NULL, NULL);
         free(ldap_server_handle);
     }
 
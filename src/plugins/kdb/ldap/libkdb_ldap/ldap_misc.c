@@ -208,6 +208,12 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
         goto cleanup;
     }
 
+    /* this mutex protects the principal entry cache */
+    if (k5_mutex_init(&ldap_context->princ_cache_lock) != 0) {
+        st = KRB5_KDB_SERVER_INTERNAL_ERR;
+        goto cleanup;
+    }
+
     /*
      * If max_server_conns is not set read it from database module
      * section of conf file this parameter defines maximum ldap
@@ -335,6 +341,15 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
                                    &ldap_context->disable_lockout)))
         goto cleanup;
 
+    /*
+     * Read the lifetime of cached principal entries.  The cache is
+     * disabled by default.
+     */
+    if ((st = prof_get_integer_def(context, conf_section,
+                                   KRB5_CONF_LDAP_PRINCIPAL_CACHE_TTL, 0,
+                                   &ldap_context->princ_cache_ttl)))
+        goto cleanup;
+
 cleanup:
     return(st);
 }
@@ -427,6 +442,8 @@ krb5_ldap_free_server_params(krb5_ldap_context *ldap_context)
 
     krb5_ldap_free_server_context_params(ldap_context);
 
+    krb5_ldap_princ_cache_flush(ldap_context->kcontext, ldap_context);
+    k5_mutex_destroy(&ldap_context->princ_cache_lock);
     k5_mutex_destroy(&ldap_context->hndl_lock);
     krb5_xfree(ldap_context);
     return(0);
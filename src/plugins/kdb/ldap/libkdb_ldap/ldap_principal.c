@@ -128,6 +128,287 @@ krb5_ldap_free_principal(krb5_context kcontext, krb5_db_entry *entry)
     free(entry);
 }
 
+/*
+ * Principal entry cache.  When ldap_principal_cache_ttl is set, entries
+ * returned by krb5_ldap_get_principal() are kept for that many seconds so
+ * that lookups of frequently used principals (krbtgt in particular) don't go
+ * back to the directory and re-decode the keys every time.  An entry is
+ * dropped as soon as this process modifies or deletes the principal; changes
+ * made through other servers become visible when the entry expires.
+ *
+ * The cache is a fixed-size hash table of PRINC_CACHE_BUCKETS buckets with
+ * PRINC_CACHE_DEPTH slots each.  When a bucket is full, the slot closest to
+ * expiry is reused.
+ */
+
+#define PRINC_CACHE_BUCKETS 256
+#define PRINC_CACHE_DEPTH   4
+
+struct _krb5_ldap_princ_cache_ent {
+    char          *name;
+    time_t        expires;
+    krb5_db_entry *entry;
+};
+
+static unsigned int
+princ_cache_hash(const char *name)
+{
+    unsigned int h = 5381;
+
+    while (*name != '\0')
+        h = h * 33 + (unsigned char)*name++;
+    return (h % PRINC_CACHE_BUCKETS) * PRINC_CACHE_DEPTH;
+}
+
+static void
+princ_cache_clear_slot(krb5_context context,
+                       struct _krb5_ldap_princ_cache_ent *slot)
+{
+    free(slot->name);
+    krb5_ldap_free_principal(context, slot->entry);
+    slot->name = NULL;
+    slot->entry = NULL;
+    slot->expires = 0;
+}
+
+/* Make a deep copy of a principal entry. */
+static krb5_error_code
+copy_db_entry(krb5_context context, krb5_db_entry *in, krb5_db_entry **out)
+{
+    krb5_error_code st;
+    krb5_db_entry *entry;
+    krb5_tl_data *tl, **tlp;
+    krb5_key_data *kd;
+    int i, j;
+
+    *out = NULL;
+    entry = k5alloc(sizeof(*entry), &st);
+    if (entry == NULL)
+        return st;
+    *entry = *in;
+    entry->princ = NULL;
+    entry->tl_data = NULL;
+    entry->n_key_data = 0;
+    entry->key_data = NULL;
+    entry->e_length = 0;
+    entry->e_data = NULL;
+
+    if ((st = krb5_copy_principal(context, in->princ, &entry->princ)) != 0)
+        goto cleanup;
+
+    if (in->e_length != 0) {
+        entry->e_data = k5alloc(in->e_length, &st);
+        if (entry->e_data == NULL)
+            goto cleanup;
+        memcpy(entry->e_data, in->e_data, in->e_length);
+        entry->e_length = in->e_length;
+    }
+
+    tlp = &entry->tl_data;
+    for (tl = in->tl_data; tl != NULL; tl = tl->tl_data_next) {
+        *tlp = k5alloc(sizeof(**tlp), &st);
+        if (*tlp == NULL)
+            goto cleanup;
+        if (tl->tl_data_length != 0) {
+            (*tlp)->tl_data_contents = k5alloc(tl->tl_data_length, &st);
+            if ((*tlp)->tl_data_contents == NULL)
+                goto cleanup;
+            memcpy((*tlp)->tl_data_contents, tl->tl_data_contents,
+                   tl->tl_data_length);
+        }
+        (*tlp)->tl_data_type = tl->tl_data_type;
+        (*tlp)->tl_data_length = tl->tl_data_length;
+        tlp = &(*tlp)->tl_data_next;
+    }
+
+    if (in->n_key_data > 0) {
+        entry->key_data = k5alloc(in->n_key_data * sizeof(*entry->key_data),
+                                  &st);
+        if (entry->key_data == NULL)
+            goto cleanup;
+        for (i = 0; i < in->n_key_data; i++) {
+            kd = &entry->key_data[i];
+            *kd = in->key_data[i];
+            for (j = 0; j < 2; j++) {
+                kd->key_data_contents[j] = NULL;
+                kd->key_data_length[j] = 0;
+            }
+            entry->n_key_data++;
+            for (j = 0; j < in->key_data[i].key_data_ver; j++) {
+                if (in->key_data[i].key_data_length[j] == 0)
+                    continue;
+                kd->key_data_contents[j] =
+                    k5alloc(in->key_data[i].key_data_length[j], &st);
+                if (kd->key_data_contents[j] == NULL)
+                    goto cleanup;
+                memcpy(kd->key_data_contents[j],
+                       in->key_data[i].key_data_contents[j],
+                       in->key_data[i].key_data_length[j]);
+                kd->key_data_length[j] = in->key_data[i].key_data_length[j];
+            }
+        }
+    }
+
+    *out = entry;
+    entry = NULL;
+
+cleanup:
+    krb5_ldap_free_principal(context, entry);
+    return st;
+}
+
+/*
+ * Look up princ in the principal cache.  On a hit, return a copy of the
+ * cached entry in *entry_out; otherwise return KRB5_KDB_NOENTRY.
+ */
+krb5_error_code
+krb5_ldap_princ_cache_lookup(krb5_context context,
+                             krb5_ldap_context *ldap_context,
+                             krb5_const_principal princ,
+                             krb5_db_entry **entry_out)
+{
+    krb5_error_code st = KRB5_KDB_NOENTRY;
+    struct _krb5_ldap_princ_cache_ent *slot;
+    char *name = NULL;
+    time_t now;
+    unsigned int i, base;
+
+    *entry_out = NULL;
+    if (ldap_context->princ_cache_ttl == 0)
+        return KRB5_KDB_NOENTRY;
+    if (krb5_unparse_name(context, princ, &name) != 0)
+        return KRB5_KDB_NOENTRY;
+
+    if (k5_mutex_lock(&ldap_context->princ_cache_lock) != 0) {
+        krb5_free_unparsed_name(context, name);
+        return KRB5_KDB_NOENTRY;
+    }
+    now = time(NULL);
+    base = princ_cache_hash(name);
+    for (i = 0; ldap_context->princ_cache != NULL && i < PRINC_CACHE_DEPTH;
+         i++) {
+        slot = &ldap_context->princ_cache[base + i];
+        if (slot->name == NULL || strcmp(slot->name, name) != 0)
+            continue;
+        if (slot->expires <= now)
+            princ_cache_clear_slot(context, slot);
+        else
+            st = copy_db_entry(context, slot->entry, entry_out);
+        break;
+    }
+    k5_mutex_unlock(&ldap_context->princ_cache_lock);
+    krb5_free_unparsed_name(context, name);
+    return st;
+}
+
+/* Add a copy of entry to the principal cache under its principal name.
+ * Errors are ignored; the entry just won't be cached. */
+void
+krb5_ldap_princ_cache_add(krb5_context context,
+                          krb5_ldap_context *ldap_context,
+                          krb5_db_entry *entry)
+{
+    struct _krb5_ldap_princ_cache_ent *slot, *victim = NULL;
+    krb5_db_entry *copy = NULL;
+    char *name = NULL;
+    unsigned int i, base;
+
+    if (ldap_context->princ_cache_ttl == 0)
+        return;
+
+    if (krb5_unparse_name(context, entry->princ, &name) != 0)
+        return;
+    if (copy_db_entry(context, entry, &copy) != 0)
+        goto cleanup;
+
+    if (k5_mutex_lock(&ldap_context->princ_cache_lock) != 0)
+        goto cleanup;
+    if (ldap_context->princ_cache == NULL) {
+        ldap_context->princ_cache =
+            calloc(PRINC_CACHE_BUCKETS * PRINC_CACHE_DEPTH,
+                   sizeof(*ldap_context->princ_cache));
+        if (ldap_context->princ_cache == NULL) {
+            k5_mutex_unlock(&ldap_context->princ_cache_lock);
+            goto cleanup;
+        }
+    }
+
+    /* Reuse the slot for name if present, else an empty or the oldest one. */
+    base = princ_cache_hash(name);
+    for (i = 0; i < PRINC_CACHE_DEPTH; i++) {
+        slot = &ldap_context->princ_cache[base + i];
+        if (slot->name != NULL && strcmp(slot->name, name) == 0) {
+            victim = slot;
+            break;
+        }
+        if (victim == NULL || (victim->name != NULL &&
+                               (slot->name == NULL ||
+                                slot->expires < victim->expires)))
+            victim = slot;
+    }
+    princ_cache_clear_slot(context, victim);
+    victim->name = name;
+    victim->entry = copy;
+    victim->expires = time(NULL) + ldap_context->princ_cache_ttl;
+    name = NULL;
+    copy = NULL;
+    k5_mutex_unlock(&ldap_context->princ_cache_lock);
+
+cleanup:
+    krb5_free_unparsed_name(context, name);
+    krb5_ldap_free_principal(context, copy);
+}
+
+/* Drop any cached entry for princ. */
+void
+krb5_ldap_princ_cache_remove(krb5_context context,
+                             krb5_ldap_context *ldap_context,
+                             krb5_const_principal princ)
+{
+    struct _krb5_ldap_princ_cache_ent *slot;
+    char *name = NULL;
+    unsigned int i, base;
+
+    if (ldap_context->princ_cache_ttl == 0 || princ == NULL)
+        return;
+
+    if (krb5_unparse_name(context, princ, &name) != 0) {
+        /* We can't tell which entry to drop, so drop them all. */
+        krb5_ldap_princ_cache_flush(context, ldap_context);
+        return;
+    }
+    if (k5_mutex_lock(&ldap_context->princ_cache_lock) == 0) {
+        base = princ_cache_hash(name);
+        for (i = 0; ldap_context->princ_cache != NULL &&
+                 i < PRINC_CACHE_DEPTH; i++) {
+            slot = &ldap_context->princ_cache[base + i];
+            if (slot->name != NULL && strcmp(slot->name, name) == 0)
+                princ_cache_clear_slot(context, slot);
+        }
+        k5_mutex_unlock(&ldap_context->princ_cache_lock);
+    }
+    krb5_free_unparsed_name(context, name);
+}
+
+/* Empty the principal cache and release its storage. */
+void
+krb5_ldap_princ_cache_flush(krb5_context context,
+                            krb5_ldap_context *ldap_context)
+{
+    unsigned int i;
+
+    if (ldap_context->princ_cache_ttl == 0)
+        return;
+    if (k5_mutex_lock(&ldap_context->princ_cache_lock) != 0)
+        return;
+    for (i = 0; ldap_context->princ_cache != NULL &&
+             i < PRINC_CACHE_BUCKETS * PRINC_CACHE_DEPTH; i++)
+        princ_cache_clear_slot(context, &ldap_context->princ_cache[i]);
+    free(ldap_context->princ_cache);
+    ldap_context->princ_cache = NULL;
+    k5_mutex_unlock(&ldap_context->princ_cache_lock);
+}
+
 krb5_error_code
 krb5_ldap_iterate(krb5_context context, char *match_expr,
                   krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
@@ -334,6 +615,8 @@ krb5_ldap_delete_principal(krb5_context context,
     }
 
 cleanup:
+    krb5_ldap_princ_cache_remove(context, ldap_context, searchfor);
+
     if (user)
         free (user);
 
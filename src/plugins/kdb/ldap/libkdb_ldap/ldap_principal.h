@@ -106,6 +106,20 @@ krb5_ldap_delete_principal(krb5_context, krb5_const_principal);
 void
 krb5_ldap_free_principal(krb5_context, krb5_db_entry *);
 
+krb5_error_code
+krb5_ldap_princ_cache_lookup(krb5_context, krb5_ldap_context *,
+                             krb5_const_principal, krb5_db_entry **);
+
+void
+krb5_ldap_princ_cache_add(krb5_context, krb5_ldap_context *, krb5_db_entry *);
+
+void
+krb5_ldap_princ_cache_remove(krb5_context, krb5_ldap_context *,
+                             krb5_const_principal);
+
+void
+krb5_ldap_princ_cache_flush(krb5_context, krb5_ldap_context *);
+
 krb5_error_code
 krb5_ldap_iterate(krb5_context, char *,
                   krb5_error_code (*)(krb5_pointer, krb5_db_entry *),
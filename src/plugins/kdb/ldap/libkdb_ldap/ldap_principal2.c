@@ -69,8 +69,93 @@ berval2tl_data(struct berval *in, krb5_tl_data **out)
     return 0;
 }
 
+/* Abandon the outstanding searches in msgids[0..n-1]. */
+static void
+abandon_searches(LDAP *ld, int *msgids, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        ldap_abandon_ext(ld, msgids[i], NULL, NULL);
+}
+
+/*
+ * Send a search for filter under each of the ntrees subtrees without waiting
+ * for the replies, so that the directory server can work on all of them while
+ * we process the first.  On success, msgids receives the message ID of each
+ * search.  Returns an LDAP result code.
+ */
+static int
+send_subtree_searches(LDAP *ld, krb5_ldap_context *ldap_context,
+                      char **subtree, unsigned int ntrees, char *filter,
+                      int *msgids)
+{
+    unsigned int i;
+    int st;
+
+    for (i = 0; i < ntrees; i++) {
+        st = ldap_search_ext(ld, subtree[i],
+                             ldap_context->lrparams->search_scope, filter,
+                             principal_attributes, 0, NULL, NULL, &timelimit,
+                             LDAP_NO_LIMIT, &msgids[i]);
+        if (st != LDAP_SUCCESS) {
+            abandon_searches(ld, msgids, i);
+            return st;
+        }
+    }
+    return LDAP_SUCCESS;
+}
+
 /*
- * look up a principal in the directory.
+ * After the searches on *ld failed with the LDAP error err because the
+ * connection is unusable, rebind the server handle and send the searches for
+ * subtree[0..ntrees-1] again, updating *ld.  Returns a Kerberos error code.
+ */
+static krb5_error_code
+rebind_and_send(krb5_context context, krb5_ldap_context *ldap_context,
+                krb5_ldap_server_handle **ldap_server_handle, LDAP **ld,
+                int err, char **subtree, unsigned int ntrees, char *filter,
+                int *msgids)
+{
+    int st;
+
+    st = krb5_ldap_rebind(ldap_context, ldap_server_handle);
+    if (*ldap_server_handle)
+        *ld = (*ldap_server_handle)->ldap_handle;
+    if (st != 0) {
+        prepend_err_str(context, "LDAP handle unavailable: ",
+                        KRB5_KDB_ACCESS_ERROR, err);
+        return KRB5_KDB_ACCESS_ERROR;
+    }
+    st = send_subtree_searches(*ld, ldap_context, subtree, ntrees, filter,
+                               msgids);
+    if (st != LDAP_SUCCESS)
+        return set_ldap_error(context, st, OP_SEARCH);
+    return 0;
+}
+
+/* Wait for all of the entries of the search msgid and return its result. */
+static int
+get_search_result(LDAP *ld, int msgid, LDAPMessage **result)
+{
+    int st, err;
+
+    *result = NULL;
+    st = ldap_result(ld, msgid, LDAP_MSG_ALL, &timelimit, result);
+    if (st == 0)
+        return LDAP_TIMEOUT;
+    if (st == -1) {
+        ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &err);
+        return err;
+    }
+    st = ldap_parse_result(ld, *result, &err, NULL, NULL, NULL, NULL, 0);
+    return (st == LDAP_SUCCESS) ? err : st;
+}
+
+/*
+ * look up a principal in the directory.  When there is more than one search
+ * subtree, the searches are pipelined on a single connection rather than
+ * paying a full round trip for each subtree in turn.
  */
 
 krb5_error_code
@@ -79,7 +164,7 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
 {
     char                        *user=NULL, *filter=NULL, *filtuser=NULL;
     unsigned int                tree=0, ntrees=1, princlen=0;
-    krb5_error_code             tempst=0, st=0;
+    krb5_error_code             st=0;
     char                        **values=NULL, **subtree=NULL, *cname=NULL;
     LDAP                        *ld=NULL;
     LDAPMessage                 *result=NULL, *ent=NULL;
@@ -89,6 +174,9 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     krb5_principal              cprinc=NULL;
     krb5_boolean                found=FALSE;
     krb5_db_entry               *entry = NULL;
+    int                         *msgids = NULL;
+    unsigned int                nsent = 0, ncollected = 0;
+    krb5_boolean                resent = FALSE;
 
     *entry_ptr = NULL;
 
@@ -110,6 +198,10 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
         goto cleanup;
     }
 
+    if (krb5_ldap_princ_cache_lookup(context, ldap_context, searchfor,
+                                     entry_ptr) == 0)
+        goto cleanup;
+
     if ((st=krb5_unparse_name(context, searchfor, &user)) != 0)
         goto cleanup;
 
@@ -132,10 +224,52 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntrees)) != 0)
         goto cleanup;
 
+    msgids = k5alloc(ntrees * sizeof(*msgids), &st);
+    if (msgids == NULL)
+        goto cleanup;
+
     GET_HANDLE();
+    st = send_subtree_searches(ld, ldap_context, subtree, ntrees, filter,
+                               msgids);
+    if (translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+        resent = TRUE;
+        st = rebind_and_send(context, ldap_context, &ldap_server_handle, &ld,
+                             st, subtree, ntrees, filter, msgids);
+        if (st != 0)
+            goto cleanup;
+    } else if (st != LDAP_SUCCESS) {
+        st = set_ldap_error(context, st, OP_SEARCH);
+        goto cleanup;
+    }
+    nsent = ntrees;
+
     for (tree=0; tree < ntrees && !found; ++tree) {
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
+        st = get_search_result(ld, msgids[tree], &result);
+        if (translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR &&
+            !resent) {
+            /*
+             * A pooled connection can turn out to be dead only when we wait
+             * for the replies.  The searches still outstanding went with it,
+             * so rebind and send them again, once.
+             */
+            ldap_msgfree(result);
+            result = NULL;
+            nsent = tree;
+            resent = TRUE;
+            st = rebind_and_send(context, ldap_context, &ldap_server_handle,
+                                 &ld, st, subtree + tree, ntrees - tree,
+                                 filter, msgids + tree);
+            if (st != 0)
+                goto cleanup;
+            nsent = ntrees;
+            st = get_search_result(ld, msgids[tree], &result);
+        }
+        ncollected = tree + 1;
+        if (st != LDAP_SUCCESS) {
+            st = set_ldap_error(context, st, OP_SEARCH);
+            goto cleanup;
+        }
         for (ent=ldap_first_entry(ld, result); ent != NULL && !found; ent=ldap_next_entry(ld, ent)) {
 
             /* get the associated directory user information */
@@ -189,6 +323,9 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     } /* for (tree=0 ... */
 
     if (found) {
+        /* Only cache canonical lookups, which don't depend on flags. */
+        if (cprinc == NULL)
+            krb5_ldap_princ_cache_add(context, ldap_context, entry);
         *entry_ptr = entry;
         entry = NULL;
     } else
@@ -198,6 +335,11 @@ cleanup:
     ldap_msgfree(result);
     krb5_ldap_free_principal(context, entry);
 
+    /* Don't leave unwanted replies queued on a pooled connection. */
+    if (ld != NULL && ncollected < nsent)
+        abandon_searches(ld, msgids + ncollected, nsent - ncollected);
+    free(msgids);
+
     if (filter)
         free (filter);
 
@@ -1259,6 +1401,8 @@ krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
     }
 
 cleanup:
+    krb5_ldap_princ_cache_remove(context, ldap_context, entry->princ);
+
     if (user)
         free(user);
 
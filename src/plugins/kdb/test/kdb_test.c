@@ -0,0 +1,473 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/test/kdb_test.c - Test KDB module with deferred authdata */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This is a test KDB module, not built for production use.  It passes all
+ * database operations through to the db2 module named by the "db2_module"
+ * variable of its [dbmodules] section, and implements sign_authdata_async
+ * by completing after "authdata_delay" milliseconds from the KDC's event
+ * loop, so that other requests can be processed while authdata for one is
+ * outstanding.  The authdata it returns is a single element of a local-use
+ * type; if "authdata_log" names a file, the server principal of each
+ * sign_authdata_async call is appended to it, so that tests can count the
+ * calls.  To catch the KDC resuming a request with the wrong realm active,
+ * it aborts if a principal entry is freed with a different context from the
+ * one which fetched it.
+ */
+
+#include "k5-int.h"
+#include "k5-plugin.h"
+#include "kdb5.h"
+#include <verto.h>
+
+static struct plugin_file_handle *db2_handle;
+static kdb_vftabl *db2;
+static int authdata_delay;
+static char *authdata_log;
+
+/* Negative authdata types are reserved for local use (RFC 4120 5.2.6). */
+#define TEST_AD_TYPE -42
+
+/* Entries returned by get_principal, with the context which fetched them. */
+struct entry_owner {
+    krb5_db_entry *entry;
+    krb5_context context;
+    struct entry_owner *next;
+};
+static struct entry_owner *owners;
+
+/* A sign_authdata_async call waiting for its timer. */
+struct pending_authdata {
+    krb5_db_sign_authdata_respond_fn respond;
+    void *arg;
+    krb5_authdata **authdata;
+};
+
+/* Load the db2 module named by conf_section if we have not done so yet. */
+static krb5_error_code
+load_db2(krb5_context context, char *conf_section)
+{
+    krb5_error_code code;
+    struct errinfo errinfo;
+    char *path = NULL;
+
+    if (db2 != NULL)
+        return 0;
+
+    memset(&errinfo, 0, sizeof(errinfo));
+    code = profile_get_string(context->profile, KDB_MODULE_SECTION,
+                              conf_section, "db2_module", NULL, &path);
+    if (code)
+        return code;
+    if (path == NULL) {
+        krb5_set_error_message(context, KRB5_KDB_DBTYPE_INIT,
+                               "No db2_module setting for %s", conf_section);
+        return KRB5_KDB_DBTYPE_INIT;
+    }
+    code = profile_get_integer(context->profile, KDB_MODULE_SECTION,
+                               conf_section, "authdata_delay", 0,
+                               &authdata_delay);
+    if (code)
+        goto cleanup;
+    code = profile_get_string(context->profile, KDB_MODULE_SECTION,
+                              conf_section, "authdata_log", NULL,
+                              &authdata_log);
+    if (code)
+        goto cleanup;
+
+    code = krb5int_open_plugin(path, &db2_handle, &errinfo);
+    if (code)
+        goto cleanup;
+    code = krb5int_get_plugin_data(db2_handle, "kdb_function_table",
+                                   (void **)&db2, &errinfo);
+    if (code)
+        goto cleanup;
+    code = db2->init_library();
+
+cleanup:
+    if (code) {
+        db2 = NULL;
+        profile_release_string(authdata_log);
+        authdata_log = NULL;
+        if (db2_handle != NULL)
+            krb5int_close_plugin(db2_handle);
+        db2_handle = NULL;
+    }
+    krb5int_free_error(&errinfo, NULL);
+    profile_release_string(path);
+    return code;
+}
+
+static krb5_error_code
+test_init(void)
+{
+    return 0;
+}
+
+static krb5_error_code
+test_cleanup(void)
+{
+    krb5_error_code code = 0;
+
+    if (db2 != NULL)
+        code = db2->fini_library();
+    if (db2_handle != NULL)
+        krb5int_close_plugin(db2_handle);
+    profile_release_string(authdata_log);
+    db2 = NULL;
+    db2_handle = NULL;
+    authdata_log = NULL;
+    return code;
+}
+
+static krb5_error_code
+test_open(krb5_context context, char *conf_section, char **db_args, int mode)
+{
+    krb5_error_code code;
+
+    code = load_db2(context, conf_section);
+    if (code)
+        return code;
+    return db2->init_module(context, conf_section, db_args, mode);
+}
+
+static krb5_error_code
+test_fini(krb5_context context)
+{
+    return db2->fini_module(context);
+}
+
+static krb5_error_code
+test_create(krb5_context context, char *conf_section, char **db_args)
+{
+    krb5_error_code code;
+
+    code = load_db2(context, conf_section);
+    if (code)
+        return code;
+    return db2->create(context, conf_section, db_args);
+}
+
+static krb5_error_code
+test_destroy(krb5_context context, char *conf_section, char **db_args)
+{
+    krb5_error_code code;
+
+    code = load_db2(context, conf_section);
+    if (code)
+        return code;
+    return db2->destroy(context, conf_section, db_args);
+}
+
+static krb5_error_code
+test_get_age(krb5_context context, char *db_name, time_t *age)
+{
+    return db2->get_age(context, db_name, age);
+}
+
+static krb5_error_code
+test_lock(krb5_context context, int mode)
+{
+    return db2->lock(context, mode);
+}
+
+static krb5_error_code
+test_unlock(krb5_context context)
+{
+    return db2->unlock(context);
+}
+
+static krb5_error_code
+test_get_principal(krb5_context context, krb5_const_principal search_for,
+                   unsigned int flags, krb5_db_entry **entry)
+{
+    krb5_error_code code;
+    struct entry_owner *owner;
+
+    code = db2->get_principal(context, search_for, flags, entry);
+    if (code)
+        return code;
+    owner = malloc(sizeof(*owner));
+    if (owner == NULL) {
+        db2->free_principal(context, *entry);
+        *entry = NULL;
+        return ENOMEM;
+    }
+    owner->entry = *entry;
+    owner->context = context;
+    owner->next = owners;
+    owners = owner;
+    return 0;
+}
+
+static void
+test_free_principal(krb5_context context, krb5_db_entry *entry)
+{
+    struct entry_owner **p, *owner;
+
+    for (p = &owners; *p != NULL; p = &(*p)->next) {
+        owner = *p;
+        if (owner->entry != entry)
+            continue;
+        if (owner->context != context) {
+            fprintf(stderr, "kdb_test: entry freed with the wrong context\n");
+            abort();
+        }
+        *p = owner->next;
+        free(owner);
+        break;
+    }
+    db2->free_principal(context, entry);
+}
+
+static krb5_error_code
+test_put_principal(krb5_context context, krb5_db_entry *entry, char **db_args)
+{
+    return db2->put_principal(context, entry, db_args);
+}
+
+static krb5_error_code
+test_delete_principal(krb5_context context, krb5_const_principal search_for)
+{
+    return db2->delete_principal(context, search_for);
+}
+
+static krb5_error_code
+test_iterate(krb5_context context, char *match_entry,
+             int (*func)(krb5_pointer, krb5_db_entry *),
+             krb5_pointer func_arg)
+{
+    return db2->iterate(context, match_entry, func, func_arg);
+}
+
+static krb5_error_code
+test_create_policy(krb5_context context, osa_policy_ent_t policy)
+{
+    return db2->create_policy(context, policy);
+}
+
+static krb5_error_code
+test_get_policy(krb5_context context, char *name, osa_policy_ent_t *policy)
+{
+    return db2->get_policy(context, name, policy);
+}
+
+static krb5_error_code
+test_put_policy(krb5_context context, osa_policy_ent_t policy)
+{
+    return db2->put_policy(context, policy);
+}
+
+static krb5_error_code
+test_iter_policy(krb5_context context, char *match_entry,
+                 osa_adb_iter_policy_func func, void *data)
+{
+    return db2->iter_policy(context, match_entry, func, data);
+}
+
+static krb5_error_code
+test_delete_policy(krb5_context context, char *policy)
+{
+    return db2->delete_policy(context, policy);
+}
+
+static void
+test_free_policy(krb5_context context, osa_policy_ent_t policy)
+{
+    db2->free_policy(context, policy);
+}
+
+static void *
+test_alloc(krb5_context context, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void
+test_free(krb5_context context, void *ptr)
+{
+    free(ptr);
+}
+
+static krb5_error_code
+test_promote_db(krb5_context context, char *conf_section, char **db_args)
+{
+    krb5_error_code code;
+
+    code = load_db2(context, conf_section);
+    if (code)
+        return code;
+    return db2->promote_db(context, conf_section, db_args);
+}
+
+static krb5_error_code
+test_check_policy_as(krb5_context context, krb5_kdc_req *request,
+                     krb5_db_entry *client, krb5_db_entry *server,
+                     krb5_timestamp kdc_time, const char **status,
+                     krb5_data *e_data)
+{
+    return db2->check_policy_as(context, request, client, server, kdc_time,
+                                status, e_data);
+}
+
+static void
+test_audit_as_req(krb5_context context, krb5_kdc_req *request,
+                  krb5_db_entry *client, krb5_db_entry *server,
+                  krb5_timestamp authtime, krb5_error_code error_code)
+{
+    db2->audit_as_req(context, request, client, server, authtime, error_code);
+}
+
+static void
+finish_sign_authdata(verto_ctx *vctx, verto_ev *ev)
+{
+    struct pending_authdata *pending = verto_get_private(ev);
+    krb5_db_sign_authdata_respond_fn respond = pending->respond;
+    void *arg = pending->arg;
+    krb5_authdata **authdata = pending->authdata;
+
+    free(pending);
+    (*respond)(arg, 0, authdata);
+}
+
+/* Append the name of server to the authdata log, if there is one. */
+static void
+log_sign_authdata(krb5_context context, krb5_db_entry *server)
+{
+    FILE *fp;
+    char *name;
+
+    if (authdata_log == NULL)
+        return;
+    if (krb5_unparse_name(context, server->princ, &name) != 0)
+        return;
+    fp = fopen(authdata_log, "a");
+    if (fp != NULL) {
+        fprintf(fp, "%s\n", name);
+        fclose(fp);
+    }
+    krb5_free_unparsed_name(context, name);
+}
+
+/* Make the authdata list returned by every sign_authdata_async call. */
+static krb5_error_code
+make_test_authdata(krb5_authdata ***authdata_out)
+{
+    krb5_authdata **list, *ad;
+
+    *authdata_out = NULL;
+    list = calloc(2, sizeof(*list));
+    ad = calloc(1, sizeof(*ad));
+    if (list == NULL || ad == NULL)
+        goto oom;
+    ad->magic = KV5M_AUTHDATA;
+    ad->ad_type = TEST_AD_TYPE;
+    ad->length = 4;
+    ad->contents = malloc(4);
+    if (ad->contents == NULL)
+        goto oom;
+    memcpy(ad->contents, "test", 4);
+    list[0] = ad;
+    *authdata_out = list;
+    return 0;
+
+oom:
+    free(ad);
+    free(list);
+    return ENOMEM;
+}
+
+static void
+test_sign_authdata_async(krb5_context context, verto_ctx *vctx,
+                         unsigned int flags, krb5_const_principal client_princ,
+                         krb5_db_entry *client, krb5_db_entry *server,
+                         krb5_db_entry *krbtgt, krb5_keyblock *client_key,
+                         krb5_keyblock *server_key, krb5_keyblock *krbtgt_key,
+                         krb5_keyblock *session_key, krb5_timestamp authtime,
+                         krb5_authdata **tgt_auth_data,
+                         krb5_db_sign_authdata_respond_fn respond, void *arg)
+{
+    struct pending_authdata *pending;
+    verto_ev *ev;
+
+    log_sign_authdata(context, server);
+    pending = malloc(sizeof(*pending));
+    if (pending == NULL) {
+        (*respond)(arg, ENOMEM, NULL);
+        return;
+    }
+    pending->respond = respond;
+    pending->arg = arg;
+    if (make_test_authdata(&pending->authdata) != 0) {
+        free(pending);
+        (*respond)(arg, ENOMEM, NULL);
+        return;
+    }
+    ev = verto_add_timeout(vctx, VERTO_EV_FLAG_NONE, finish_sign_authdata,
+                           authdata_delay);
+    if (ev == NULL) {
+        krb5_free_authdata(context, pending->authdata);
+        free(pending);
+        (*respond)(arg, ENOMEM, NULL);
+        return;
+    }
+    verto_set_private(ev, pending, NULL);
+}
+
+kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_test, kdb_function_table) = {
+    KRB5_KDB_DAL_MAJOR_VERSION,             /* major version number */
+    1,                                      /* minor version number 1 */
+    /* init_library */                  test_init,
+    /* fini_library */                  test_cleanup,
+    /* init_module */                   test_open,
+    /* fini_module */                   test_fini,
+    /* create */                        test_create,
+    /* destroy */                       test_destroy,
+    /* get_age */                       test_get_age,
+    /* lock */                          test_lock,
+    /* unlock */                        test_unlock,
+    /* get_principal */                 test_get_principal,
+    /* free_principal */                test_free_principal,
+    /* put_principal */                 test_put_principal,
+    /* delete_principal */              test_delete_principal,
+    /* iterate */                       test_iterate,
+    /* create_policy */                 test_create_policy,
+    /* get_policy */                    test_get_policy,
+    /* put_policy */                    test_put_policy,
+    /* iter_policy */                   test_iter_policy,
+    /* delete_policy */                 test_delete_policy,
+    /* free_policy */                   test_free_policy,
+    /* alloc */                         test_alloc,
+    /* free */                          test_free,
+    /* blah blah blah */ 0,0,0,0,0,
+    /* promote_db */                    test_promote_db,
+    0, 0, 0, 0,
+    /* check_policy_as */               test_check_policy_as,
+    0,
+    /* audit_as_req */                  test_audit_as_req,
+    0, 0,
+    /* sign_authdata_async */           test_sign_authdata_async
+};
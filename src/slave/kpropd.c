@@ -136,6 +136,10 @@ char    *progname;
 int     debug = 0;
 char    *srvtab = 0;
 int     standalone = 0;
+int     pipeline_load = 0;      /* Load the dump while it is being received */
+
+/* Process ID of a pipelined kdb5_util load in progress, or -1. */
+static pid_t load_pid = -1;
 
 krb5_principal  server;         /* This is our server principal name */
 krb5_principal  client;         /* This is who we're talking to */
@@ -145,6 +149,7 @@ char    *realm = NULL;          /* Our realm */
 char    *file = KPROPD_DEFAULT_FILE;
 char    *temp_file_name;
 char    *kdb5_util = KPROPD_DEFAULT_KDB5_UTIL;
+char    *kprop = KPROPD_DEFAULT_KPROP;
 char    *kerb_database = NULL;
 char    *acl_file_name = KPROPD_ACL_FILE;
 
@@ -162,8 +167,11 @@ krb5_error_code do_iprop(kdb_log_context *log_ctx);
 void    kerberos_authenticate(krb5_context, int, krb5_principal *,
                               krb5_enctype *, struct sockaddr_storage *);
 krb5_boolean authorized_principal(krb5_context, krb5_principal, krb5_enctype);
-void    recv_database(krb5_context, int, int, krb5_data *);
+void    recv_database(krb5_context, int, int, int, krb5_data *);
 void    load_database(krb5_context, char *, char *);
+static pid_t start_load(krb5_context, char *, char *, int);
+static void propagate_downstream(krb5_context);
+static void finish_load(pid_t, char *);
 void    send_error(krb5_context, int, krb5_error_code, char *);
 void    recv_error(krb5_context, krb5_data *);
 unsigned int backoff_from_master(int *);
@@ -176,9 +184,10 @@ kadm5_get_kiprop_host_srv_name(krb5_context context,
 static void usage()
 {
     fprintf(stderr,
-            _("\nUsage: %s [-r realm] [-s srvtab] [-dS] [-f slave_file]\n"),
+            _("\nUsage: %s [-r realm] [-s srvtab] [-dSl] [-f slave_file]\n"),
             progname);
     fprintf(stderr, _("\t[-F kerberos_db_file ] [-p kdb5_util_pathname]\n"));
+    fprintf(stderr, _("\t[-K kprop_pathname]\n"));
     fprintf(stderr, _("\t[-x db_args]* [-P port] [-a acl_file]\n"));
     exit(1);
 }
@@ -423,6 +432,36 @@ retry:
     return 0;
 }
 
+/* Write len bytes from data to fd, retrying on short writes. */
+static int
+write_all(int fd, const char *data, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Kill a pipelined load if we exit before the whole dump has been received,
+ * so that kdb5_util never mistakes a truncated dump for a complete one.
+ */
+static void
+kill_load(void)
+{
+    if (load_pid > 0)
+        kill(load_pid, SIGKILL);
+}
+
 void doit(fd)
     int     fd;
 {
@@ -434,7 +473,7 @@ void doit(fd)
     int lock_fd;
     mode_t omask;
     krb5_enctype etype;
-    int database_fd;
+    int database_fd, load_fd = -1, pipefds[2];
     char host[INET6_ADDRSTRLEN+1];
 
     if (kpropd_context->kdblog_context &&
@@ -530,7 +569,23 @@ void doit(fd)
                 temp_file_name);
         exit(1);
     }
-    recv_database(kpropd_context, fd, database_fd, &confmsg);
+    if (pipeline_load) {
+        /*
+         * Start kdb5_util now and feed it the dump through a pipe as it
+         * arrives, so that the load overlaps with the transfer.
+         */
+        if (pipe(pipefds) < 0) {
+            com_err(progname, errno, _("while creating pipe for %s"),
+                    kdb5_util);
+            exit(1);
+        }
+        (void)fcntl(pipefds[1], F_SETFD, FD_CLOEXEC);
+        atexit(kill_load);
+        load_pid = start_load(kpropd_context, kdb5_util, "-", pipefds[0]);
+        close(pipefds[0]);
+        load_fd = pipefds[1];
+    }
+    recv_database(kpropd_context, fd, database_fd, load_fd, &confmsg);
     if (rename(temp_file_name, file)) {
         com_err(progname, errno, _("while renaming %s to %s"),
                 temp_file_name, file);
@@ -542,7 +597,13 @@ void doit(fd)
                 temp_file_name);
         exit(1);
     }
-    load_database(kpropd_context, kdb5_util, file);
+    if (pipeline_load) {
+        /* Signal end of input to kdb5_util and wait for it to finish. */
+        close(load_fd);
+        finish_load(load_pid, kdb5_util);
+    } else {
+        load_database(kpropd_context, kdb5_util, file);
+    }
     retval = krb5_lock_file(kpropd_context, lock_fd, KRB5_LOCKMODE_UNLOCK);
     if (retval) {
         com_err(progname, retval, _("while unlocking '%s'"), temp_file_name);
@@ -567,9 +628,136 @@ void doit(fd)
         exit(1);
     }
 
+    propagate_downstream(kpropd_context);
+
     exit(0);
 }
 
+/* Create the ".dump_ok" file which kprop requires before sending a dump. */
+static krb5_error_code
+create_dump_ok_file(const char *dumpfile)
+{
+    char *ok_file;
+    int fd, ret = 0;
+
+    if (asprintf(&ok_file, "%s.dump_ok", dumpfile) < 0)
+        return ENOMEM;
+    fd = open(ok_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, "", 1) != 1)
+        ret = errno;
+    if (fd >= 0)
+        close(fd);
+    free(ok_file);
+    return ret;
+}
+
+/*
+ * If the kpropd_downstream relation is set for our realm, re-propagate the
+ * dump we have just loaded to each listed slave, with all of the kprop
+ * processes running concurrently.  This lets slaves form a propagation tree
+ * below the master.  Failures are logged but not fatal, since our own
+ * database has already been updated.
+ */
+static void
+propagate_downstream(krb5_context context)
+{
+    const char *names[4];
+    char **hosts = NULL, *defrealm = NULL, *av[12], *sep;
+    pid_t *pids = NULL;
+    int i, n, count, status;
+    krb5_error_code retval;
+
+    if (realm == NULL) {
+        retval = krb5_get_default_realm(context, &defrealm);
+        if (retval)
+            return;
+    }
+    names[0] = KRB5_CONF_REALMS;
+    names[1] = (realm != NULL) ? realm : defrealm;
+    names[2] = KRB5_CONF_KPROPD_DOWNSTREAM;
+    names[3] = NULL;
+    if (profile_get_values(context->profile, names, &hosts) != 0)
+        goto cleanup;
+    for (n = 0; hosts[n] != NULL; n++);
+
+    retval = create_dump_ok_file(file);
+    if (retval) {
+        com_err(progname, retval, _("while creating ok file for '%s'"),
+                file);
+        goto cleanup;
+    }
+
+    pids = calloc(n, sizeof(*pids));
+    if (pids == NULL)
+        goto cleanup;
+
+    count = 0;
+    av[count++] = "kprop";
+    if (realm != NULL) {
+        av[count++] = "-r";
+        av[count++] = realm;
+    }
+    if (srvtab != NULL) {
+        av[count++] = "-s";
+        av[count++] = srvtab;
+    }
+    av[count++] = "-f";
+    av[count++] = file;
+    av[count + 3] = NULL;
+
+    for (i = 0; i < n; i++) {
+        /* Use our own port unless the entry is of the form host:port. */
+        av[count] = "-P";
+        sep = strchr(hosts[i], ':');
+        if (sep != NULL && strchr(sep + 1, ':') == NULL) {
+            *sep = '\0';
+            av[count + 1] = sep + 1;
+        } else {
+            av[count + 1] = (char *)port;
+        }
+        av[count + 2] = hosts[i];
+        if (debug)
+            printf("propagating database to %s\n", hosts[i]);
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            com_err(progname, errno, _("while trying to fork %s"), kprop);
+        } else if (pids[i] == 0) {
+            if (!debug) {
+                close(0);
+                close(1);
+                close(2);
+                open("/dev/null", O_RDWR);
+                dup(0);
+                dup(0);
+            }
+            execv(kprop, av);
+            _exit(1);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (pids[i] <= 0)
+            continue;
+        if (waitpid(pids[i], &status, 0) < 0) {
+            com_err(progname, errno, _("while waiting for %s"), kprop);
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            syslog(LOG_INFO, _("Propagated database to %s"), hosts[i]);
+        } else {
+            syslog(LOG_ERR, _("Database propagation to %s failed"),
+                   hosts[i]);
+            if (debug) {
+                fprintf(stderr, _("Database propagation to %s failed\n"),
+                        hosts[i]);
+            }
+        }
+    }
+
+cleanup:
+    free(pids);
+    profile_free_list(hosts);
+    krb5_free_default_realm(context, defrealm);
+}
+
 /* Default timeout can be changed using clnt_control() */
 static struct timeval full_resync_timeout = { 25, 0 };
 
@@ -1072,6 +1260,15 @@ void PRS(argv)
                         usage();
                     word = 0;
                     break;
+                case 'K':
+                    if (*word)
+                        kprop = word;
+                    else
+                        kprop = *argv++;
+                    if (!kprop)
+                        usage();
+                    word = 0;
+                    break;
                 case 'P':
                     port = (*word != '\0') ? word : *argv++;
                     if (port == NULL)
@@ -1102,6 +1299,9 @@ void PRS(argv)
                 case 'S':
                     standalone++;
                     break;
+                case 'l':
+                    pipeline_load = 1;
+                    break;
                 case 'a':
                     if (*word)
                         acl_file_name = word;
@@ -1381,11 +1581,16 @@ authorized_principal(context, p, auth_etype)
     return FALSE;
 }
 
+/*
+ * Receive the database dump from fd and write it to database_fd.  If load_fd
+ * is not -1, also copy each block to load_fd as soon as it is decrypted.
+ */
 void
-recv_database(context, fd, database_fd, confmsg)
+recv_database(context, fd, database_fd, load_fd, confmsg)
     krb5_context context;
     int fd;
     int database_fd;
+    int load_fd;
     krb5_data *confmsg;
 {
     krb5_ui_4       database_size; /* This must be 4 bytes */
@@ -1459,6 +1664,15 @@ recv_database(context, fd, database_fd, confmsg)
             exit(1);
         }
         n = write(database_fd, outbuf.data, outbuf.length);
+        if (load_fd != -1 &&
+            write_all(load_fd, outbuf.data, outbuf.length) != 0) {
+            snprintf(buf, sizeof(buf),
+                     "while passing database block starting at offset %d "
+                     "to %s", received_size, kdb5_util);
+            com_err(progname, errno, "%s", buf);
+            send_error(context, fd, errno, buf);
+            exit(1);
+        }
         krb5_free_data_contents(context, &inbuf);
         krb5_free_data_contents(context, &outbuf);
         if (n < 0) {
@@ -1578,22 +1792,24 @@ load_database(context, kdb_util, database_file_name)
     krb5_context context;
     char *kdb_util;
     char *database_file_name;
+{
+    finish_load(start_load(context, kdb_util, database_file_name, -1),
+                kdb_util);
+}
+
+/*
+ * Fork and exec kdb_util to load database_file_name.  If load_fd is not -1,
+ * it becomes the child's standard input, from which a database_file_name of
+ * "-" is read.  Returns the process ID of the child.
+ */
+static pid_t
+start_load(krb5_context context, char *kdb_util, char *database_file_name,
+           int load_fd)
 {
     static char     *edit_av[10];
-    int     error_ret, save_stderr = -1;
-    int     child_pid;
+    int     save_stderr = -1;
+    pid_t   child_pid;
     int     count;
-
-    /* <sys/param.h> has been included, so BSD will be defined on
-       BSD systems */
-#if BSD > 0 && BSD <= 43
-#ifndef WEXITSTATUS
-#define WEXITSTATUS(w) (w).w_retcode
-#endif
-    union wait      waitb;
-#else
-    int     waitb;
-#endif
     krb5_error_code retval;
     kdb_log_context *log_ctx;
 
@@ -1633,6 +1849,10 @@ load_database(context, kdb_util, database_file_name)
             dup(0);
             dup(0);
         }
+        if (load_fd != -1) {
+            dup2(load_fd, 0);
+            close(load_fd);
+        }
 
         if (execv(kdb_util, edit_av) < 0)
             retval = errno;
@@ -1645,12 +1865,33 @@ load_database(context, kdb_util, database_file_name)
         /*NOTREACHED*/
     default:
         if (debug)
-            printf("Child PID is %d\n", child_pid);
-        if (wait(&waitb) < 0) {
-            com_err(progname, errno, _("while waiting for %s"), kdb_util);
-            exit(1);
-        }
+            printf("Child PID is %d\n", (int)child_pid);
+    }
+    return child_pid;
+}
+
+/* Wait for the kdb_util process child_pid and check its exit status. */
+static void
+finish_load(pid_t child_pid, char *kdb_util)
+{
+    int     error_ret;
+
+    /* <sys/param.h> has been included, so BSD will be defined on
+       BSD systems */
+#if BSD > 0 && BSD <= 43
+#ifndef WEXITSTATUS
+#define WEXITSTATUS(w) (w).w_retcode
+#endif
+    union wait      waitb;
+#else
+    int     waitb;
+#endif
+
+    if (waitpid(child_pid, &waitb, 0) < 0) {
+        com_err(progname, errno, _("while waiting for %s"), kdb_util);
+        exit(1);
     }
+    load_pid = -1;
 
     error_ret = WEXITSTATUS(waitb);
     if (error_ret) {
@@ -0,0 +1,468 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/gssapi/gssbench.c - GSSAPI krb5 mechanism benchmark */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * Benchmark for the krb5 GSSAPI mechanism, intended to be run against a test
+ * realm from gssbench.py.  Initiator and acceptor run in the same process,
+ * using the default ccache and keytab.
+ *
+ * Usage: ./gssbench [-o test]... [-s size]... [-t threads]... [-d seconds]
+ *                   [-a] [-N] target
+ *
+ * target is a host-based service name such as host@hostname.  The tests are:
+ *
+ *   establish  Mutual-authentication context establishment.  Reports the
+ *              initiator's time (both calls), the acceptor's time, and the
+ *              total for each establishment.
+ *   wrap       gss_wrap with confidentiality, then gss_unwrap.
+ *   mic        gss_get_mic, then gss_verify_mic.
+ *   wrap_iov   gss_wrap_iov with confidentiality, then gss_unwrap_iov.
+ *
+ * The message tests are run at each size (64 bytes to 1MB by default).  -a
+ * makes the acceptor use a credential acquired for the target name instead of
+ * the default credential.  -N disables the replay cache, so that comparing
+ * runs with and without it shows its share of the acceptor's time; running
+ * with a keytab containing many keys shows the cost of the keytab scan.
+ *
+ * Each test is run for the given duration (one second by default) in each of
+ * the given numbers of threads, each with its own contexts.  Results are
+ * tab-separated lines after a header line beginning with "#", giving the
+ * aggregate rate of the test loop and the mean and percentile latencies of
+ * each operation in microseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include <gssapi/gssapi_krb5.h>
+#include <gssapi/gssapi_ext.h>
+
+#define FLAGS (GSS_C_MUTUAL_FLAG | GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG | \
+               GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG)
+#define MAX_ARGS 32
+#define MAX_ROWS 3
+
+enum test { TEST_ESTABLISH, TEST_WRAP, TEST_MIC, TEST_WRAP_IOV };
+
+static const struct {
+    const char *name;
+    enum test test;
+    int sized;                  /* Sweep over message sizes? */
+    const char *rows[MAX_ROWS]; /* Operations reported */
+} tests[] = {
+    { "establish", TEST_ESTABLISH, 0, { "init", "accept", "establish" } },
+    { "wrap", TEST_WRAP, 1, { "wrap", "unwrap", NULL } },
+    { "mic", TEST_MIC, 1, { "get_mic", "verify_mic", NULL } },
+    { "wrap_iov", TEST_WRAP_IOV, 1, { "wrap_iov", "unwrap_iov", NULL } },
+};
+#define NTESTS (sizeof(tests) / sizeof(*tests))
+
+static const size_t default_sizes[] = {
+    64, 256, 1024, 4096, 16384, 65536, 262144, 1048576
+};
+#define NDEFAULT_SIZES (sizeof(default_sizes) / sizeof(*default_sizes))
+
+/* A growable set of latency samples, in microseconds. */
+struct samples {
+    double *v;
+    size_t n;
+    size_t alloc;
+};
+
+struct job {
+    pthread_t tid;
+    enum test test;
+    size_t size;
+    double duration;
+    unsigned long count;
+    double elapsed;
+    struct samples rows[MAX_ROWS];
+};
+
+static gss_name_t target;
+static gss_cred_id_t acceptor_cred = GSS_C_NO_CREDENTIAL;
+
+static void
+display_status_1(const char *m, OM_uint32 code, int type)
+{
+    OM_uint32 min_stat;
+    gss_buffer_desc msg;
+    OM_uint32 msg_ctx;
+
+    msg_ctx = 0;
+    while (1) {
+        (void)gss_display_status(&min_stat, code, type, GSS_C_NULL_OID,
+                                 &msg_ctx, &msg);
+        fprintf(stderr, "%s: %s\n", m, (char *)msg.value);
+        (void) gss_release_buffer(&min_stat, &msg);
+
+        if (!msg_ctx)
+            break;
+    }
+}
+
+/* Exit with an error message if major indicates failure. */
+static void
+check(OM_uint32 major, OM_uint32 minor, const char *what)
+{
+    if (!GSS_ERROR(major))
+        return;
+    display_status_1(what, major, GSS_C_GSS_CODE);
+    display_status_1(what, minor, GSS_C_MECH_CODE);
+    exit(1);
+}
+
+static double
+now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+usage()
+{
+    fprintf(stderr, "Usage: gssbench [-o test]... [-s size]... "
+            "[-t threads]... [-d seconds] [-a] [-N] target\n");
+    exit(1);
+}
+
+static void
+record(struct samples *s, double start, double end)
+{
+    double *v;
+    size_t newalloc;
+
+    if (s->n == s->alloc) {
+        newalloc = (s->alloc == 0) ? 1024 : s->alloc * 2;
+        v = realloc(s->v, newalloc * sizeof(*v));
+        if (v == NULL)
+            abort();
+        s->v = v;
+        s->alloc = newalloc;
+    }
+    s->v[s->n++] = (end - start) * 1000000;
+}
+
+static void
+establish(gss_ctx_id_t *ictx, gss_ctx_id_t *actx, struct samples *rows)
+{
+    OM_uint32 major, minor;
+    gss_buffer_desc itok, atok, itok2;
+    double t0, t1, t2, t3;
+
+    t0 = now();
+    major = gss_init_sec_context(&minor, GSS_C_NO_CREDENTIAL, ictx, target,
+                                 (gss_OID)gss_mech_krb5, FLAGS,
+                                 GSS_C_INDEFINITE, GSS_C_NO_CHANNEL_BINDINGS,
+                                 GSS_C_NO_BUFFER, NULL, &itok, NULL, NULL);
+    check(major, minor, "gss_init_sec_context");
+    t1 = now();
+    major = gss_accept_sec_context(&minor, actx, acceptor_cred, &itok,
+                                   GSS_C_NO_CHANNEL_BINDINGS, NULL, NULL,
+                                   &atok, NULL, NULL, NULL);
+    check(major, minor, "gss_accept_sec_context");
+    t2 = now();
+    major = gss_init_sec_context(&minor, GSS_C_NO_CREDENTIAL, ictx, target,
+                                 (gss_OID)gss_mech_krb5, FLAGS,
+                                 GSS_C_INDEFINITE, GSS_C_NO_CHANNEL_BINDINGS,
+                                 &atok, NULL, &itok2, NULL, NULL);
+    check(major, minor, "gss_init_sec_context (second call)");
+    t3 = now();
+    if (major != GSS_S_COMPLETE) {
+        fprintf(stderr, "Context establishment did not complete\n");
+        exit(1);
+    }
+    (void)gss_release_buffer(&minor, &itok);
+    (void)gss_release_buffer(&minor, &atok);
+    (void)gss_release_buffer(&minor, &itok2);
+
+    if (rows != NULL) {
+        /* The initiator's time is (t1 - t0) + (t3 - t2). */
+        record(&rows[0], t0 + t2, t1 + t3);
+        record(&rows[1], t1, t2);
+        record(&rows[2], t0, t3);
+    }
+}
+
+/* Run one iteration of a message test from ictx to actx. */
+static void
+message(enum test test, gss_ctx_id_t ictx, gss_ctx_id_t actx,
+        gss_buffer_t msg, struct samples *rows)
+{
+    OM_uint32 major, minor;
+    gss_buffer_desc tok, out;
+    gss_iov_buffer_desc iov[4];
+    double t0, t1, t2;
+
+    t0 = now();
+    if (test == TEST_WRAP) {
+        major = gss_wrap(&minor, ictx, 1, GSS_C_QOP_DEFAULT, msg, NULL, &tok);
+        check(major, minor, "gss_wrap");
+        t1 = now();
+        major = gss_unwrap(&minor, actx, &tok, &out, NULL, NULL);
+        check(major, minor, "gss_unwrap");
+        t2 = now();
+        (void)gss_release_buffer(&minor, &out);
+        (void)gss_release_buffer(&minor, &tok);
+    } else if (test == TEST_MIC) {
+        major = gss_get_mic(&minor, ictx, GSS_C_QOP_DEFAULT, msg, &tok);
+        check(major, minor, "gss_get_mic");
+        t1 = now();
+        major = gss_verify_mic(&minor, actx, msg, &tok, NULL);
+        check(major, minor, "gss_verify_mic");
+        t2 = now();
+        (void)gss_release_buffer(&minor, &tok);
+    } else {
+        /* The data buffer is encrypted and decrypted in place. */
+        iov[0].type = GSS_IOV_BUFFER_TYPE_HEADER |
+            GSS_IOV_BUFFER_FLAG_ALLOCATE;
+        iov[0].buffer.length = 0;
+        iov[0].buffer.value = NULL;
+        iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+        iov[1].buffer = *msg;
+        iov[2].type = GSS_IOV_BUFFER_TYPE_PADDING |
+            GSS_IOV_BUFFER_FLAG_ALLOCATE;
+        iov[2].buffer.length = 0;
+        iov[2].buffer.value = NULL;
+        iov[3].type = GSS_IOV_BUFFER_TYPE_TRAILER |
+            GSS_IOV_BUFFER_FLAG_ALLOCATE;
+        iov[3].buffer.length = 0;
+        iov[3].buffer.value = NULL;
+        major = gss_wrap_iov(&minor, ictx, 1, GSS_C_QOP_DEFAULT, NULL,
+                             iov, 4);
+        check(major, minor, "gss_wrap_iov");
+        t1 = now();
+        major = gss_unwrap_iov(&minor, actx, NULL, NULL, iov, 4);
+        check(major, minor, "gss_unwrap_iov");
+        t2 = now();
+        (void)gss_release_iov_buffer(&minor, iov, 4);
+    }
+    record(&rows[0], t0, t1);
+    record(&rows[1], t1, t2);
+}
+
+static void *
+run_job(void *arg)
+{
+    struct job *job = arg;
+    OM_uint32 minor;
+    gss_ctx_id_t ictx = GSS_C_NO_CONTEXT, actx = GSS_C_NO_CONTEXT;
+    gss_buffer_desc msg;
+    double start, stop;
+
+    msg.length = job->size;
+    msg.value = malloc(job->size ? job->size : 1);
+    if (msg.value == NULL)
+        abort();
+    memset(msg.value, 'x', job->size);
+    if (job->test != TEST_ESTABLISH)
+        establish(&ictx, &actx, NULL);
+
+    start = now();
+    stop = start + job->duration;
+    do {
+        if (job->test == TEST_ESTABLISH) {
+            establish(&ictx, &actx, job->rows);
+            (void)gss_delete_sec_context(&minor, &ictx, NULL);
+            (void)gss_delete_sec_context(&minor, &actx, NULL);
+        } else {
+            message(job->test, ictx, actx, &msg, job->rows);
+        }
+        job->count++;
+    } while (now() < stop);
+    job->elapsed = now() - start;
+
+    (void)gss_delete_sec_context(&minor, &ictx, NULL);
+    (void)gss_delete_sec_context(&minor, &actx, NULL);
+    free(msg.value);
+    return NULL;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static double
+percentile(const struct samples *s, double p)
+{
+    size_t i = (size_t)(p / 100 * s->n);
+
+    return s->v[(i < s->n) ? i : s->n - 1];
+}
+
+/* Run a test in nthreads threads and report each of its operations. */
+static void
+bench(size_t t, size_t size, int nthreads, double duration)
+{
+    struct job *jobs;
+    struct samples all;
+    unsigned long count = 0;
+    double rate = 0, elapsed = 0, sum;
+    size_t k;
+    int i, r;
+
+    jobs = calloc(nthreads, sizeof(*jobs));
+    if (jobs == NULL)
+        abort();
+    for (i = 0; i < nthreads; i++) {
+        jobs[i].test = tests[t].test;
+        jobs[i].size = size;
+        jobs[i].duration = duration;
+        if (pthread_create(&jobs[i].tid, NULL, run_job, &jobs[i]) != 0)
+            abort();
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(jobs[i].tid, NULL);
+        count += jobs[i].count;
+        if (jobs[i].elapsed > 0)
+            rate += jobs[i].count / jobs[i].elapsed;
+        if (jobs[i].elapsed > elapsed)
+            elapsed = jobs[i].elapsed;
+    }
+
+    for (r = 0; r < MAX_ROWS && tests[t].rows[r] != NULL; r++) {
+        /* Pool the samples from all threads. */
+        memset(&all, 0, sizeof(all));
+        for (i = 0; i < nthreads; i++)
+            all.n += jobs[i].rows[r].n;
+        all.v = malloc(all.n * sizeof(*all.v));
+        if (all.v == NULL)
+            abort();
+        all.n = 0;
+        for (i = 0; i < nthreads; i++) {
+            memcpy(all.v + all.n, jobs[i].rows[r].v,
+                   jobs[i].rows[r].n * sizeof(*all.v));
+            all.n += jobs[i].rows[r].n;
+        }
+        qsort(all.v, all.n, sizeof(*all.v), cmp_double);
+        for (k = 0, sum = 0; k < all.n; k++)
+            sum += all.v[k];
+        printf("%s\t%s\t%lu\t%d\t%lu\t%.6f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t"
+               "%.1f\n", tests[t].name, tests[t].rows[r],
+               (unsigned long)size, nthreads, count, elapsed, rate,
+               sum / all.n, percentile(&all, 50), percentile(&all, 90),
+               percentile(&all, 99), all.v[all.n - 1]);
+        free(all.v);
+    }
+    fflush(stdout);
+
+    for (i = 0; i < nthreads; i++) {
+        for (r = 0; r < MAX_ROWS; r++)
+            free(jobs[i].rows[r].v);
+    }
+    free(jobs);
+}
+
+int
+main(int argc, char **argv)
+{
+    OM_uint32 major, minor;
+    gss_buffer_desc buf;
+    const char *testnames[MAX_ARGS];
+    size_t sizes[MAX_ARGS], j;
+    int threads[MAX_ARGS], ntestnames = 0, nsizes = 0, nthreadargs = 0;
+    int c, o, s, th, acquire = 0;
+    double duration = 1.0;
+
+    while ((c = getopt(argc, argv, "o:s:t:d:aN")) != -1) {
+        if (c == 'o' && ntestnames < MAX_ARGS)
+            testnames[ntestnames++] = optarg;
+        else if (c == 's' && nsizes < MAX_ARGS)
+            sizes[nsizes++] = strtoul(optarg, NULL, 10);
+        else if (c == 't' && nthreadargs < MAX_ARGS)
+            threads[nthreadargs++] = atoi(optarg);
+        else if (c == 'd')
+            duration = strtod(optarg, NULL);
+        else if (c == 'a')
+            acquire = 1;
+        else if (c == 'N')
+            setenv("KRB5RCACHETYPE", "none", 1);
+        else
+            usage();
+    }
+    if (optind != argc - 1 || duration < 0)
+        usage();
+    if (ntestnames == 0) {
+        for (j = 0; j < NTESTS; j++)
+            testnames[ntestnames++] = tests[j].name;
+    }
+    if (nsizes == 0) {
+        for (j = 0; j < NDEFAULT_SIZES; j++)
+            sizes[nsizes++] = default_sizes[j];
+    }
+    if (nthreadargs == 0)
+        threads[nthreadargs++] = 1;
+    for (th = 0; th < nthreadargs; th++) {
+        if (threads[th] <= 0)
+            usage();
+    }
+
+    buf.value = argv[optind];
+    buf.length = strlen(argv[optind]);
+    major = gss_import_name(&minor, &buf, GSS_C_NT_HOSTBASED_SERVICE,
+                            &target);
+    check(major, minor, "gss_import_name");
+    if (acquire) {
+        major = gss_acquire_cred(&minor, target, GSS_C_INDEFINITE,
+                                 GSS_C_NO_OID_SET, GSS_C_ACCEPT,
+                                 &acceptor_cred, NULL, NULL);
+        check(major, minor, "gss_acquire_cred");
+    }
+
+    printf("#test\top\tsize\tthreads\titerations\tseconds\titerations/s\t"
+           "mean_us\tp50_us\tp90_us\tp99_us\tmax_us\n");
+    for (o = 0; o < ntestnames; o++) {
+        for (j = 0; j < NTESTS; j++) {
+            if (strcmp(testnames[o], tests[j].name) == 0)
+                break;
+        }
+        if (j == NTESTS) {
+            fprintf(stderr, "Unknown test: %s\n", testnames[o]);
+            exit(1);
+        }
+        for (s = 0; s < (tests[j].sized ? nsizes : 1); s++) {
+            for (th = 0; th < nthreadargs; th++) {
+                bench(j, tests[j].sized ? sizes[s] : 0, threads[th],
+                      duration);
+            }
+        }
+    }
+
+    (void)gss_release_cred(&minor, &acceptor_cred);
+    (void)gss_release_name(&minor, &target);
+    return 0;
+}
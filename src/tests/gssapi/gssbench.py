@@ -0,0 +1,40 @@
+#!/usr/bin/python
+# Stand up a test realm and measure the krb5 GSSAPI mechanism with
+# gssbench.  Run with "make bench" from the build tree; arguments after
+# "--" (BENCHARGS for make) are passed to each gssbench run, for example:
+#
+#   make bench BENCHARGS='-t 1 -t 4 -d 2'
+#
+# Context establishment is measured with the replay cache, without it,
+# and with a keytab holding many keys, so that the acceptor's costs can
+# be told apart.
+
+from k5test import *
+
+gssbench = os.path.join(buildtop, 'tests', 'gssapi', 'gssbench')
+target = 'host@%s' % hostname
+
+realm = K5Realm()
+
+
+def run(desc, runargs):
+    out = realm.run_as_client([gssbench] + runargs + args + [target])
+    output('\n# %s\n%s' % (desc, out), force_verbose=True)
+
+
+run('Context establishment', ['-o', 'establish'])
+run('Context establishment, no replay cache', ['-N', '-o', 'establish'])
+run('Per-message operations', ['-o', 'wrap', '-o', 'mic', '-o', 'wrap_iov'])
+
+# Add a thousand other keys to the keytab.  krb5_kt_get_entry reads the
+# whole file to find the highest kvno, so where the host key sits
+# doesn't matter.
+queries = []
+for i in range(1000):
+    princ = 'filler%d/%s' % (i, hostname)
+    queries.append('addprinc -randkey %s' % princ)
+    queries.append('ktadd -k %s %s' % (realm.keytab, princ))
+realm.run_as_master([kadmin_local], input='\n'.join(queries) + '\n')
+run('Context establishment, 1001-key keytab', ['-o', 'establish'])
+
+success('GSSAPI benchmark')
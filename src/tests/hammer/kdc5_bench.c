@@ -0,0 +1,878 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/hammer/kdc5_bench.c - KDC load generator and benchmark */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * kdc5_bench measures the throughput and latency of a KDC.
+ *
+ * Before the timed run, it uses the stepwise init_creds or tkt_creds API to
+ * encode a set of distinct AS or TGS requests.  Any preliminary exchanges
+ * (the PREAUTH_REQUIRED round trip, or FAST armoring when an armor ccache is
+ * given) are carried out against the KDC at this point, so that each stored
+ * request is the final request of its exchange: an AS request carrying
+ * PA-ENC-TIMESTAMP or encrypted challenge, or a TGS request.
+ *
+ * The timed run sends each stored request exactly once (so the KDC's
+ * lookaside cache is not exercised) from a number of threads, each driving
+ * several UDP sockets or TCP connections with at most one request
+ * outstanding on each.  Replies are classified by message type without
+ * being decrypted.  With -r, requests are scheduled open-loop at the given
+ * aggregate rate and latency is measured from each request's scheduled send
+ * time, so time spent waiting for a free socket counts against the KDC.
+ * Without -r, each socket sends its next request as soon as it has a reply.
+ *
+ * AS requests contain a timestamp and must be sent within the KDC's clock
+ * skew of being encoded.
+ */
+
+#include "k5-int.h"
+#include "com_err.h"
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+
+#define MAX_REPLY 65536
+#define MAX_ERRCODES 16
+
+struct request {
+    krb5_data pkt;              /* encoded request, with TCP framing */
+    double sched;               /* scheduled (or actual) send time */
+    double latency;             /* seconds, or -1 if not answered */
+};
+
+struct slot {
+    int fd;
+    int connecting;
+    struct request *req;        /* outstanding request, or NULL */
+    double deadline;
+    unsigned char *buf;
+    size_t len;
+};
+
+struct errcount {
+    krb5_ui_4 code;
+    unsigned long count;
+};
+
+struct worker {
+    pthread_t tid;
+    int id;
+    krb5_context ctx;
+    struct request *reqs;
+    size_t nreqs;
+    unsigned long nok, nerr, ntimeout, nfail;
+    struct errcount errs[MAX_ERRCODES];
+    int nerrs;
+    double last;
+};
+
+static const char *prog;
+static struct sockaddr_storage kdc_addr;
+static socklen_t kdc_addrlen;
+static int use_tcp = 0;
+static int nthreads = 1;
+static int nsockets = 8;
+static double rate = 0;
+static double timeout = 5.0;
+static double start_time;
+
+static void
+usage()
+{
+    fprintf(stderr,
+            _("usage: %s [-u | -t] [-h host] [-p port] [-n count] "
+              "[-r rate]\n\t[-T threads] [-s sockets] [-o timeout] "
+              "[-A armor_ccache]\n\t{-S service [-c ccache] | "
+              "[-k keytab | -w password] client}\n"), prog);
+    exit(1);
+}
+
+static double
+now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+bail(krb5_context ctx, krb5_error_code code, const char *what)
+{
+    const char *msg = krb5_get_error_message(ctx, code);
+
+    fprintf(stderr, "%s: %s: %s\n", prog, what, msg);
+    krb5_free_error_message(ctx, msg);
+    exit(1);
+}
+
+/*** Request generation ***/
+
+/* Either an init_creds or a tkt_creds exchange, depending on the mode. */
+struct gen {
+    krb5_context ctx;
+    krb5_principal client;
+    const char *password;
+    krb5_keytab keytab;
+    krb5_get_init_creds_opt *opt;
+    krb5_ccache ccache;
+    krb5_creds in_creds;
+    int tgs;
+    krb5_init_creds_context icc;
+    krb5_tkt_creds_context tcc;
+};
+
+static krb5_error_code
+gen_begin(struct gen *g)
+{
+    krb5_error_code ret;
+
+    if (g->tgs) {
+        return krb5_tkt_creds_init(g->ctx, g->ccache, &g->in_creds,
+                                   KRB5_GC_NO_STORE, &g->tcc);
+    }
+    ret = krb5_init_creds_init(g->ctx, g->client, NULL, NULL, 0, g->opt,
+                               &g->icc);
+    if (ret)
+        return ret;
+    if (g->keytab != NULL)
+        return krb5_init_creds_set_keytab(g->ctx, g->icc, g->keytab);
+    return krb5_init_creds_set_password(g->ctx, g->icc, g->password);
+}
+
+/* Produce the next request in *out, setting *more if there is one. */
+static krb5_error_code
+gen_step(struct gen *g, krb5_data *in, krb5_data *out, int *more)
+{
+    krb5_error_code ret;
+    krb5_data realm = empty_data();
+    unsigned int flags = 0;
+
+    if (g->tgs)
+        ret = krb5_tkt_creds_step(g->ctx, g->tcc, in, out, &realm, &flags);
+    else
+        ret = krb5_init_creds_step(g->ctx, g->icc, in, out, &realm, &flags);
+    krb5_free_data_contents(g->ctx, &realm);
+    *more = (flags & KRB5_INIT_CREDS_STEP_FLAG_CONTINUE) != 0;
+    return ret;
+}
+
+static void
+gen_end(struct gen *g)
+{
+    krb5_tkt_creds_free(g->ctx, g->tcc);
+    krb5_init_creds_free(g->ctx, g->icc);
+    g->tcc = NULL;
+    g->icc = NULL;
+}
+
+static int
+write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int
+read_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Send req to the KDC over TCP and wait for the reply, for setup exchanges. */
+static krb5_error_code
+exchange(const krb5_data *req, krb5_data *reply)
+{
+    unsigned char lenbuf[4];
+    krb5_ui_4 len;
+    char *buf = NULL;
+    int fd;
+
+    fd = socket(kdc_addr.ss_family, SOCK_STREAM, 0);
+    if (fd == -1)
+        return errno;
+    if (connect(fd, ss2sa(&kdc_addr), kdc_addrlen) != 0)
+        goto fail;
+    store_32_be(req->length, lenbuf);
+    if (write_all(fd, lenbuf, 4) != 0 ||
+        write_all(fd, req->data, req->length) != 0)
+        goto fail;
+    if (read_all(fd, lenbuf, 4) != 0)
+        goto fail;
+    len = load_32_be(lenbuf);
+    if (len > MAX_REPLY) {
+        close(fd);
+        return KRB5KRB_ERR_FIELD_TOOLONG;
+    }
+    buf = malloc(len ? len : 1);
+    if (buf == NULL) {
+        close(fd);
+        return ENOMEM;
+    }
+    if (read_all(fd, buf, len) != 0)
+        goto fail;
+    close(fd);
+    *reply = make_data(buf, len);
+    return 0;
+
+fail:
+    close(fd);
+    free(buf);
+    return KRB5_KDC_UNREACH;
+}
+
+/* Run one complete exchange and return the number of requests it took. */
+static int
+count_steps(struct gen *g)
+{
+    krb5_error_code ret;
+    krb5_data in = empty_data(), out;
+    int more, n = 0;
+
+    ret = gen_begin(g);
+    if (ret)
+        bail(g->ctx, ret, _("while starting probe exchange"));
+    for (;;) {
+        ret = gen_step(g, &in, &out, &more);
+        krb5_free_data_contents(g->ctx, &in);
+        if (ret)
+            bail(g->ctx, ret, _("during probe exchange"));
+        if (!more)
+            break;
+        n++;
+        ret = exchange(&out, &in);
+        krb5_free_data_contents(g->ctx, &out);
+        if (ret)
+            bail(g->ctx, ret, _("while contacting KDC"));
+    }
+    gen_end(g);
+    return n;
+}
+
+/*
+ * Carry out the first nsteps - 1 exchanges of a fresh exchange and store its
+ * final request in req, framed for TCP if necessary.
+ */
+static void
+make_request(struct gen *g, int nsteps, struct request *req)
+{
+    krb5_error_code ret;
+    krb5_data in = empty_data(), out;
+    int i, more, hdr = use_tcp ? 4 : 0;
+
+    ret = gen_begin(g);
+    if (ret)
+        bail(g->ctx, ret, _("while starting exchange"));
+    for (i = 1; ; i++) {
+        ret = gen_step(g, &in, &out, &more);
+        krb5_free_data_contents(g->ctx, &in);
+        if (ret)
+            bail(g->ctx, ret, _("while encoding request"));
+        if (!more) {
+            fprintf(stderr, _("%s: exchange finished after %d requests\n"),
+                    prog, i - 1);
+            exit(1);
+        }
+        if (i == nsteps)
+            break;
+        ret = exchange(&out, &in);
+        krb5_free_data_contents(g->ctx, &out);
+        if (ret)
+            bail(g->ctx, ret, _("while contacting KDC"));
+    }
+    gen_end(g);
+
+    req->pkt.data = malloc(out.length + hdr);
+    if (req->pkt.data == NULL)
+        bail(g->ctx, ENOMEM, _("while encoding request"));
+    req->pkt.length = out.length + hdr;
+    if (use_tcp)
+        store_32_be(out.length, req->pkt.data);
+    memcpy(req->pkt.data + hdr, out.data, out.length);
+    req->latency = -1;
+    krb5_free_data_contents(g->ctx, &out);
+}
+
+/*** Load generation ***/
+
+static int
+open_socket(struct slot *s)
+{
+    int fd;
+
+    fd = socket(kdc_addr.ss_family, use_tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd == -1)
+        return -1;
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0)
+        goto fail;
+    s->connecting = 0;
+    if (connect(fd, ss2sa(&kdc_addr), kdc_addrlen) != 0) {
+        if (!use_tcp || errno != EINPROGRESS)
+            goto fail;
+        s->connecting = 1;
+    }
+    s->fd = fd;
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+static void
+close_socket(struct slot *s)
+{
+    if (s->fd != -1)
+        close(s->fd);
+    s->fd = -1;
+    s->connecting = 0;
+}
+
+static int
+send_request(struct slot *s)
+{
+    ssize_t n;
+
+    n = send(s->fd, s->req->pkt.data, s->req->pkt.length, 0);
+    return (n == (ssize_t)s->req->pkt.length) ? 0 : -1;
+}
+
+static void
+count_error(struct worker *w, const krb5_data *reply)
+{
+    krb5_error *err;
+    int i;
+
+    if (krb5_rd_error(w->ctx, reply, &err) != 0) {
+        w->nfail++;
+        return;
+    }
+    w->nerr++;
+    for (i = 0; i < w->nerrs; i++) {
+        if (w->errs[i].code == err->error)
+            break;
+    }
+    if (i == w->nerrs) {
+        if (i == MAX_ERRCODES)
+            goto cleanup;
+        w->errs[i].code = err->error;
+        w->errs[i].count = 0;
+        w->nerrs++;
+    }
+    w->errs[i].count++;
+
+cleanup:
+    krb5_free_error(w->ctx, err);
+}
+
+/* Record the outcome of the request in slot s and free the slot. */
+static void
+finish_request(struct worker *w, struct slot *s, const krb5_data *reply,
+               double t)
+{
+    if (reply == NULL) {
+        w->nfail++;
+    } else {
+        s->req->latency = t - s->req->sched;
+        if (krb5_is_as_rep(reply) || krb5_is_tgs_rep(reply))
+            w->nok++;
+        else if (krb5_is_krb_error(reply))
+            count_error(w, reply);
+        else
+            w->nfail++;
+        w->last = t;
+    }
+    s->req = NULL;
+    s->len = 0;
+    if (use_tcp || reply == NULL)
+        close_socket(s);
+}
+
+static void
+start_request(struct worker *w, struct slot *s, struct request *req,
+              double sched, double t)
+{
+    s->req = req;
+    req->sched = sched;
+    s->deadline = t + timeout;
+    if (s->fd == -1 && open_socket(s) != 0) {
+        finish_request(w, s, NULL, t);
+        return;
+    }
+    if (!s->connecting && send_request(s) != 0)
+        finish_request(w, s, NULL, t);
+}
+
+/* Handle readiness on the socket for slot s. */
+static void
+service_slot(struct worker *w, struct slot *s, double t)
+{
+    krb5_data reply;
+    ssize_t n;
+    size_t need;
+    int err;
+    socklen_t errlen = sizeof(err);
+
+    if (s->connecting) {
+        if (getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0 ||
+            err != 0) {
+            finish_request(w, s, NULL, t);
+            return;
+        }
+        s->connecting = 0;
+        if (send_request(s) != 0)
+            finish_request(w, s, NULL, t);
+        return;
+    }
+
+    n = recv(s->fd, s->buf + s->len, MAX_REPLY - s->len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n <= 0) {
+        finish_request(w, s, NULL, t);
+        return;
+    }
+    s->len += n;
+    if (!use_tcp) {
+        reply = make_data(s->buf, s->len);
+        finish_request(w, s, &reply, t);
+        return;
+    }
+    if (s->len < 4)
+        return;
+    need = load_32_be(s->buf);
+    if (need > MAX_REPLY - 4) {
+        finish_request(w, s, NULL, t);
+        return;
+    }
+    if (s->len == need + 4) {
+        reply = make_data(s->buf + 4, need);
+        finish_request(w, s, &reply, t);
+    }
+}
+
+static void *
+run_worker(void *arg)
+{
+    struct worker *w = arg;
+    struct slot *slots, *s, **polled;
+    struct pollfd *pfds;
+    size_t next = 0, ndone = 0, nactive;
+    double t, sched, wait;
+    int i, npfd, ms;
+
+    slots = calloc(nsockets, sizeof(*slots));
+    pfds = calloc(nsockets, sizeof(*pfds));
+    polled = calloc(nsockets, sizeof(*polled));
+    if (slots == NULL || pfds == NULL || polled == NULL)
+        bail(w->ctx, ENOMEM, _("while starting worker"));
+    for (i = 0; i < nsockets; i++) {
+        slots[i].fd = -1;
+        slots[i].buf = malloc(MAX_REPLY);
+        if (slots[i].buf == NULL)
+            bail(w->ctx, ENOMEM, _("while starting worker"));
+    }
+
+    while (ndone < w->nreqs) {
+        /* Issue requests which are due, as long as there are free slots. */
+        t = now();
+        sched = t;
+        for (i = 0; i < nsockets && next < w->nreqs; i++) {
+            if (slots[i].req != NULL)
+                continue;
+            if (rate > 0) {
+                sched = start_time + (w->id + next * nthreads) / rate;
+                if (sched > t)
+                    break;
+            }
+            start_request(w, &slots[i], &w->reqs[next++], sched, t);
+        }
+
+        /* Wait for replies, the next deadline, or the next scheduled send. */
+        wait = timeout;
+        if (rate > 0 && next < w->nreqs && sched > t)
+            wait = sched - t;
+        npfd = 0;
+        nactive = 0;
+        for (i = 0; i < nsockets; i++) {
+            s = &slots[i];
+            if (s->req == NULL)
+                continue;
+            nactive++;
+            if (s->deadline - t < wait)
+                wait = s->deadline - t;
+            pfds[npfd].fd = s->fd;
+            pfds[npfd].events = s->connecting ? POLLOUT : POLLIN;
+            pfds[npfd].revents = 0;
+            polled[npfd++] = s;
+        }
+        ms = (wait > 0) ? (int)(wait * 1000) + 1 : 0;
+        if (poll(pfds, npfd, ms) < 0 && errno != EINTR)
+            bail(w->ctx, errno, _("while polling"));
+
+        t = now();
+        for (i = 0; i < npfd; i++) {
+            if (pfds[i].revents != 0 && polled[i]->req != NULL)
+                service_slot(w, polled[i], t);
+        }
+        for (i = 0; i < nsockets; i++) {
+            s = &slots[i];
+            if (s->req != NULL && t >= s->deadline) {
+                /* A late reply must not be taken for the next request's. */
+                s->req = NULL;
+                s->len = 0;
+                close_socket(s);
+                w->ntimeout++;
+            }
+        }
+        ndone = next;
+        for (i = 0; i < nsockets; i++) {
+            if (slots[i].req != NULL)
+                ndone--;
+        }
+    }
+
+    for (i = 0; i < nsockets; i++) {
+        close_socket(&slots[i]);
+        free(slots[i].buf);
+    }
+    free(slots);
+    free(pfds);
+    free(polled);
+    return NULL;
+}
+
+/*** Reporting ***/
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static double
+percentile(const double *v, size_t n, double p)
+{
+    size_t i = (size_t)(p / 100 * n);
+
+    return v[(i < n) ? i : n - 1];
+}
+
+static void
+report(krb5_context ctx, struct worker *workers, struct request *reqs,
+       size_t nreqs)
+{
+    struct errcount errs[MAX_ERRCODES];
+    unsigned long nok = 0, nerr = 0, ntimeout = 0, nfail = 0;
+    double *lat, last = start_time, elapsed;
+    size_t i, nlat = 0;
+    int j, k, nerrs = 0;
+
+    for (j = 0; j < nthreads; j++) {
+        nok += workers[j].nok;
+        nerr += workers[j].nerr;
+        ntimeout += workers[j].ntimeout;
+        nfail += workers[j].nfail;
+        if (workers[j].last > last)
+            last = workers[j].last;
+        for (k = 0; k < workers[j].nerrs; k++) {
+            for (i = 0; i < (size_t)nerrs; i++) {
+                if (errs[i].code == workers[j].errs[k].code)
+                    break;
+            }
+            if (i == (size_t)nerrs) {
+                if (nerrs == MAX_ERRCODES)
+                    continue;
+                errs[nerrs].code = workers[j].errs[k].code;
+                errs[nerrs++].count = 0;
+            }
+            errs[i].count += workers[j].errs[k].count;
+        }
+    }
+
+    lat = malloc(nreqs * sizeof(*lat));
+    if (lat == NULL)
+        bail(ctx, ENOMEM, _("while reporting"));
+    for (i = 0; i < nreqs; i++) {
+        if (reqs[i].latency >= 0)
+            lat[nlat++] = reqs[i].latency * 1000;
+    }
+    qsort(lat, nlat, sizeof(*lat), cmp_double);
+    elapsed = last - start_time;
+
+    printf(_("requests: %lu sent, %lu replies (%lu ok, %lu errors), "
+             "%lu timeouts, %lu failed\n"), (unsigned long)nreqs,
+           nok + nerr, nok, nerr, ntimeout, nfail);
+    printf(_("elapsed: %.3f s, throughput: %.1f replies/s\n"), elapsed,
+           (elapsed > 0) ? (nok + nerr) / elapsed : 0.0);
+    if (nlat > 0) {
+        printf(_("latency (ms): min %.3f p50 %.3f p90 %.3f p99 %.3f "
+                 "p99.9 %.3f max %.3f\n"), lat[0],
+               percentile(lat, nlat, 50), percentile(lat, nlat, 90),
+               percentile(lat, nlat, 99), percentile(lat, nlat, 99.9),
+               lat[nlat - 1]);
+    }
+    for (k = 0; k < nerrs; k++) {
+        printf(_("error %lu (%s): %lu\n"), (unsigned long)errs[k].code,
+               error_message(ERROR_TABLE_BASE_krb5 + errs[k].code),
+               errs[k].count);
+    }
+    free(lat);
+}
+
+static void
+resolve_kdc(const char *host, const char *port)
+{
+    struct addrinfo hints, *ai;
+    int err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    err = getaddrinfo(host, port, &hints, &ai);
+    if (err) {
+        fprintf(stderr, _("%s: cannot resolve %s: %s\n"), prog, host,
+                gai_strerror(err));
+        exit(1);
+    }
+    memcpy(&kdc_addr, ai->ai_addr, ai->ai_addrlen);
+    kdc_addrlen = ai->ai_addrlen;
+    freeaddrinfo(ai);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_error_code ret;
+    struct gen g;
+    struct request *reqs;
+    struct worker *workers;
+    const char *host = "localhost", *port = "88", *armor = NULL;
+    const char *service = NULL, *ccname = NULL, *ktname = NULL;
+    size_t i, j, nreqs = 1000;
+    double gen_start;
+    int c, nsteps;
+
+    prog = strrchr(argv[0], '/');
+    prog = (prog == NULL) ? argv[0] : prog + 1;
+
+    ret = krb5_init_context(&ctx);
+    if (ret) {
+        com_err(prog, ret, _("while initializing krb5 context"));
+        exit(1);
+    }
+    memset(&g, 0, sizeof(g));
+    g.ctx = ctx;
+
+    while ((c = getopt(argc, argv, "uth:p:n:r:T:s:o:A:S:c:k:w:")) != -1) {
+        switch (c) {
+        case 'u':
+            use_tcp = 0;
+            break;
+        case 't':
+            use_tcp = 1;
+            break;
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = optarg;
+            break;
+        case 'n':
+            nreqs = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            rate = strtod(optarg, NULL);
+            break;
+        case 'T':
+            nthreads = atoi(optarg);
+            break;
+        case 's':
+            nsockets = atoi(optarg);
+            break;
+        case 'o':
+            timeout = strtod(optarg, NULL);
+            break;
+        case 'A':
+            armor = optarg;
+            break;
+        case 'S':
+            service = optarg;
+            break;
+        case 'c':
+            ccname = optarg;
+            break;
+        case 'k':
+            ktname = optarg;
+            break;
+        case 'w':
+            g.password = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (nreqs == 0 || nthreads <= 0 || nsockets <= 0 || timeout <= 0 ||
+        rate < 0)
+        usage();
+    if (service != NULL) {
+        if (argc != 0 || armor != NULL || ktname != NULL ||
+            g.password != NULL)
+            usage();
+    } else if (argc != 1 || ccname != NULL ||
+               (ktname == NULL) == (g.password == NULL)) {
+        usage();
+    }
+    resolve_kdc(host, port);
+
+    if (service != NULL) {
+        g.tgs = 1;
+        ret = (ccname != NULL) ? krb5_cc_resolve(ctx, ccname, &g.ccache) :
+            krb5_cc_default(ctx, &g.ccache);
+        if (ret)
+            bail(ctx, ret, _("while opening ccache"));
+        ret = krb5_cc_get_principal(ctx, g.ccache, &g.in_creds.client);
+        if (ret)
+            bail(ctx, ret, _("while reading ccache principal"));
+        ret = krb5_parse_name(ctx, service, &g.in_creds.server);
+        if (ret)
+            bail(ctx, ret, _("while parsing service name"));
+    } else {
+        ret = krb5_parse_name(ctx, argv[0], &g.client);
+        if (ret)
+            bail(ctx, ret, _("while parsing client name"));
+        if (ktname != NULL) {
+            ret = krb5_kt_resolve(ctx, ktname, &g.keytab);
+            if (ret)
+                bail(ctx, ret, _("while resolving keytab"));
+        }
+        ret = krb5_get_init_creds_opt_alloc(ctx, &g.opt);
+        if (ret)
+            bail(ctx, ret, _("while allocating options"));
+        if (armor != NULL) {
+            ret = krb5_get_init_creds_opt_set_fast_ccache_name(ctx, g.opt,
+                                                               armor);
+            if (ret)
+                bail(ctx, ret, _("while setting armor ccache"));
+        }
+    }
+
+    /* Encode the requests. */
+    reqs = calloc(nreqs, sizeof(*reqs));
+    if (reqs == NULL)
+        bail(ctx, ENOMEM, _("while encoding requests"));
+    nsteps = count_steps(&g);
+    gen_start = now();
+    for (i = 0; i < nreqs; i++)
+        make_request(&g, nsteps, &reqs[i]);
+    printf(_("encoded %lu requests (%d-step exchange) in %.3f s\n"),
+           (unsigned long)nreqs, nsteps, now() - gen_start);
+    if (!g.tgs && now() - gen_start > ctx->clockskew) {
+        fprintf(stderr, _("%s: warning: encoding took longer than the clock "
+                          "skew; early requests may be rejected\n"), prog);
+    }
+
+    /* Deal the requests out to the workers, keeping each one's share
+     * contiguous so that request w.id + k * nthreads is w.reqs[k]. */
+    workers = calloc(nthreads, sizeof(*workers));
+    if (workers == NULL)
+        bail(ctx, ENOMEM, _("while starting workers"));
+    {
+        struct request *sorted = malloc(nreqs * sizeof(*sorted));
+
+        if (sorted == NULL)
+            bail(ctx, ENOMEM, _("while starting workers"));
+        for (i = 0, j = 0; (int)i < nthreads; i++) {
+            size_t k;
+
+            workers[i].id = i;
+            workers[i].reqs = &sorted[j];
+            for (k = i; k < nreqs; k += nthreads)
+                sorted[j++] = reqs[k];
+            workers[i].nreqs = &sorted[j] - workers[i].reqs;
+        }
+        free(reqs);
+        reqs = sorted;
+    }
+
+    start_time = now();
+    for (i = 0; (int)i < nthreads; i++) {
+        ret = krb5_init_context(&workers[i].ctx);
+        if (ret)
+            bail(ctx, ret, _("while initializing krb5 context"));
+        ret = pthread_create(&workers[i].tid, NULL, run_worker, &workers[i]);
+        if (ret)
+            bail(ctx, ret, _("while starting workers"));
+    }
+    for (i = 0; (int)i < nthreads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        krb5_free_context(workers[i].ctx);
+    }
+
+    report(ctx, workers, reqs, nreqs);
+
+    for (i = 0; i < nreqs; i++)
+        free(reqs[i].pkt.data);
+    free(reqs);
+    free(workers);
+    if (g.tgs) {
+        krb5_free_cred_contents(ctx, &g.in_creds);
+        krb5_cc_close(ctx, g.ccache);
+    } else {
+        krb5_get_init_creds_opt_free(ctx, g.opt);
+        if (g.keytab != NULL)
+            krb5_kt_close(ctx, g.keytab);
+        krb5_free_principal(ctx, g.client);
+    }
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/python
+# Stand up a test realm and measure it with kdc5_bench.  Run with "make
+# bench" from the build tree; arguments after "--" (BENCHARGS for make)
+# are passed to each kdc5_bench run, for example:
+#
+#   make bench BENCHARGS='-n 20000 -T 4 -s 16 -r 5000'
+
+from k5test import *
+
+kdc5_bench = os.path.join(buildtop, 'tests', 'hammer', 'kdc5_bench')
+
+realm = K5Realm(create_host=True, get_creds=True)
+
+# Require preauth so that AS requests carry PA-ENC-TIMESTAMP (or an
+# encrypted challenge under FAST), and give the client a keytab so that
+# encoding the requests doesn't repeat string-to-key.
+realm.run_kadminl('modprinc +requires_preauth %s' % realm.user_princ)
+realm.run_kadminl('ktadd -k %s -norandkey %s' %
+                  (realm.client_keytab, realm.user_princ))
+
+# Armor ccache for the FAST runs.
+armor = os.path.join(realm.testdir, 'armor')
+realm.run_as_client([kinit, '-k', '-t', realm.keytab, '-c', armor,
+                     realm.host_princ])
+
+common = ['-h', hostname, '-p', str(realm.portbase)]
+as_args = ['-k', realm.client_keytab, realm.user_princ]
+tgs_args = ['-c', realm.ccache, '-S', realm.host_princ]
+runs = [('AS-REQ, UDP', ['-u'] + as_args),
+        ('AS-REQ, TCP', ['-t'] + as_args),
+        ('AS-REQ with FAST, UDP', ['-u', '-A', armor] + as_args),
+        ('TGS-REQ, UDP', ['-u'] + tgs_args),
+        ('TGS-REQ, TCP', ['-t'] + tgs_args)]
+
+for desc, runargs in runs:
+    out = realm.run_as_client([kdc5_bench] + common + args + runargs)
+    output('\n%s:\n%s' % (desc, out), force_verbose=True)
+    if 'timeouts, 0 failed' not in out:
+        fail('kdc5_bench reported failed requests for %s' % desc)
+
+success('KDC benchmark')
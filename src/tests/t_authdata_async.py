@@ -0,0 +1,88 @@
+#!/usr/bin/python
+from k5test import *
+import time
+
+# Serve two realms from one KDC, using the test KDB module, which defers
+# sign_authdata_async completion to the KDC's event loop.  Make a
+# cross-realm TGS request to KRBTEST2.COM (which consults the KDB for
+# authdata) and, while its authdata is outstanding, an AS request to
+# KRBTEST.COM.  The test module aborts the KDC if the TGS request is
+# resumed with the other realm's context.
+
+realm2 = 'KRBTEST2.COM'
+db2_module = os.path.join(buildtop, 'plugins', 'kdb', 'db2', 'db2.so')
+test_module_dir = os.path.join(buildtop, 'plugins', 'kdb', 'test')
+
+conf = {
+    'all' : {
+        'realms' : {
+            '$realm' : {
+                'database_module' : 'test'
+            },
+            realm2 : {
+                'database_module' : 'test2'
+            }
+        },
+        'dbmodules' : {
+            'db_module_dir' : ['$plugins/kdb', test_module_dir],
+            'test' : {
+                'db_library' : 'test',
+                'db2_module' : db2_module,
+                'authdata_delay' : '300',
+                'database_name' : '$testdir/db'
+            },
+            'test2' : {
+                'db_library' : 'test',
+                'db2_module' : db2_module,
+                'authdata_delay' : '300',
+                'database_name' : '$testdir/db2'
+            }
+        }
+    },
+    'master' : {
+        'realms' : {
+            realm2 : {
+                'key_stash_file' : '$testdir/stash2',
+                'kdc_ports' : '$port0',
+                'kdc_tcp_ports' : '$port0'
+            }
+        }
+    }
+}
+krb5_conf = {
+    'all' : {
+        'realms' : {
+            realm2 : {
+                'kdc' : '$hostname:$port0'
+            }
+        }
+    }
+}
+
+realm = K5Realm(kdc_conf=conf, krb5_conf=krb5_conf, create_host=False,
+                start_kdc=False, get_creds=False)
+
+def kadminl2(query):
+    return realm.run_as_master([kadmin_local, '-r', realm2, '-q', query])
+
+realm.run_as_master([kdb5_util, '-r', realm2, 'create', '-W', '-s',
+                     '-P', 'master'])
+cross_princ = 'krbtgt/%s@%s' % (realm2, realm.realm)
+realm.run_kadminl('addprinc -pw cross %s' % cross_princ)
+kadminl2('addprinc -pw cross %s' % cross_princ)
+service = 'host/%s@%s' % (hostname, realm2)
+kadminl2('addprinc -randkey %s' % service)
+
+realm.start_kdc(['-r', realm.realm, '-r', realm2])
+realm.kinit(realm.user_princ, password('user'))
+
+proc = subprocess.Popen([kvno, service], stdout=subprocess.PIPE,
+                        stderr=subprocess.STDOUT, env=realm.env_client)
+time.sleep(0.1)
+realm.kinit(realm.user_princ, password('user'),
+            flags=['-c', os.path.join(realm.testdir, 'ccache2')])
+output = proc.communicate()[0]
+if proc.returncode != 0 or service not in output:
+    fail('kvno of %s failed: %s' % (service, output))
+
+success('Deferred KDB authdata across realms')
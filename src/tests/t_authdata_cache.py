@@ -0,0 +1,80 @@
+#!/usr/bin/python
+from k5test import *
+import shutil
+import time
+
+# Use the test KDB module, which returns authdata from sign_authdata_async
+# and logs the server principal of each call, to check that the KDC's
+# authdata cache reuses module output only for the same client, TGT and
+# service, and only until the cache lifetime passes.
+
+db2_module = os.path.join(buildtop, 'plugins', 'kdb', 'db2', 'db2.so')
+test_module_dir = os.path.join(buildtop, 'plugins', 'kdb', 'test')
+lifetime = 4
+
+conf = {
+    'all' : {
+        'kdcdefaults' : {
+            'kdc_authdata_cache_lifetime' : str(lifetime)
+        },
+        'realms' : {
+            '$realm' : {
+                'database_module' : 'test'
+            }
+        },
+        'dbmodules' : {
+            'db_module_dir' : ['$plugins/kdb', test_module_dir],
+            'test' : {
+                'db_library' : 'test',
+                'db2_module' : db2_module,
+                'authdata_delay' : '0',
+                'authdata_log' : '$testdir/authdata_log',
+                'database_name' : '$testdir/db'
+            }
+        }
+    }
+}
+
+realm = K5Realm(kdc_conf=conf, create_host=False, get_creds=False)
+log = os.path.join(realm.testdir, 'authdata_log')
+
+svc1 = 'svc1/%s@%s' % (hostname, realm.realm)
+svc2 = 'svc2/%s@%s' % (hostname, realm.realm)
+realm.run_kadminl('addprinc -randkey %s' % svc1)
+realm.run_kadminl('addprinc -randkey %s' % svc2)
+
+# Return the number of sign_authdata calls logged for princ.
+def calls(princ):
+    if not os.path.exists(log):
+        return 0
+    f = open(log)
+    n = len([l for l in f if l.strip() == princ])
+    f.close()
+    return n
+
+# Fetch a ticket for princ from a fresh copy of the TGT cache, so that
+# every call makes a TGS request with the same TGT.
+def get_ticket(princ, name):
+    ccache = os.path.join(realm.testdir, name)
+    shutil.copyfile(realm.ccache, ccache)
+    output = realm.run_as_client([kvno, '-c', ccache, princ])
+    if princ not in output:
+        fail('kvno of %s did not succeed' % princ)
+
+realm.kinit(realm.user_princ, password('user'))
+
+get_ticket(svc1, 'ccache1')
+get_ticket(svc1, 'ccache2')
+if calls(svc1) != 1:
+    fail('Cached authdata not reused for the same service')
+
+get_ticket(svc2, 'ccache3')
+if calls(svc2) != 1:
+    fail('Module not called for a different service')
+
+time.sleep(lifetime + 1)
+get_ticket(svc1, 'ccache4')
+if calls(svc1) != 2:
+    fail('Expired authdata cache entry reused')
+
+success('KDC authdata cache')
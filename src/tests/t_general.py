@@ -49,6 +49,52 @@ if 'fred\n' not in output:
 if 'barney\n' not in output:
     fail('Policy not preserved across dump/load.')
 
+# Check that a binary dump/load round trip preserves the database.
+bdumpfile = os.path.join(realm.testdir, 'bdump')
+realm.run_as_master([kdb5_util, 'dump', dumpfile])
+realm.run_as_master([kdb5_util, 'dump', '-binary', bdumpfile])
+realm.run_as_master([kdb5_util, 'load', bdumpfile])
+realm.run_as_master([kdb5_util, 'dump', dumpfile + '2'])
+if open(dumpfile).read() != open(dumpfile + '2').read():
+    fail('Database not preserved across binary dump/load.')
+realm.run_as_master([kdb5_util, 'load', '-binary', bdumpfile])
+realm.run_as_master([kdb5_util, 'load', '-binary', dumpfile],
+                    expected_code=1)
+output = realm.run_kadminl('getpols')
+if 'barney\n' not in output:
+    fail('Policy not preserved across binary dump/load.')
+realm.kinit(realm.user_princ, password('user'))
+
+# Check principal listing with patterns, including patterns with a
+# literal prefix (which the db2 module uses to seek into the database).
+for name in ('lp/a', 'lp/b', 'lp/bc', 'lpx', 'l.p', 'mp/a'):
+    realm.run_kadminl('addprinc -randkey ' + name)
+def check_listprincs(pattern, expected):
+    out = realm.run_kadminl('listprincs ' + pattern)
+    names = [l for l in out.splitlines() if '@' in l and
+             not l.startswith('Authenticating')]
+    expected = [e + '@' + realm.realm for e in expected]
+    if sorted(names) != sorted(expected):
+        fail('listprincs %s: got %s' % (pattern, names))
+check_listprincs('lp/*', ['lp/a', 'lp/b', 'lp/bc'])
+check_listprincs('lp/b', ['lp/b'])
+check_listprincs('lp/b*', ['lp/b', 'lp/bc'])
+check_listprincs('lp/?', ['lp/a', 'lp/b'])
+check_listprincs('lp*', ['lp/a', 'lp/b', 'lp/bc', 'lpx'])
+check_listprincs('l.p', ['l.p'])
+check_listprincs('*p/a', ['lp/a', 'mp/a'])
+check_listprincs('[lm]p/a', ['lp/a', 'mp/a'])
+check_listprincs('lp/a@' + realm.realm, ['lp/a'])
+check_listprincs('lq*', [])
+check_listprincs('zzz*', [])
+# kadmin passes the pattern on as a regular expression, where a backslash
+# can introduce an alternation or a quantifier.
+check_listprincs(r'lp/a\|mp/a', ['lp/a', 'mp/a'])
+check_listprincs(r'lp/b\+', ['lp/b'])
+check_listprincs(r'lp/bc\?', ['lp/b', 'lp/bc'])
+check_listprincs(r'lp/bc\{0,1\}', ['lp/b', 'lp/bc'])
+check_listprincs('lp+', [])
+
 # Spot-check KRB5_TRACE output
 tracefile = os.path.join(realm.testdir, 'trace')
 realm.run_as_client(['env', 'KRB5_TRACE=' + tracefile, kinit,
@@ -67,4 +113,15 @@ for e in expected:
     if e not in trace:
         fail('Expected output not in kinit trace log')
 
-success('Dump/load, FAST kinit, kdestroy, trace logging')
+# Check that the KDC logs request statistics when it shuts down.
+realm.run_as_client([kvno, realm.admin_princ])
+realm.stop_kdc()
+f = open(os.path.join(realm.testdir, 'kdc.log'), 'r')
+log = f.read()
+f.close()
+for e in ('stats: AS_REQ: ', 'stats: TGS_REQ: 1 requests, 0 errors',
+          'stats: TGS_REQ: phase authdata: '):
+    if e not in log:
+        fail('Expected request statistics not in KDC log')
+
+success('Dump/load, FAST kinit, kdestroy, trace logging, KDC stats')
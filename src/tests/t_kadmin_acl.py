@@ -66,6 +66,8 @@ restricted_rename  ad  *         +preauth
 */*                d   *2/*1
 */admin            a
 wctarget           a   wild/*
+user/admin         i
+*                  i   wild/*
 restrictions       a   type1     -policy minlife
 restrictions       a   type2     -clearpolicy
 restrictions       a   type3     -maxlife 1h -maxrenewlife 2h
@@ -318,6 +320,20 @@ delprinc('wild/card')
 out = kadmin_as(wctarget, 'addprinc -pw pw wild/card/extra')
 if 'Operation requires' not in out:
     fail('addprinc failure (target wildcard extra component)')
+
+# The first entry matching the caller and target applies, whether the
+# caller is named exactly or by wildcard.
+realm.addprinc('wild/card', 'pw')
+out = kadmin_as(admin, 'getprinc none')
+if 'Operation requires ``get\'\' privilege' not in out:
+    fail('getprinc success (exact entry after wildcard entry)')
+out = kadmin_as(wctarget, 'getprinc wild/card')
+if 'Operation requires ``get\'\' privilege' not in out:
+    fail('getprinc success (wildcard entry after exact entry)')
+out = kadmin_as(none, 'getprinc wild/card')
+if 'Principal: wild/card@KRBTEST.COM' not in out:
+    fail('getprinc failure (caller wildcard)')
+delprinc('wild/card')
 realm.addprinc('admin/user', 'pw')
 out = kadmin_as(admin, 'delprinc -force admin/user')
 if 'Principal "admin/user@KRBTEST.COM" deleted.' not in out:
@@ -347,4 +363,68 @@ out = realm.run_kadminl('getprinc type3')
 if 'Maximum renewable life: 0 days 02:00:00' not in out:
     fail('restriction (maxrenewlife high)')
 
+# Run kadmind with worker processes and make sure that requests are
+# still authorized and that changes made by one worker are visible to
+# the others.
+realm.stop_kadmind()
+realm.start_kadmind(['-w', '2'])
+for i in range(4):
+    kadmin_as(all_add, 'addprinc -pw pw worker%d' % i)
+for i in range(4):
+    out = kadmin_as(all_inquire, 'getprinc worker%d' % i)
+    if 'Principal: worker%d@KRBTEST.COM' % i not in out:
+        fail('getprinc with worker processes')
+out = kadmin_as(none, 'getprinc worker0')
+if 'Operation requires' not in out:
+    fail('getprinc failure with worker processes')
+for i in range(4):
+    kadmin_as(all_delete, 'delprinc -force worker%d' % i)
+out = realm.run_kadminl('listprincs worker*')
+if 'worker' in out:
+    fail('delprinc with worker processes')
+
+# Bulk mode sends runs of principal updates as batches; each operation
+# in a batch is authorized separately.
+delprinc('selected')
+delprinc('unselected')
+out = realm.run_as_client([kadmin, '-c', some_add, '-b'],
+                          input='addprinc -pw pw selected\n'
+                          'addprinc -pw pw unselected\n')
+if ('Principal "selected@KRBTEST.COM" created.' not in out or
+    'Operation requires ``add\'\' privilege' not in out):
+    fail('addprinc (bulk mode)')
+out = realm.run_kadminl('listprincs *selected')
+if 'selected@' not in out or 'unselected@' in out:
+    fail('addprinc (bulk mode) result')
+realm.run_as_client([kadmin, '-c', restricted_add, '-b'],
+                    input='addprinc -pw pw bulk1\naddprinc -pw pw bulk2\n')
+for name in ('bulk1', 'bulk2'):
+    out = realm.run_kadminl('getprinc ' + name)
+    if 'REQUIRES_PRE_AUTH' not in out:
+        fail('restriction (bulk mode)')
+    delprinc(name)
+
+# A request on a principal with queued changes, or a request which
+# can't be batched, sees the results of the earlier requests.
+out = realm.run_as_master([kadmin_local, '-b'],
+                          input='addprinc -randkey bulk3\n'
+                          'modprinc -maxlife "1 hour" bulk3\n'
+                          'cpw -randkey bulk3\n'
+                          'getprinc bulk3\n')
+if ('Principal "bulk3@KRBTEST.COM" modified.' not in out or
+    'Key for "bulk3@KRBTEST.COM" randomized.' not in out or
+    'Maximum ticket life: 0 days 01:00:00' not in out or
+    'vno 2' not in out):
+    fail('kadmin.local bulk mode')
+delprinc('bulk3')
+
+# In bulk mode, standard input holds requests, so a password cannot be
+# prompted for.
+out = realm.run_as_master([kadmin_local, '-b'],
+                          input='cpw user\naddprinc -randkey bulk4\n')
+if ('-pw or -randkey is required in bulk mode' not in out or
+    'Principal "bulk4@KRBTEST.COM" created.' not in out):
+    fail('cpw without a password (bulk mode)')
+delprinc('bulk4')
+
 success('kadmin ACL enforcement')
@@ -0,0 +1,110 @@
+#!/usr/bin/python
+from k5test import *
+
+# Propagate the master database to the slave with kprop, first with a
+# normal kpropd and then with a pipelined load (kpropd -l), and check
+# each time that the slave database matches the dump which was sent.
+
+realm = K5Realm()
+
+acl_file = os.path.join(realm.testdir, 'kpropd-acl')
+f = open(acl_file, 'w')
+f.write(realm.host_princ + '\n')
+f.close()
+
+dumpfile = os.path.join(realm.testdir, 'dump')
+slave_dumpfile = os.path.join(realm.testdir, 'slave-dump')
+checkfile = os.path.join(realm.testdir, 'check-dump')
+
+def propagate(kpropd_args):
+    kpropd_proc = realm.start_kpropd(realm.env_slave,
+                                     ['-f', slave_dumpfile, '-p', kdb5_util,
+                                      '-a', acl_file] + kpropd_args)
+    realm.run_as_master([kdb5_util, 'dump', dumpfile])
+    realm.run_as_master([kprop, '-f', dumpfile, '-P',
+                         str(realm.kprop_port()), hostname])
+    stop_daemon(kpropd_proc)
+
+def check_slave(env):
+    realm.run([kdb5_util, 'dump', checkfile], env)
+    f = open(dumpfile)
+    master_dump = f.read()
+    f.close()
+    f = open(checkfile)
+    slave_dump = f.read()
+    f.close()
+    if slave_dump != master_dump:
+        fail('Slave database does not match master')
+
+propagate([])
+realm.run_as_slave([kdb5_util, 'stash', '-P', 'master'])
+check_slave(realm.env_slave)
+
+realm.addprinc('pipelined')
+propagate(['-l'])
+check_slave(realm.env_slave)
+if 'pipelined@' not in realm.run_as_slave([kadmin_local, '-q', 'listprincs']):
+    fail('Pipelined load did not update the slave')
+
+# Chain two slaves: the first is propagated to by the master, and passes
+# the dump on to the second through kpropd_downstream.  The second slave
+# gets its own kdc.conf, since it must not propagate any further.
+realm.stop()
+conf_downstream = {
+    'slave' : {
+        'realms' : {
+            '$realm' : {
+                'kpropd_downstream' : '$hostname:$port5'
+            }
+        }
+    }
+}
+realm = K5Realm(kdc_conf=conf_downstream)
+slave2_port = str(realm.portbase + 5)
+
+acl_file = os.path.join(realm.testdir, 'kpropd-acl')
+f = open(acl_file, 'w')
+f.write(realm.host_princ + '\n')
+f.close()
+
+slave2_conf = os.path.join(realm.testdir, 'kdc.slave2.conf')
+f = open(slave2_conf, 'w')
+f.write('[realms]\n'
+        '\t%s = {\n'
+        '\t\tdatabase_module = slave2\n'
+        '\t\tkey_stash_file = %s\n'
+        '\t}\n'
+        '[dbmodules]\n'
+        '\tdb_module_dir = %s\n'
+        '\tslave2 = {\n'
+        '\t\tdb_library = db2\n'
+        '\t\tdatabase_name = %s\n'
+        '\t}\n' %
+        (realm.realm, os.path.join(realm.testdir, 'slave2-stash'),
+         os.path.join(plugins, 'kdb'),
+         os.path.join(realm.testdir, 'slave2-db')))
+f.close()
+env_slave2 = realm.env_slave.copy()
+env_slave2['KRB5_KDC_PROFILE'] = slave2_conf
+
+common_args = ['-p', kdb5_util, '-K', kprop, '-a', acl_file]
+slave2_kpropd = realm.start_kpropd(env_slave2, common_args +
+                                   ['-P', slave2_port, '-f',
+                                    os.path.join(realm.testdir, 'slave2-dump')])
+slave1_kpropd = realm.start_kpropd(realm.env_slave, common_args +
+                                   ['-f', slave_dumpfile])
+realm.run_as_master([kdb5_util, 'dump', dumpfile])
+realm.run_as_master([kprop, '-f', dumpfile, '-P', str(realm.kprop_port()),
+                     hostname])
+
+# The first slave exits once it has propagated to the second.
+output = slave1_kpropd.stdout.read()
+if 'Database propagation to %s: SUCCEEDED' % hostname not in output:
+    fail('Downstream propagation failed: ' + output)
+stop_daemon(slave1_kpropd)
+stop_daemon(slave2_kpropd)
+
+realm.run([kdb5_util, 'stash', '-P', 'master'], env_slave2)
+check_slave(env_slave2)
+
+success('kprop and kpropd')
@@ -98,6 +98,7 @@ keyword arguments:
     - port1 is used in the default krb5.conf for kadmind
     - port2 is used in the default krb5.conf for kpasswd
     - port3 is the return value of realm.server_port()
+    - port4 is the return value of realm.kprop_port()
 
 * kdc_conf={...}: kdc.conf options, expressed as a nested dictionary,
   to be merged with the default kdc.conf settings.  The top level keys
@@ -219,6 +220,10 @@ Scripts may use the following realm methods and attributes:
   - realm.run_as_master
   - realm.run_as_slave
 
+* realm.run(args, env, **keywords): Run a command in the environment
+  env, which may be one of the realm's environments or a modified copy
+  of one, in the same way as the methods above.
+
 * realm.server_port(): Returns a port number based on realm.portbase
   intended for use by server processes.
 
@@ -229,6 +234,15 @@ Scripts may use the following realm methods and attributes:
   stop_daemon() to stop the server, or used to read from the server's
   output.
 
+* realm.kprop_port(): Returns a port number based on realm.portbase
+  intended for use by kprop and kpropd.
+
+* realm.start_kpropd(env, args=[]): Start a standalone kpropd in debug
+  mode with the environment env (such as realm.env_slave), listening on
+  realm.kprop_port() unless args contains a -P option.  In this mode
+  kpropd exits after handling one propagation.  Returns a process
+  object which can be passed to stop_daemon().
+
 * realm.start_in_inetd(args, port=None): Begin a t_inetd process which
   will spawn a server process within the server environment after
   accepting a client connection.  If port is not specified,
@@ -856,12 +870,23 @@ class K5Realm(object):
     def run_as_slave(self, args, **keywords):
         return _run_cmd(args, self.env_slave, **keywords)
 
+    def run(self, args, env, **keywords):
+        return _run_cmd(args, env, **keywords)
+
     def server_port(self):
         return self.portbase + 3
 
+    def kprop_port(self):
+        return self.portbase + 4
+
     def start_server(self, args, sentinel):
         return _start_daemon(args, self.env_server, sentinel)
 
+    def start_kpropd(self, env, args=[]):
+        kpropd_args = [kpropd, '-S', '-d', '-P', str(self.kprop_port())]
+        return _start_daemon(kpropd_args + args, env,
+                             'waiting for a kprop connection')
+
     def start_in_inetd(self, args, port=None):
         if not port:
             port = self.server_port()
@@ -883,10 +908,10 @@ class K5Realm(object):
         stop_daemon(self._kdc_proc)
         self._kdc_proc = None
 
-    def start_kadmind(self):
+    def start_kadmind(self, args=[]):
         global krb5kdc
         assert(self._kadmind_proc is None)
-        self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W'],
+        self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W'] + args,
                                             self.env_master, 'starting...')
 
     def stop_kadmind(self):
@@ -308,6 +308,44 @@ errcode_t profile_open_file(const_profile_filespec_t filespec,
     return 0;
 }
 
+/*
+ * Make a new file handle for the same file as oldfile.  If oldfile's data is
+ * in the shared tree list, the new handle references it directly, avoiding
+ * the filespec lookup and access checks of profile_open_file; the data will
+ * still be checked for changes on the next lookup.  Data which has been
+ * unshared for modification is not shared with the copy, which gets its own
+ * view of the file as profile_open_file would give it.
+ */
+errcode_t profile_copy_file(prf_file_t oldfile, prf_file_t *ret_prof)
+{
+    prf_file_t      prf;
+    errcode_t       retval;
+    prf_data_t      data = oldfile->data;
+
+    retval = k5_mutex_lock(&g_shared_trees_mutex);
+    if (retval)
+        return retval;
+    if (!(data->flags & PROFILE_FILE_SHARED)) {
+        (void) k5_mutex_unlock(&g_shared_trees_mutex);
+        return profile_open_file(data->filespec, ret_prof, NULL);
+    }
+
+    prf = malloc(sizeof(struct _prf_file_t));
+    if (!prf) {
+        (void) k5_mutex_unlock(&g_shared_trees_mutex);
+        return ENOMEM;
+    }
+    memset(prf, 0, sizeof(struct _prf_file_t));
+    prf->magic = PROF_MAGIC_FILE;
+    scan_shared_trees_locked();
+    data->refcount++;
+    prf->data = data;
+    (void) k5_mutex_unlock(&g_shared_trees_mutex);
+
+    *ret_prof = prf;
+    return 0;
+}
+
 errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
 {
     errcode_t retval;